@@ -43,6 +43,46 @@ public class Seahorse.AppSettings : GLib.Settings {
         set { set_string("server-publish-to", value); }
     }
 
+    public int keyserver_cache_size {
+        get { return get_int("keyserver-cache-size"); }
+        set { set_int("keyserver-cache-size", value); }
+    }
+
+    public int keyserver_max_requests {
+        get { return get_int("keyserver-max-requests"); }
+        set { set_int("keyserver-max-requests", value); }
+    }
+
+    public int keyserver_page_size {
+        get { return get_int("keyserver-page-size"); }
+        set { set_int("keyserver-page-size", value); }
+    }
+
+    public int keyserver_refresh_interval {
+        get { return get_int("keyserver-refresh-interval"); }
+        set { set_int("keyserver-refresh-interval", value); }
+    }
+
+    public int keyserver_refresh_rate {
+        get { return get_int("keyserver-refresh-rate"); }
+        set { set_int("keyserver-refresh-rate", value); }
+    }
+
+    public int keyserver_refresh_requests {
+        get { return get_int("keyserver-refresh-requests"); }
+        set { set_int("keyserver-refresh-requests", value); }
+    }
+
+    public int keyserver_search_timeout {
+        get { return get_int("keyserver-search-timeout"); }
+        set { set_int("keyserver-search-timeout", value); }
+    }
+
+    public int transfer_buffer_size {
+        get { return get_int("transfer-buffer-size"); }
+        set { set_int("transfer-buffer-size", value); }
+    }
+
 	public AppSettings () {
         GLib.Object (schema_id: "org.gnome.seahorse");
 	}
@@ -23,6 +23,13 @@ public class Seahorse.Collection : Gcr.Collection, GLib.Object {
 
     private DestroyNotify? destroy_func;
 
+    // The object properties the predicate depends on, unless watch_all
+    private string[] watched = {};
+    private bool watch_all;
+
+    // The predicate compiled for matching
+    private PredicatePlan? plan;
+
     /**
      * Base_collection collection
      */
@@ -33,6 +40,16 @@ public class Seahorse.Collection : Gcr.Collection, GLib.Object {
      */
     public Predicate? predicate { get; private set; }
 
+    /**
+     * Emitted before many objects are added or removed at once. The
+     * individual added and removed signals follow, and then
+     * changes_finished, so that views can stop following along for the
+     * lot and catch up once at the end.
+     */
+    public signal void changes_started(uint n_added, uint n_removed);
+
+    public signal void changes_finished();
+
     public Collection.for_predicate (Gcr.Collection base_collection, Predicate? pred, DestroyNotify? destroy_func) {
         GLib.Object (base_collection: base_collection);
         this.predicate = pred;
@@ -42,6 +59,8 @@ public class Seahorse.Collection : Gcr.Collection, GLib.Object {
         this.base_collection.added.connect(on_base_collection_added);
         this.base_collection.removed.connect(on_base_collection_removed);
 
+        watch_predicate();
+
         refresh ();
     }
 
@@ -49,32 +68,135 @@ public class Seahorse.Collection : Gcr.Collection, GLib.Object {
         SignalHandler.disconnect_by_func((void*) this.base_collection, (void*) on_base_collection_added, this);
         SignalHandler.disconnect_by_func((void*) this.base_collection, (void*) on_base_collection_removed, this);
 
+        foreach (weak GLib.Object obj in this.base_collection.get_objects())
+            unwatch_object(obj);
+
         foreach (GLib.Object obj in this.objects) {
-            SignalHandler.disconnect_by_func((void*) obj, (void*) on_object_changed, this);
+            unwatch_object(obj);
             emit_removed(obj);
         }
     }
 
+    // Only changes to properties the predicate looks at matter
+    private void watch_object(GLib.Object obj) {
+        if (this.watch_all) {
+            obj.notify.connect(on_object_changed);
+            return;
+        }
+
+        foreach (unowned string property in this.watched)
+            obj.notify[property].connect(on_object_changed);
+    }
+
+    private void unwatch_object(GLib.Object obj) {
+        SignalHandler.disconnect_by_func((void*) obj, (void*) on_object_changed, (void*) this);
+    }
+
+    // Returns whether the properties to watch changed
+    private bool update_watched() {
+        string[] properties = {};
+        bool all = false;
+        if (this.predicate != null)
+            all = !this.predicate.get_properties(out properties);
+
+        bool same = (all == this.watch_all && properties.length == this.watched.length);
+        for (int i = 0; same && i < properties.length; i++)
+            same = (properties[i] == this.watched[i]);
+
+        this.watch_all = all;
+        this.watched = properties;
+        return !same;
+    }
+
+    /**
+     * Picks up changes to the predicate, and to the properties it depends
+     * on. Done as part of refresh().
+     */
+    public void watch_predicate() {
+        if (this.predicate != null)
+            this.plan = new PredicatePlan((Predicate) this.predicate);
+
+        if (!update_watched())
+            return;
+
+        foreach (weak GLib.Object obj in this.base_collection.get_objects()) {
+            unwatch_object(obj);
+            watch_object(obj);
+        }
+    }
+
     public void refresh() {
+        // The predicate may now look at other properties
+        watch_predicate();
+
         // Make note of all the objects we had prior to refresh
         GenericSet<GLib.Object?> check = new GenericSet<GLib.Object?>(direct_hash, direct_equal);
         foreach(GLib.Object? obj in this.objects)
             check.add(obj);
 
-        foreach (weak GLib.Object object in get_objects()) {
+        List<weak GLib.Object> to_add = new List<weak GLib.Object>();
+        List<weak GLib.Object> to_remove = new List<weak GLib.Object>();
+
+        foreach (weak GLib.Object object in this.base_collection.get_objects()) {
             // Make note that we've seen this object
             check.remove(object);
-
-            // This will add to set
-            if (!maybe_remove_object(object))
-                if (maybe_add_object(object))
-                    object.notify.connect(on_object_changed);
+            check_object(object, ref to_add, ref to_remove);
         }
 
         foreach (GLib.Object obj in check) {
-            SignalHandler.disconnect_by_func ((void*) obj, (void*) on_object_changed, (void*) this);
-            remove_object (obj);
+            unwatch_object(obj);
+            to_remove.prepend(obj);
         }
+
+        apply_changes(to_add, to_remove);
+    }
+
+    /**
+     * Checks the predicate again for just these objects, when it is
+     * known that nothing else could be affected by a change.
+     */
+    public void refresh_objects(List<weak GLib.Object> objects) {
+        List<weak GLib.Object> to_add = new List<weak GLib.Object>();
+        List<weak GLib.Object> to_remove = new List<weak GLib.Object>();
+
+        foreach (weak GLib.Object obj in objects)
+            check_object(obj, ref to_add, ref to_remove);
+
+        apply_changes(to_add, to_remove);
+    }
+
+    private void check_object(GLib.Object obj,
+                              ref List<weak GLib.Object> to_add,
+                              ref List<weak GLib.Object> to_remove) {
+        if (this.predicate == null)
+            return;
+
+        bool matches = this.plan.match(obj);
+        if (obj in this.objects) {
+            if (!matches)
+                to_remove.prepend(obj);
+        } else if (matches) {
+            to_add.prepend(obj);
+        }
+    }
+
+    private void apply_changes(List<weak GLib.Object> to_add, List<weak GLib.Object> to_remove) {
+        uint n_added = to_add.length();
+        uint n_removed = to_remove.length();
+        if (n_added == 0 && n_removed == 0)
+            return;
+
+        changes_started(n_added, n_removed);
+
+        foreach (weak GLib.Object obj in to_remove)
+            remove_object(obj);
+
+        foreach (weak GLib.Object obj in to_add) {
+            this.objects.add(obj);
+            emit_added(obj);
+        }
+
+        changes_finished();
     }
 
     private void on_object_changed (GLib.Object obj, ParamSpec spec) {
@@ -105,7 +227,7 @@ public class Seahorse.Collection : Gcr.Collection, GLib.Object {
         if (obj in objects)
             return false;
 
-        if (this.predicate == null || !this.predicate.match(obj))
+        if (this.predicate == null || !this.plan.match(obj))
             return false;
 
         this.objects.add(obj);
@@ -117,7 +239,7 @@ public class Seahorse.Collection : Gcr.Collection, GLib.Object {
         if (!(obj in objects))
             return false;
 
-        if (this.predicate == null || this.predicate.match(obj))
+        if (this.predicate == null || this.plan.match(obj))
             return false;
 
         remove_object(obj);
@@ -125,12 +247,12 @@ public class Seahorse.Collection : Gcr.Collection, GLib.Object {
     }
 
     private void on_base_collection_added (Gcr.Collection base_collection, GLib.Object obj) {
-        obj.notify.connect(on_object_changed);
+        watch_object(obj);
         maybe_add_object(obj);
     }
 
     private void on_base_collection_removed (Gcr.Collection base_collection, GLib.Object object) {
-        SignalHandler.disconnect_by_func (object, (void*) on_object_changed, this);
+        unwatch_object(object);
 
         if (object in objects)
             remove_object (object);
@@ -0,0 +1,225 @@
+/*
+ * Seahorse
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * Keeps the casefolded label and description of every object in a
+ * collection, so the filter text can be matched without fetching and
+ * lowercasing properties on each keystroke.
+ *
+ * A trigram index narrows a substring search down to the objects that
+ * contain every three-character piece of the search text.
+ */
+public class Seahorse.FilterIndex : GLib.Object {
+
+    private Gcr.Collection collection;
+
+    // The folded text of each object
+    private HashTable<GLib.Object, string> texts;
+
+    // Objects whose label or description changed since they were indexed
+    private GenericSet<GLib.Object> stale;
+
+    // Trigram -> the objects whose text contains it
+    private HashTable<string, GenericSet<GLib.Object>> trigrams;
+
+    public FilterIndex(Gcr.Collection collection) {
+        this.collection = collection;
+        this.texts = new HashTable<GLib.Object, string>(direct_hash, direct_equal);
+        this.stale = new GenericSet<GLib.Object>(direct_hash, direct_equal);
+        this.trigrams = new HashTable<string, GenericSet<GLib.Object>>(str_hash, str_equal);
+
+        foreach (weak GLib.Object obj in collection.get_objects())
+            add_object(obj);
+
+        collection.added.connect(on_collection_added);
+        collection.removed.connect(on_collection_removed);
+    }
+
+    ~FilterIndex() {
+        SignalHandler.disconnect_by_func((void*) this.collection, (void*) on_collection_added, this);
+        SignalHandler.disconnect_by_func((void*) this.collection, (void*) on_collection_removed, this);
+
+        foreach (weak GLib.Object obj in this.texts.get_keys())
+            SignalHandler.disconnect_by_func((void*) obj, (void*) on_object_notify, this);
+    }
+
+    /**
+     * Normalizes and casefolds text, the form used for both the indexed
+     * text and the search text.
+     */
+    public static string fold(string text) {
+        string? normalized = text.normalize(-1, NormalizeMode.ALL);
+        return (normalized ?? text).casefold();
+    }
+
+    /**
+     * Whether the text of the object contains the (folded) search text.
+     */
+    public bool matches(GLib.Object obj, string folded) {
+        if (folded == "")
+            return true;
+
+        if (!(obj in this.texts))
+            add_object(obj);
+        else if (obj in this.stale)
+            index_object(obj);
+
+        unowned string? text = this.texts.lookup(obj);
+
+        return folded in text;
+    }
+
+    /**
+     * The folded text of the object, or null if it isn't indexed.
+     */
+    public unowned string? get_text(GLib.Object obj) {
+        if (obj in this.stale)
+            index_object(obj);
+        return this.texts.lookup(obj);
+    }
+
+    /**
+     * Finds all the objects whose text contains the (folded) search text.
+     */
+    public GenericSet<GLib.Object> search(string folded) {
+        GenericSet<GLib.Object> result = new GenericSet<GLib.Object>(direct_hash, direct_equal);
+
+        foreach (weak GLib.Object obj in this.stale.get_values())
+            index_object(obj);
+
+        // Too short for trigrams, check everything
+        if (folded.char_count() < 3) {
+            this.texts.foreach((obj, text) => {
+                if (folded in text)
+                    result.add(obj);
+            });
+            return result;
+        }
+
+        // Only objects with every trigram of the search text can match
+        GenericSet<GLib.Object>[] sets = {};
+        int smallest = 0;
+        GenericSet<string> wanted = trigrams_of(folded);
+        foreach (string trigram in wanted) {
+            GenericSet<GLib.Object>? set = this.trigrams.lookup(trigram);
+            if (set == null)
+                return result;
+            if (sets.length > 0 && set.length < sets[smallest].length)
+                smallest = sets.length;
+            sets += set;
+        }
+
+        foreach (GLib.Object obj in sets[smallest]) {
+            bool candidate = true;
+            for (int i = 0; candidate && i < sets.length; i++)
+                candidate = (i == smallest || obj in sets[i]);
+
+            if (candidate && folded in this.texts.lookup(obj))
+                result.add(obj);
+        }
+
+        return result;
+    }
+
+    private static GenericSet<string> trigrams_of(string text) {
+        GenericSet<string> result = new GenericSet<string>(str_hash, str_equal);
+
+        // Byte offset of each character, and of the end
+        int[] offsets = { 0 };
+        int index = 0;
+        unichar c;
+        while (text.get_next_char(ref index, out c))
+            offsets += index;
+
+        for (int i = 0; i + 3 < offsets.length; i++)
+            result.add(text.substring(offsets[i], offsets[i + 3] - offsets[i]));
+
+        return result;
+    }
+
+    private static string text_for_object(GLib.Object obj) {
+        string? label = null;
+        obj.get("label", out label, null);
+
+        string? description = null;
+        if (obj.get_class().find_property("description") != null)
+            obj.get("description", out description, null);
+
+        return fold("%s\n%s".printf(label ?? "", description ?? ""));
+    }
+
+    private void unindex_object(GLib.Object obj) {
+        unowned string? text = this.texts.lookup(obj);
+        if (text == null)
+            return;
+
+        GenericSet<string> old = trigrams_of(text);
+        foreach (string trigram in old) {
+            GenericSet<GLib.Object>? set = this.trigrams.lookup(trigram);
+            if (set == null)
+                continue;
+            set.remove(obj);
+            if (set.length == 0)
+                this.trigrams.remove(trigram);
+        }
+
+        this.texts.remove(obj);
+    }
+
+    private void index_object(GLib.Object obj) {
+        unindex_object(obj);
+        this.stale.remove(obj);
+
+        string text = text_for_object(obj);
+        GenericSet<string> current = trigrams_of(text);
+        foreach (string trigram in current) {
+            GenericSet<GLib.Object>? set = this.trigrams.lookup(trigram);
+            if (set == null) {
+                set = new GenericSet<GLib.Object>(direct_hash, direct_equal);
+                this.trigrams.insert(trigram, set);
+            }
+            set.add(obj);
+        }
+
+        this.texts.insert(obj, text);
+    }
+
+    private void add_object(GLib.Object obj) {
+        if (obj in this.texts)
+            return;
+
+        index_object(obj);
+        obj.notify["label"].connect(on_object_notify);
+        if (obj.get_class().find_property("description") != null)
+            obj.notify["description"].connect(on_object_notify);
+    }
+
+    // Reindexed when next needed, whichever notify handler runs first
+    private void on_object_notify(GLib.Object obj, ParamSpec spec) {
+        this.stale.add(obj);
+    }
+
+    private void on_collection_added(Gcr.Collection collection, GLib.Object obj) {
+        add_object(obj);
+    }
+
+    private void on_collection_removed(Gcr.Collection collection, GLib.Object obj) {
+        SignalHandler.disconnect_by_func((void*) obj, (void*) on_object_notify, this);
+        unindex_object(obj);
+        this.stale.remove(obj);
+    }
+}
@@ -23,6 +23,8 @@
 public class Seahorse.KeyManagerStore : Gcr.CollectionModel {
 
     private const string XDS_FILENAME = "xds.txt";
+    private const uint BULK_CHANGE_ROWS = 100;
+    private const string[] FILTER_PROPERTIES = { "label", "description" };
     private const size_t MAX_XDS_ATOM_VAL_LEN = 4096;
     private static Gdk.Atom XDS_ATOM = Gdk.Atom.intern("XdndDirectSave0", false);
     private static Gdk.Atom TEXT_ATOM = Gdk.Atom.intern("text/plain", false);
@@ -44,6 +46,21 @@ public class Seahorse.KeyManagerStore : Gcr.CollectionModel {
 
     private uint filter_stag;
 
+    private FilterIndex index;
+    private SortKeys sort_keys;
+
+    // What the view shows, sorted with the keys above
+    private weak Gtk.TreeModelSort? sorted;
+    private GenericSet<GLib.Object>? filter_matches;
+
+    // The filter text the collection currently reflects
+    private string? filtered_text;
+
+    // Detached from the view during many changes at once
+    private weak Gtk.TreeView? view;
+    private bool view_detached;
+    private List<GLib.Object>? detached_selection;
+
     private string? drag_destination;
     private GLib.Error? drag_error;
     private List<GLib.Object>? drag_objects;
@@ -80,8 +97,8 @@ public class Seahorse.KeyManagerStore : Gcr.CollectionModel {
                 || (this._filter_mode == Mode.FILTERED)) {
                 this._filter_mode = Mode.FILTERED;
 
-                // We always use lower case text (see filter_callback)
-                this._filter = value.down();
+                // We always use folded text (see FilterIndex)
+                this._filter = FilterIndex.fold(value ?? "");
                 refilter_later ();
             }
         }
@@ -100,7 +117,7 @@ public class Seahorse.KeyManagerStore : Gcr.CollectionModel {
     private static Gcr.Column[] _columns = {
         Gcr.Column() { property_name = "icon", property_type = typeof(Icon), column_type = typeof(Icon) },
         Gcr.Column() { property_name = "markup", property_type = typeof(string), column_type = typeof(string) },
-        Gcr.Column() { property_name = "label", property_type = typeof(string), column_type = typeof(string), flags = Gcr.ColumnFlags.SORTABLE },
+        Gcr.Column() { property_name = "label", property_type = typeof(string), column_type = typeof(string) },
         Gcr.Column() { property_name = "description", property_type = typeof(string), column_type = typeof(string) },
         Gcr.Column()
     };
@@ -114,17 +131,34 @@ public class Seahorse.KeyManagerStore : Gcr.CollectionModel {
     }
 
     public KeyManagerStore (Gcr.Collection? collection, Gtk.TreeView? view, Predicate? pred, GLib.Settings settings) {
+        FilterIndex index = new FilterIndex(collection);
         Collection filtered = new Collection.for_predicate (collection, pred, null);
         pred.custom = on_filter_visible;
         pred.custom_target = this;
+        pred.custom_properties = FILTER_PROPERTIES;
 
         GLib.Object (
             collection: filtered,
             settings: settings
         );
 
-        // The sorted model is the top level model
-        view.model = this;
+        this.index = index;
+        this.sort_keys = new SortKeys(collection);
+        this.view = view;
+        filtered.watch_predicate();
+        filtered.changes_started.connect(detach_view);
+        filtered.changes_finished.connect(reattach_view);
+
+        // Before the sorted model resorts a changed row, drop its old key
+        this.row_changed.connect(on_row_changed);
+
+        // The sorted model is the top level model. The view keeps it alive,
+        // as it refers back to this store.
+        Gtk.TreeModelSort sorted = new Gtk.TreeModelSort.with_model(this);
+        sorted.set_sort_func(Column.LABEL, this.sort_keys.compare_rows);
+        view.set_data<Gtk.TreeModelSort>("key-manager-sorted", sorted);
+        this.sorted = sorted;
+        view.model = sorted;
 
         // add the icon column
         Gtk.CellRendererPixbuf icon_renderer = new Gtk.CellRendererPixbuf();
@@ -166,7 +200,7 @@ public class Seahorse.KeyManagerStore : Gcr.CollectionModel {
             pred = null;
 
         // Also watch for sort-changed on the store
-        this.sort_column_changed.connect(on_sort_column_changed);
+        this.sorted.sort_column_changed.connect(on_sort_column_changed);
 
         // Update sort order in case the sorted column was added
         string? sort_by = settings.get_string("sort-by");
@@ -178,7 +212,7 @@ public class Seahorse.KeyManagerStore : Gcr.CollectionModel {
         view.set_rules_hint(true);
         view.set_headers_visible(false);
 
-        set_sort_column_id (Column.LABEL, Gtk.SortType.ASCENDING);
+        this.sorted.set_sort_column_id (Column.LABEL, Gtk.SortType.ASCENDING);
 
         // Tree drag
         Egg.TreeMultiDrag.add_drag_support (view);
@@ -191,7 +225,8 @@ public class Seahorse.KeyManagerStore : Gcr.CollectionModel {
     }
 
     ~KeyManagerStore() {
-        SignalHandler.disconnect_by_func((void*) this, (void*) on_sort_column_changed, (void*) this);
+        if (this.sorted != null)
+            SignalHandler.disconnect_by_func((void*) this.sorted, (void*) on_sort_column_changed, (void*) this);
     }
 
     // Search through row for text
@@ -200,19 +235,11 @@ public class Seahorse.KeyManagerStore : Gcr.CollectionModel {
         if (text == null || text == "")
             return true;
 
-        string? name = null;
-        object.get("label", out name, null);
-        if (name != null && (text in name.down()))
-            return true;
+        // Looked up all at once when refiltering
+        if (this.filter_matches != null)
+            return object in this.filter_matches;
 
-        if (object.get_class().find_property("description") != null) {
-            string? description = null;
-            object.get("description", out description, null);
-            if (description != null && (text in description.down()))
-                return true;
-        }
-
-        return false;
+        return this.index.matches(object, text);
     }
 
     // Called to filter each row
@@ -231,7 +258,58 @@ public class Seahorse.KeyManagerStore : Gcr.CollectionModel {
     }
 
     public void refilter() {
+        string text = this.filter ?? "";
+        if (text != "")
+            this.filter_matches = this.index.search(text);
+
         ((Collection) get_collection()).refresh();
+        this.filter_matches = null;
+        this.filtered_text = text;
+    }
+
+    // Refilter after only the filter text changed
+    private void refilter_text() {
+        Collection collection = (Collection) get_collection();
+        string text = this.filter ?? "";
+        string? previous = this.filtered_text;
+
+        if (previous == null) {
+            refilter();
+            return;
+        }
+
+        if (text == previous)
+            return;
+
+        // Longer text: only objects now shown can go away
+        if (previous in text) {
+            collection.refresh_objects(collection.get_objects());
+
+        // Shorter text: only objects now hidden can come back
+        } else if (text in previous) {
+            List<weak GLib.Object> candidates;
+            if (text == "") {
+                candidates = collection.base_collection.get_objects();
+            } else {
+                this.filter_matches = this.index.search(text);
+                candidates = this.filter_matches.get_values();
+            }
+
+            List<weak GLib.Object> hidden = new List<weak GLib.Object>();
+            foreach (weak GLib.Object obj in candidates) {
+                if (!collection.contains(obj))
+                    hidden.prepend(obj);
+            }
+
+            collection.refresh_objects(hidden);
+            this.filter_matches = null;
+
+        } else {
+            refilter();
+            return;
+        }
+
+        this.filtered_text = text;
     }
 
     // Refilter the tree after a timeout has passed
@@ -241,11 +319,42 @@ public class Seahorse.KeyManagerStore : Gcr.CollectionModel {
 
         this.filter_stag = Timeout.add (200, () => {
             this.filter_stag = 0;
-            refilter();
+            refilter_text();
             return false;
         });
     }
 
+    // Many rows are about to change. Gcr.CollectionModel still adds and
+    // removes them one at a time, so take the model away from the view
+    // meanwhile, rather than have it update its layout for every row.
+    private void detach_view(uint n_added, uint n_removed) {
+        if (this.view == null || this.view_detached || n_added + n_removed < BULK_CHANGE_ROWS)
+            return;
+
+        this.detached_selection = get_selected_objects(this.view);
+        this.view.model = null;
+        this.view_detached = true;
+    }
+
+    private void reattach_view() {
+        if (!this.view_detached)
+            return;
+
+        this.view_detached = false;
+        if (this.view == null)
+            return;
+
+        this.view.model = this.sorted;
+        set_selected_objects(this.view, this.detached_selection);
+        this.detached_selection = null;
+    }
+
+    private void on_row_changed(Gtk.TreePath path, Gtk.TreeIter iter) {
+        GLib.Object? obj = object_for_iter(iter);
+        if (obj != null)
+            this.sort_keys.forget(obj);
+    }
+
     // Update the sort order for a column
     private void set_sort_to(string name) {
         // Prefix with a minus means descending
@@ -266,7 +375,7 @@ public class Seahorse.KeyManagerStore : Gcr.CollectionModel {
         }
 
         if (id != -1)
-            set_sort_column_id(id, ord);
+            this.sorted.set_sort_column_id(id, ord);
     }
 
     // Called when the column sort is changed
@@ -277,7 +386,7 @@ public class Seahorse.KeyManagerStore : Gcr.CollectionModel {
         // We have a sort so save it
         int column_id;
         Gtk.SortType ord;
-        if (get_sort_column_id (out column_id, out ord)) {
+        if (sort.get_sort_column_id (out column_id, out ord)) {
             if (column_id >= 0 && column_id < Column.N_COLS) {
                 if (_columns[column_id].user_data != null) {
                     string sign = (ord == Gtk.SortType.DESCENDING)? "-" : "";
@@ -438,6 +547,15 @@ public class Seahorse.KeyManagerStore : Gcr.CollectionModel {
         Gtk.TreeIter? iter;
         if (!view.model.get_iter (out iter, path))
             return null;
+
+        // The view shows the store through a sorted model
+        if (view.model is Gtk.TreeModelSort) {
+            Gtk.TreeModelSort sorted = (Gtk.TreeModelSort) view.model;
+            Gtk.TreeIter child;
+            sorted.convert_iter_to_child_iter(out child, iter);
+            return ((Gcr.CollectionModel) sorted.get_model()).object_for_iter(child);
+        }
+
         return ((Gcr.CollectionModel) view.model).object_for_iter(iter);
     }
 
@@ -476,10 +594,19 @@ public class Seahorse.KeyManagerStore : Gcr.CollectionModel {
         Gtk.TreeSelection? selection = view.get_selection();
         selection.unselect_all();
 
+        Gtk.TreeModelSort? sorted = view.model as Gtk.TreeModelSort;
+        Gcr.CollectionModel model = (Gcr.CollectionModel) (sorted != null? sorted.get_model() : view.model);
+
         bool first = true;
         foreach (GLib.Object obj in objects) {
             Gtk.TreeIter iter = Gtk.TreeIter();
-            if (((Gcr.CollectionModel) view.model).iter_for_object (obj, iter)) {
+            if (model.iter_for_object (obj, iter)) {
+                // The view shows the store through a sorted model
+                if (sorted != null) {
+                    Gtk.TreeIter child = iter;
+                    sorted.convert_child_iter_to_iter(out iter, child);
+                }
+
                 selection.select_iter(iter);
 
                 // Scroll the first row selected into view
@@ -0,0 +1,47 @@
+/*
+ * Seahorse
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+namespace Seahorse {
+
+/**
+ * Implemented by objects so that a Predicate can read their usage and
+ * flags directly, instead of looking up the "usage" and "object-flags"
+ * properties through GValues.
+ */
+public interface Matchable : GLib.Object {
+	public abstract Usage get_match_usage();
+	public abstract Flags get_match_flags();
+
+	public static Usage usage_of(GLib.Object obj) {
+		if (obj is Matchable)
+			return ((Matchable)obj).get_match_usage();
+
+		Usage usage = Usage.NONE;
+		obj.get("usage", out usage, null);
+		return usage;
+	}
+
+	public static Flags flags_of(GLib.Object obj) {
+		if (obj is Matchable)
+			return ((Matchable)obj).get_match_flags();
+
+		Flags flags = Flags.NONE;
+		obj.get("object-flags", out flags, null);
+		return flags;
+	}
+}
+
+}
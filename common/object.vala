@@ -23,7 +23,7 @@
 /**
  * The base class for passwords/keys and others that are handled by Seahorse.
  */
-public class Seahorse.Object : GLib.Object {
+public class Seahorse.Object : GLib.Object, Matchable {
 
     // XXX only notify if changed
     /**
@@ -130,6 +130,14 @@ public class Seahorse.Object : GLib.Object {
         this.object_flags = flags;
     }
 
+    public Usage get_match_usage() {
+        return this.usage;
+    }
+
+    public Flags get_match_flags() {
+        return this.object_flags;
+    }
+
     // Recalculates nickname and markup from the label
     private void recalculate_label() {
         if (!this.markup_explicit) {
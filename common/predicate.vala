@@ -31,6 +31,39 @@ public struct Seahorse.Predicate {
     public PredicateFunc custom;
     public void* custom_target;
 
+    /**
+     * The properties the custom function looks at, or null if it could
+     * depend on any of them.
+     */
+    public unowned string[]? custom_properties;
+
+    /**
+     * Lists the properties of an object that the predicate depends on,
+     * so that changes to other properties can be ignored.
+     *
+     * @return false if the predicate could depend on any property
+     */
+    public bool get_properties(out string[] properties) {
+        string[] result = {};
+
+        if (this.usage != Usage.NONE)
+            result += "usage";
+        if (this.flags != 0 || this.nflags != 0)
+            result += "object-flags";
+
+        if (this.custom != null) {
+            if (this.custom_properties == null) {
+                properties = result;
+                return false;
+            }
+            foreach (unowned string property in this.custom_properties)
+                result += property;
+        }
+
+        properties = result;
+        return true;
+    }
+
     /**
      * Matches a seahorse object and a predicate
      *
@@ -43,17 +76,11 @@ public struct Seahorse.Predicate {
         if (this.type != 0 && !(obj.get_type().is_a(this.type) && this.type.is_a(obj.get_type())))
             return false;
 
-        if (this.usage != Usage.NONE) {
-            Usage obj_usage = Usage.NONE;
-            obj.get("usage", out obj_usage, null);
-
-            if (this.usage != obj_usage)
-                return false;
-        }
+        if (this.usage != Usage.NONE && this.usage != Matchable.usage_of(obj))
+            return false;
 
         if (this.flags != 0 || this.nflags != 0) {
-            Flags obj_flags = Flags.NONE;
-            obj.get("object-flags", out obj_flags, null);
+            Flags obj_flags = Matchable.flags_of(obj);
 
             if (this.flags != Flags.NONE && (obj_flags in this.flags))
                 return false;
@@ -68,3 +95,78 @@ public struct Seahorse.Predicate {
         return true;
     }
 }
+
+/**
+ * A predicate compiled down to just the checks it makes, cheapest first,
+ * for matching many objects in a row. It copies the fields of the
+ * predicate, so it has to be compiled again when the predicate changes.
+ */
+public class Seahorse.PredicatePlan {
+
+    private enum Step {
+        TYPE,
+        FLAGS,
+        USAGE,
+        CUSTOM
+    }
+
+    private Step[] steps = {};
+
+    private Type type;
+    private Usage usage;
+    private Flags flags;
+    private Flags nflags;
+    private PredicateFunc custom;
+    private void* custom_target;
+
+    public PredicatePlan(Predicate pred) {
+        this.type = pred.type;
+        this.usage = pred.usage;
+        this.flags = pred.flags;
+        this.nflags = pred.nflags;
+        this.custom = pred.custom;
+        this.custom_target = pred.custom_target;
+
+        if (this.type != 0)
+            this.steps += Step.TYPE;
+        if (this.flags != 0 || this.nflags != 0)
+            this.steps += Step.FLAGS;
+        if (this.usage != Usage.NONE)
+            this.steps += Step.USAGE;
+        if (this.custom != null)
+            this.steps += Step.CUSTOM;
+    }
+
+    /**
+     * Same as Predicate.match() on the predicate this was compiled from.
+     */
+    public bool match(GLib.Object obj) {
+        foreach (Step step in this.steps) {
+            switch (step) {
+            case Step.TYPE:
+                // An exact type match, as in Predicate.match()
+                if (obj.get_type() != this.type)
+                    return false;
+                break;
+            case Step.FLAGS: {
+                Flags obj_flags = Matchable.flags_of(obj);
+                if (this.flags != Flags.NONE && (obj_flags in this.flags))
+                    return false;
+                if (this.nflags != Flags.NONE && (obj_flags in this.nflags))
+                    return false;
+                break;
+            }
+            case Step.USAGE:
+                if (this.usage != Matchable.usage_of(obj))
+                    return false;
+                break;
+            case Step.CUSTOM:
+                if (!this.custom(obj, this.custom_target))
+                    return false;
+                break;
+            }
+        }
+
+        return true;
+    }
+}
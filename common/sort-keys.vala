@@ -0,0 +1,110 @@
+/*
+ * Seahorse
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * Keeps a collation key for the label of every object in a collection,
+ * so sorting by label compares plain strings rather than collating the
+ * labels again on every comparison.
+ *
+ * A key is made when first needed and dropped when the label changes.
+ */
+public class Seahorse.SortKeys : GLib.Object {
+
+    private Gcr.Collection collection;
+
+    // The collation key of each object's casefolded label
+    private HashTable<GLib.Object, string> keys;
+
+    public SortKeys(Gcr.Collection collection) {
+        this.collection = collection;
+        this.keys = new HashTable<GLib.Object, string>(direct_hash, direct_equal);
+
+        collection.removed.connect(on_collection_removed);
+    }
+
+    ~SortKeys() {
+        SignalHandler.disconnect_by_func((void*) this.collection, (void*) on_collection_removed, this);
+
+        foreach (weak GLib.Object obj in this.keys.get_keys())
+            SignalHandler.disconnect_by_func((void*) obj, (void*) on_label_changed, this);
+    }
+
+    /**
+     * The collation key for the label of the object.
+     */
+    public unowned string get_key(GLib.Object obj) {
+        unowned string? key = this.keys.lookup(obj);
+        if (key != null)
+            return key;
+
+        string? label = null;
+        obj.get("label", out label, null);
+
+        // Only watch the label while there's a key to drop
+        obj.notify["label"].connect(on_label_changed);
+
+        this.keys.insert(obj, (label ?? "").casefold().collate_key());
+        return this.keys.lookup(obj);
+    }
+
+    /**
+     * Orders objects by label, as g_utf8_collate() on the casefolded labels
+     * would.
+     */
+    public int compare(GLib.Object a, GLib.Object b) {
+        if (a == b)
+            return 0;
+
+        int result = strcmp(get_key(a), get_key(b));
+        if (result != 0)
+            return result;
+
+        // Keep the order stable for equal labels
+        return ((void*) a > (void*) b)? 1 : -1;
+    }
+
+    /**
+     * A Gtk.TreeIterCompareFunc for rows of a Gcr.CollectionModel.
+     */
+    public int compare_rows(Gtk.TreeModel model, Gtk.TreeIter a, Gtk.TreeIter b) {
+        Gcr.CollectionModel collection_model = (Gcr.CollectionModel) model;
+        GLib.Object? obj_a = collection_model.object_for_iter(a);
+        GLib.Object? obj_b = collection_model.object_for_iter(b);
+
+        if (obj_a == null || obj_b == null)
+            return (obj_a == null? 0 : 1) - (obj_b == null? 0 : 1);
+
+        return compare(obj_a, obj_b);
+    }
+
+    /**
+     * Drops the key of the object, for when its label may have changed
+     * before notify::label got here.
+     */
+    public void forget(GLib.Object obj) {
+        if (this.keys.remove(obj))
+            SignalHandler.disconnect_by_func((void*) obj, (void*) on_label_changed, this);
+    }
+
+    private void on_label_changed(GLib.Object obj, ParamSpec spec) {
+        forget(obj);
+    }
+
+    private void on_collection_removed(Gcr.Collection collection, GLib.Object obj) {
+        forget(obj);
+    }
+}
@@ -46,7 +46,7 @@ private struct DisplayEntry {
 	DisplayCustom? custom_func;
 }
 
-public class Item : Secret.Item, Deletable, Viewable {
+public class Item : Secret.Item, Deletable, Viewable, Matchable {
 	public string description {
 		owned get {
 			ensure_display_info ();
@@ -146,6 +146,14 @@ public class Item : Secret.Item, Deletable, Viewable {
 		return new ItemProperties(this, parent);
 	}
 
+	public Usage get_match_usage() {
+		return this.usage;
+	}
+
+	public Flags get_match_flags() {
+		return this.object_flags;
+	}
+
 	private void ensure_display_info() {
 		if (this._info != null)
 			return;
@@ -45,7 +45,12 @@ struct _SeahorseSearchProvider {
 
 	SeahorsePredicate base_predicate;
 	GcrCollection *collection;
-	GHashTable *handles;
+	SeahorseFilterIndex *index;
+	GHashTable *ids;                /* result id -> object */
+	GHashTable *object_ids;         /* object -> result id */
+	GHashTable *shadowed;           /* object -> result id already taken by another copy */
+	GHashTable *stored;             /* result id -> StoredResult, saved last time */
+	guint save_timeout;
 	GList *queued_requests;
 	int n_loading;
 };
@@ -62,50 +67,212 @@ G_DEFINE_TYPE_WITH_CODE (SeahorseSearchProvider, seahorse_search_provider, SEAHO
 typedef struct {
 	GDBusMethodInvocation *invocation;
 	char                 **terms;
+	char                  *identifier;
+	guint                  timestamp;
 } QueuedRequest;
 
-/* Search through row for text */
-static gboolean
-object_contains_filtered_text (GObject     *object,
-			       const gchar *text)
-{
-	gchar* name = NULL;
-	gchar* description = NULL;
-	gchar* lower;
-	gboolean ret = FALSE;
-
-	g_object_get (object, "label", &name, NULL);
-	if (name != NULL) {
-		lower = g_utf8_strdown (name, -1);
-		if (strstr (lower, text))
-			ret = TRUE;
-		g_free (lower);
-		g_free (name);
+/* Delay before writing out the stored results after a change */
+#define STORED_SAVE_DELAY      5
+
+typedef struct {
+	gchar *name;
+	gchar *description;
+	gchar *icon;
+	gchar *text;            /* Folded name and description, for matching */
+} StoredResult;
+
+static gboolean handle_activate_result (SeahorseShellSearchProvider2 *skeleton,
+                                        GDBusMethodInvocation        *invocation,
+                                        const char                   *identifier,
+                                        const char * const           *results,
+                                        guint                         timestamp);
+
+/* Anything else is known by a digest of its label and identifier */
+static gchar *
+calc_content_value (GObject *object)
+{
+	gchar *label = NULL;
+	const gchar *identifier = NULL;
+	gchar *text;
+	gchar *value;
+
+	if (g_object_class_find_property (G_OBJECT_GET_CLASS (object), "label"))
+		g_object_get (object, "label", &label, NULL);
+	if (SEAHORSE_IS_OBJECT (object))
+		identifier = seahorse_object_get_identifier (SEAHORSE_OBJECT (object));
+
+	text = g_strdup_printf ("%s\n%s", label ? label : "", identifier ? identifier : "");
+	value = g_compute_checksum_for_string (G_CHECKSUM_SHA1, text, -1);
+
+	g_free (label);
+	g_free (text);
+	return value;
+}
+
+/*
+ * Result ids stay the same across restarts: keys are known by their
+ * fingerprint, other items by their D-Bus object path, certificates by
+ * the digest of their DER data.
+ */
+static gchar *
+calc_result_id (GObject *object)
+{
+	gchar *value = NULL;
+	gchar *id;
+
+	if (g_object_class_find_property (G_OBJECT_GET_CLASS (object), "fingerprint"))
+		g_object_get (object, "fingerprint", &value, NULL);
+	else if (G_IS_DBUS_PROXY (object))
+		value = g_strdup (g_dbus_proxy_get_object_path (G_DBUS_PROXY (object)));
+	else if (GCR_IS_CERTIFICATE (object))
+		value = gcr_certificate_get_fingerprint_hex (GCR_CERTIFICATE (object), G_CHECKSUM_SHA1);
+
+	if (value == NULL || !value[0]) {
+		g_free (value);
+		value = calc_content_value (object);
 	}
 
-	if (!ret && g_object_class_find_property (G_OBJECT_GET_CLASS (object), "description")) {
-		g_object_get (object, "description", &description, NULL);
-		if (description != NULL) {
-			lower = g_utf8_strdown (description, -1);
-			if (strstr (lower, text))
-				ret = TRUE;
-			g_free (lower);
-			g_free (description);
+	id = g_strdup_printf ("%s:%s", G_OBJECT_TYPE_NAME (object), value);
+	g_free (value);
+	return id;
+}
+
+/*
+ * A copy of the searchable fields of all results is kept on disk, so
+ * searches can be answered right away while the backends are still
+ * loading after login.
+ */
+
+static void
+stored_result_free (gpointer data)
+{
+	StoredResult *stored = data;
+	g_free (stored->name);
+	g_free (stored->description);
+	g_free (stored->icon);
+	g_free (stored->text);
+	g_free (stored);
+}
+
+static gchar *
+stored_results_path (void)
+{
+	return g_build_filename (g_get_user_cache_dir (), "seahorse", "search-provider", NULL);
+}
+
+static void
+load_stored_results (SeahorseSearchProvider *self)
+{
+	StoredResult *stored;
+	GKeyFile *file;
+	gchar **groups;
+	gchar *path;
+	gchar *text;
+	guint i;
+
+	file = g_key_file_new ();
+	path = stored_results_path ();
+
+	if (g_key_file_load_from_file (file, path, G_KEY_FILE_NONE, NULL)) {
+		groups = g_key_file_get_groups (file, NULL);
+		for (i = 0; groups[i] != NULL; i++) {
+			stored = g_new0 (StoredResult, 1);
+			stored->name = g_key_file_get_string (file, groups[i], "name", NULL);
+			stored->description = g_key_file_get_string (file, groups[i], "description", NULL);
+			stored->icon = g_key_file_get_string (file, groups[i], "icon", NULL);
+
+			text = g_strdup_printf ("%s\n%s", stored->name ? stored->name : "",
+			                        stored->description ? stored->description : "");
+			stored->text = seahorse_filter_index_fold (text);
+			g_free (text);
+
+			g_hash_table_insert (self->stored, g_strdup (groups[i]), stored);
 		}
+		g_strfreev (groups);
 	}
 
-	return ret;
+	g_free (path);
+	g_key_file_free (file);
+}
+
+static void
+save_stored_results (SeahorseSearchProvider *self)
+{
+	GHashTableIter iter;
+	GKeyFile *file;
+	GError *error = NULL;
+	gchar *name, *description;
+	gpointer id, object;
+	GIcon *icon;
+	gchar *icon_string;
+	gchar *path;
+	gchar *dir;
+
+	file = g_key_file_new ();
+
+	g_hash_table_iter_init (&iter, self->ids);
+	while (g_hash_table_iter_next (&iter, &id, &object)) {
+		name = description = NULL;
+		icon = NULL;
+		g_object_get (object, "label", &name, "icon", &icon, NULL);
+		if (g_object_class_find_property (G_OBJECT_GET_CLASS (object), "description"))
+			g_object_get (object, "description", &description, NULL);
+
+		g_key_file_set_string (file, id, "name", name ? name : "");
+		if (description)
+			g_key_file_set_string (file, id, "description", description);
+		if (icon) {
+			icon_string = g_icon_to_string (icon);
+			if (icon_string)
+				g_key_file_set_string (file, id, "icon", icon_string);
+			g_free (icon_string);
+			g_object_unref (icon);
+		}
+
+		g_free (name);
+		g_free (description);
+	}
+
+	path = stored_results_path ();
+	dir = g_path_get_dirname (path);
+	g_mkdir_with_parents (dir, 0700);
+
+	if (!g_key_file_save_to_file (file, path, &error)) {
+		g_message ("couldn't save search results: %s", error->message);
+		g_clear_error (&error);
+	}
+
+	g_free (dir);
+	g_free (path);
+	g_key_file_free (file);
+}
+
+static gboolean
+on_save_stored_timeout (gpointer user_data)
+{
+	SeahorseSearchProvider *self = SEAHORSE_SEARCH_PROVIDER (user_data);
+
+	self->save_timeout = 0;
+	save_stored_results (self);
+	return G_SOURCE_REMOVE;
+}
+
+static void
+schedule_save_stored (SeahorseSearchProvider *self)
+{
+	if (self->save_timeout == 0)
+		self->save_timeout = g_timeout_add_seconds (STORED_SAVE_DELAY,
+		                                            on_save_stored_timeout, self);
 }
 
 static gboolean
-object_matches_search (GObject     *object,
-		       gpointer     user_data)
+stored_matches_terms (StoredResult *stored,
+                      gchar **folded)
 {
-	char **terms = user_data;
 	int i;
 
-	for (i = 0; terms[i]; i++) {
-		if (!object_contains_filtered_text (object, terms[i]))
+	for (i = 0; folded[i]; i++) {
+		if (!strstr (stored->text, folded[i]))
 			return FALSE;
 	}
 
@@ -113,28 +280,144 @@ object_matches_search (GObject     *object,
 }
 
 static void
-init_predicate (SeahorsePredicate  *predicate,
-                char              **terms)
+on_collection_added (GcrCollection *collection,
+                     GObject *object,
+                     gpointer user_data)
 {
-	memset(predicate, 0, sizeof(SeahorsePredicate));
+	SeahorseSearchProvider *self = SEAHORSE_SEARCH_PROVIDER (user_data);
+	gchar *id;
+
+	if (g_hash_table_contains (self->object_ids, object) ||
+	    g_hash_table_contains (self->shadowed, object))
+		return;
+
+	/* The same key in two places keeps the first one, until it goes */
+	id = calc_result_id (object);
+	if (g_hash_table_contains (self->ids, id)) {
+		g_hash_table_insert (self->shadowed, object, id);
+		return;
+	}
+
+	g_hash_table_insert (self->ids, id, object);
+	g_hash_table_insert (self->object_ids, object, id);
 
-	predicate->custom = object_matches_search;
-	predicate->custom_target = terms;
+	if (self->n_loading <= 0)
+		schedule_save_stored (self);
 }
 
 static void
-on_object_gone (gpointer data,
-		GObject *where_the_object_was)
+on_collection_removed (GcrCollection *collection,
+                       GObject *object,
+                       gpointer user_data)
 {
-	GHashTable *handles = data;
-	gchar *str = g_strdup_printf ("%p", (gpointer)where_the_object_was);
-	g_hash_table_remove (handles, str);
-	g_free (str);
+	SeahorseSearchProvider *self = SEAHORSE_SEARCH_PROVIDER (user_data);
+	GHashTableIter iter;
+	gpointer other;
+	gpointer other_id;
+	const gchar *id;
+
+	if (g_hash_table_remove (self->shadowed, object))
+		return;
+
+	id = g_hash_table_lookup (self->object_ids, object);
+	if (id == NULL)
+		return;
+
+	g_hash_table_remove (self->ids, id);
+
+	/* Another copy of the same item takes over the id */
+	g_hash_table_iter_init (&iter, self->shadowed);
+	while (g_hash_table_iter_next (&iter, &other, &other_id)) {
+		if (g_str_equal (other_id, id)) {
+			g_hash_table_iter_steal (&iter);
+			g_hash_table_insert (self->ids, other_id, other);
+			g_hash_table_insert (self->object_ids, other, other_id);
+			break;
+		}
+	}
+
+	g_hash_table_remove (self->object_ids, object);
+
+	if (self->n_loading <= 0)
+		schedule_save_stored (self);
 }
 
-/* We called before loading, we queue GetInitialResultSet, but
-   we drop all other calls, because we don't expect to see them
-   before we reply to GetInitialResultSet
+static gchar **
+fold_terms (const char * const *terms)
+{
+	GPtrArray *folded;
+	int i;
+
+	folded = g_ptr_array_new ();
+	for (i = 0; terms[i]; i++)
+		g_ptr_array_add (folded, seahorse_filter_index_fold (terms[i]));
+	g_ptr_array_add (folded, NULL);
+
+	return (gchar **)g_ptr_array_free (folded, FALSE);
+}
+
+static gboolean
+object_matches_terms (SeahorseSearchProvider *self,
+                      GObject *object,
+                      gchar **folded)
+{
+	int i;
+
+	for (i = 0; folded[i]; i++) {
+		if (!seahorse_filter_index_matches (self->index, object, folded[i]))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+typedef struct {
+	const gchar *id;
+	const gchar *text;
+	gint score;
+} RankedResult;
+
+/* Matches at the start of the name rank highest, then at word starts */
+static gint
+calc_result_score (const gchar *text,
+                   gchar **folded)
+{
+	const gchar *at;
+	const gchar *name_end;
+	gint score = 0;
+	int i;
+
+	name_end = strchr (text, '\n');
+	for (i = 0; folded[i]; i++) {
+		at = strstr (text, folded[i]);
+		if (at == NULL)
+			continue;
+		if (at == text)
+			score += 4;
+		else if (!g_unichar_isalnum (g_utf8_get_char (g_utf8_prev_char (at))))
+			score += 2;
+		if (name_end == NULL || at < name_end)
+			score += 1;
+	}
+
+	return score;
+}
+
+static gint
+compare_ranked_results (gconstpointer a,
+                        gconstpointer b)
+{
+	const RankedResult *ra = a;
+	const RankedResult *rb = b;
+
+	if (ra->score != rb->score)
+		return rb->score - ra->score;
+	return g_strcmp0 (ra->text, rb->text);
+}
+
+/* While loading, searches are answered from the stored results, or
+   queued when there are none. Activations are queued until we know
+   whether the result still exists.
 */
 
 static void
@@ -165,7 +448,7 @@ queue_request_if_not_loaded (SeahorseSearchProvider *self,
 	if (self->n_loading <= 0)
 		return FALSE;
 
-	req = g_slice_new (QueuedRequest);
+	req = g_slice_new0 (QueuedRequest);
 	req->invocation = g_object_ref (invocation);
 	req->terms = g_strdupv ((char**) terms);
 
@@ -174,16 +457,71 @@ queue_request_if_not_loaded (SeahorseSearchProvider *self,
 }
 
 static gboolean
-error_request_if_not_loaded (SeahorseSearchProvider *self,
-			     GDBusMethodInvocation  *invocation)
+queue_activate_if_not_loaded (SeahorseSearchProvider *self,
+                              GDBusMethodInvocation  *invocation,
+                              const char             *identifier,
+                              guint                   timestamp)
 {
-	if (self->n_loading > 0) {
-		g_dbus_method_invocation_return_dbus_error (invocation,
-							    "org.gnome.Seahore.Error.NotLoaded",
-							    _("The search provider is not loaded yet"));
-		return TRUE;
-	} else {
+	QueuedRequest *req;
+
+	if (self->n_loading <= 0)
 		return FALSE;
+
+	req = g_slice_new0 (QueuedRequest);
+	req->invocation = g_object_ref (invocation);
+	req->identifier = g_strdup (identifier);
+	req->timestamp = timestamp;
+
+	self->queued_requests = g_list_prepend (self->queued_requests, req);
+	return TRUE;
+}
+
+static void
+rank_live_results (SeahorseSearchProvider *self,
+                   gchar **folded,
+                   GArray *ranked)
+{
+	GHashTable *candidates;
+	GHashTableIter iter;
+	RankedResult result;
+	gpointer object;
+
+	/* The index finds the candidates for one term, the others are checked */
+	candidates = seahorse_filter_index_search (self->index, folded[0]);
+
+	g_hash_table_iter_init (&iter, candidates);
+	while (g_hash_table_iter_next (&iter, &object, NULL)) {
+		result.id = g_hash_table_lookup (self->object_ids, object);
+		if (result.id == NULL || !object_matches_terms (self, object, folded + 1))
+			continue;
+
+		result.text = seahorse_filter_index_get_text (self->index, object);
+		result.score = calc_result_score (result.text, folded);
+		g_array_append_val (ranked, result);
+	}
+
+	g_hash_table_unref (candidates);
+}
+
+static void
+rank_stored_results (SeahorseSearchProvider *self,
+                     gchar **folded,
+                     GArray *ranked)
+{
+	GHashTableIter iter;
+	RankedResult result;
+	StoredResult *stored;
+	gpointer id;
+
+	g_hash_table_iter_init (&iter, self->stored);
+	while (g_hash_table_iter_next (&iter, &id, (gpointer *)&stored)) {
+		if (!stored_matches_terms (stored, folded))
+			continue;
+
+		result.id = id;
+		result.text = stored->text;
+		result.score = calc_result_score (result.text, folded);
+		g_array_append_val (ranked, result);
 	}
 }
 
@@ -193,34 +531,38 @@ handle_get_initial_result_set (SeahorseShellSearchProvider2 *skeleton,
                                const char * const           *terms)
 {
 	SeahorseSearchProvider *self = SEAHORSE_SEARCH_PROVIDER (skeleton);
-	SeahorsePredicate   predicate;
+	GArray *ranked;
 	GPtrArray *array;
-	GList *objects, *l;
+	gchar **folded;
 	char **results;
+	guint i;
 
 	hold_app ();
 
-	if (queue_request_if_not_loaded (self, invocation, terms))
+	/* Nothing stored from last time, so wait for the backends */
+	if (g_hash_table_size (self->stored) == 0 &&
+	    queue_request_if_not_loaded (self, invocation, terms))
 		return TRUE;
 
-	init_predicate (&predicate, (char **) terms);
-
 	array = g_ptr_array_new ();
-	objects = gcr_collection_get_objects (self->collection);
+	folded = fold_terms (terms);
 
-	for (l = objects; l; l = l->next) {
-		if (seahorse_predicate_match (&predicate, l->data)) {
-			char *str = g_strdup_printf("%p", l->data);
+	if (folded[0] != NULL) {
+		ranked = g_array_new (FALSE, FALSE, sizeof (RankedResult));
 
-			if (!g_hash_table_contains (self->handles, str)) {
-				g_hash_table_insert (self->handles, g_strdup (str), l->data);
-				g_object_weak_ref (l->data, on_object_gone, self->handles);
-			}
-			g_ptr_array_add (array, str);
-		}
+		if (self->n_loading > 0)
+			rank_stored_results (self, folded, ranked);
+		else
+			rank_live_results (self, folded, ranked);
+
+		g_array_sort (ranked, compare_ranked_results);
+		for (i = 0; i < ranked->len; i++)
+			g_ptr_array_add (array, g_strdup (g_array_index (ranked, RankedResult, i).id));
+
+		g_array_free (ranked, TRUE);
 	}
 
-	g_list_free (objects);
+	g_strfreev (folded);
 	g_ptr_array_add (array, NULL);
 	results = (char **) g_ptr_array_free (array, FALSE);
 
@@ -240,33 +582,41 @@ handle_get_subsearch_result_set (SeahorseShellSearchProvider2 *skeleton,
                                  const char * const           *terms)
 {
 	SeahorseSearchProvider *self = SEAHORSE_SEARCH_PROVIDER (skeleton);
-	SeahorsePredicate   predicate;
 	GPtrArray *array;
+	gchar **folded;
 	int i;
 	char **results;
 
-       	if (error_request_if_not_loaded (self, invocation))
-		return TRUE;
-
 	hold_app ();
-	init_predicate (&predicate, (char **) terms);
+	folded = fold_terms (terms);
 
 	array = g_ptr_array_new ();
 
 	for (i = 0; previous_results[i]; i++) {
 		GObject *object;
+		StoredResult *stored;
 
-		object = g_hash_table_lookup (self->handles, previous_results[i]);
-		if (!object || !gcr_collection_contains (self->collection, object)) {
+		/* Still loading, match against what was stored */
+		if (self->n_loading > 0) {
+			stored = g_hash_table_lookup (self->stored, previous_results[i]);
+			if (stored && stored_matches_terms (stored, folded))
+				g_ptr_array_add (array, (char*) previous_results[i]);
+			continue;
+		}
+
+		object = g_hash_table_lookup (self->ids, previous_results[i]);
+		if (!object) {
 			/* Bogus value */
 			continue;
 		}
 
-		if (seahorse_predicate_match (&predicate, object)) {
+		/* Keeps the ranking of the previous results */
+		if (object_matches_terms (self, object, folded)) {
 			g_ptr_array_add (array, (char*) previous_results[i]);
 		}
 	}
 
+	g_strfreev (folded);
 	g_ptr_array_add (array, NULL);
 	results = (char **) g_ptr_array_free (array, FALSE);
 
@@ -292,27 +642,34 @@ handle_get_result_metas (SeahorseShellSearchProvider2 *skeleton,
 	GVariant *icon_variant;
 	GIcon *icon;
 
-	if (error_request_if_not_loaded (self, invocation))
-		return TRUE;
-
 	hold_app ();
 	g_variant_builder_init (&builder, G_VARIANT_TYPE ("aa{sv}"));
 
 	for (i = 0; results[i]; i++) {
 		GObject *object;
+		StoredResult *stored;
+
+		object = g_hash_table_lookup (self->ids, results[i]);
+		stored = g_hash_table_lookup (self->stored, results[i]);
+
+		if (object) {
+			g_object_get (object,
+			              "label", &name,
+			              "icon", &icon,
+			              "description", &description,
+			              NULL);
 
-		object = g_hash_table_lookup (self->handles, results[i]);
-		if (!object || !gcr_collection_contains (self->collection, object)) {
+		/* Not loaded yet */
+		} else if (stored) {
+			name = g_strdup (stored->name);
+			description = g_strdup (stored->description);
+			icon = stored->icon ? g_icon_new_for_string (stored->icon, NULL) : NULL;
+
+		} else {
 			/* Bogus value */
 			continue;
 		}
 
-		g_object_get (object,
-		              "label", &name,
-		              "icon", &icon,
-		              "description", &description,
-		              NULL);
-
 		g_variant_builder_open (&builder, G_VARIANT_TYPE ("a{sv}"));
 		g_variant_builder_add (&builder, "{sv}",
 		                       "id", g_variant_new_string (results[i]));
@@ -360,21 +717,18 @@ handle_activate_result (SeahorseShellSearchProvider2 *skeleton,
 	GObject *object;
 	SeahorseKeyManager *key_manager;
 
-	if (error_request_if_not_loaded (self, invocation))
-		return TRUE;
-
 	hold_app ();
-	sscanf (identifier, "%p", &object);
 
-	object = g_hash_table_lookup (self->handles, identifier);
-	if (!object || !gcr_collection_contains (self->collection, object) ||
-	    !SEAHORSE_IS_VIEWABLE (object)) {
-		/* Bogus value */
+	/* Wait until we know whether it still exists */
+	if (queue_activate_if_not_loaded (self, invocation, identifier, timestamp))
 		return TRUE;
-	}
 
+	/* Show the key manager for results that have gone away since stored */
 	key_manager = seahorse_key_manager_show (timestamp);
-	seahorse_viewable_view (object, GTK_WINDOW (key_manager));
+
+	object = g_hash_table_lookup (self->ids, identifier);
+	if (object && SEAHORSE_IS_VIEWABLE (object))
+		seahorse_viewable_view (object, GTK_WINDOW (key_manager));
 
 	seahorse_shell_search_provider2_complete_activate_result (skeleton,
 	                                                          invocation);
@@ -430,18 +784,28 @@ on_backend_loaded (GObject    *object,
 	if (self->n_loading > 0)
 		return;
 
+	/* Replace what was stored with what actually loaded */
+	save_stored_results (self);
+	g_hash_table_remove_all (self->stored);
+
 	for (iter = self->queued_requests; iter; iter = iter->next) {
 		QueuedRequest *req = iter->data;
 
-		handle_get_initial_result_set (SEAHORSE_SHELL_SEARCH_PROVIDER2 (self),
-					       req->invocation,
-					       (const char * const *) req->terms);
+		if (req->identifier)
+			handle_activate_result (SEAHORSE_SHELL_SEARCH_PROVIDER2 (self),
+			                        req->invocation, req->identifier,
+			                        NULL, req->timestamp);
+		else
+			handle_get_initial_result_set (SEAHORSE_SHELL_SEARCH_PROVIDER2 (self),
+						       req->invocation,
+						       (const char * const *) req->terms);
 
-		/* In the previous get_initial_result_set() we had one unbalanced
+		/* In the previous call we had one unbalanced
 		   hold, so we release it now. */
 		release_app ();
 		g_object_unref (req->invocation);
 		g_strfreev (req->terms);
+		g_free (req->identifier);
 		g_slice_free (QueuedRequest, req);
 	}
 
@@ -471,6 +835,9 @@ seahorse_search_provider_initialize (SeahorseSearchProvider *self)
 	g_list_free (backends);
 }
 
+/* The type of an object doesn't change */
+static const gchar *no_properties[] = { NULL };
+
 static gboolean
 check_object_type (GObject  *object,
 		   gpointer  user_data)
@@ -510,12 +877,21 @@ seahorse_search_provider_init (SeahorseSearchProvider *self)
 
 	self->base_predicate.flags = SEAHORSE_FLAG_PERSONAL;
 	self->base_predicate.custom = check_object_type;
+	self->base_predicate.custom_properties = (gchar **)no_properties;
+	self->base_predicate.custom_properties_length1 = 0;
 
 	filtered = seahorse_collection_new_for_predicate (base,
 	                                                  &self->base_predicate, NULL);
 	self->collection = GCR_COLLECTION (filtered);
-
-	self->handles = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	self->index = seahorse_filter_index_new (self->collection);
+
+	self->ids = g_hash_table_new (g_str_hash, g_str_equal);
+	self->object_ids = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, g_free);
+	self->shadowed = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, g_free);
+	self->stored = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, stored_result_free);
+	load_stored_results (self);
+	g_signal_connect (self->collection, "added", G_CALLBACK (on_collection_added), self);
+	g_signal_connect (self->collection, "removed", G_CALLBACK (on_collection_removed), self);
 }
 
 gboolean
@@ -551,6 +927,18 @@ seahorse_search_provider_dispose (GObject *object)
 
 	self = SEAHORSE_SEARCH_PROVIDER (object);
 
+	if (self->save_timeout) {
+		g_source_remove (self->save_timeout);
+		self->save_timeout = 0;
+		save_stored_results (self);
+	}
+
+	if (self->collection) {
+		g_signal_handlers_disconnect_by_func (self->collection, on_collection_added, self);
+		g_signal_handlers_disconnect_by_func (self->collection, on_collection_removed, self);
+	}
+
+	g_clear_object (&self->index);
 	g_clear_object (&self->collection);
 
 	G_OBJECT_CLASS (seahorse_search_provider_parent_class)->dispose (object);
@@ -560,13 +948,11 @@ static void
 seahorse_search_provider_finalize (GObject *object)
 {
 	SeahorseSearchProvider *self = SEAHORSE_SEARCH_PROVIDER (object);
-	GHashTableIter iter;
-	gpointer value;
 
-	g_hash_table_iter_init (&iter, self->handles);
-	while (g_hash_table_iter_next (&iter, NULL, &value))
-		g_object_weak_unref (value, on_object_gone, self->handles);
-	g_hash_table_destroy (self->handles);
+	g_hash_table_destroy (self->ids);
+	g_hash_table_destroy (self->object_ids);
+	g_hash_table_destroy (self->shadowed);
+	g_hash_table_destroy (self->stored);
 
 	G_OBJECT_CLASS (seahorse_search_provider_parent_class)->finalize (object);
 }
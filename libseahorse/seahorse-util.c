@@ -185,59 +185,202 @@ seahorse_util_printf_fd (int fd, const char* fmt, ...)
     return ret;
 }
 
-/** 
- * seahorse_util_read_data_block:
- * @buf: A string buffer to write the data to.
+/* Amount read from the input stream at a time */
+#define SCANNER_CHUNK 65536
+
+struct _SeahorseBlockScanner {
+    GInputStream *input;
+    gchar *start;
+    gsize n_start;
+    gchar *end;
+    gsize n_end;
+    GByteArray *buffer;
+    gsize consumed;
+    gboolean eof;
+};
+
+/**
+ * seahorse_block_scanner_new:
  * @input: The input stream to read from.
  * @start: The start signature to look for.
  * @end: The end signature to look for.
  *
- * Breaks out one block of data (usually a key)
+ * Creates a scanner which breaks out blocks of data (usually keys)
+ * delimited by @start and @end from @input. The stream is read in large
+ * chunks rather than a byte at a time.
  *
- * Returns: The number of bytes copied.
+ * Returns: The new scanner, free with seahorse_block_scanner_free().
  */
-guint
-seahorse_util_read_data_block (GString *buf, GInputStream *input, 
-                               const gchar *start, const gchar* end)
+SeahorseBlockScanner *
+seahorse_block_scanner_new (GInputStream *input,
+                            const gchar *start,
+                            const gchar *end)
 {
-    const gchar *t;
-    guint copied = 0;
-    gchar ch;
-    gsize read;
-     
+    SeahorseBlockScanner *scanner;
+
+    g_return_val_if_fail (G_IS_INPUT_STREAM (input), NULL);
+    g_return_val_if_fail (start && start[0], NULL);
+    g_return_val_if_fail (end && end[0], NULL);
+
+    scanner = g_new0 (SeahorseBlockScanner, 1);
+    scanner->input = g_object_ref (input);
+    scanner->start = g_strdup (start);
+    scanner->n_start = strlen (start);
+    scanner->end = g_strdup (end);
+    scanner->n_end = strlen (end);
+    scanner->buffer = g_byte_array_sized_new (SCANNER_CHUNK);
+
+    return scanner;
+}
+
+/**
+ * seahorse_block_scanner_free:
+ * @scanner: The scanner
+ *
+ * Frees the scanner. Any blocks it returned are no longer valid.
+ */
+void
+seahorse_block_scanner_free (SeahorseBlockScanner *scanner)
+{
+    if (scanner == NULL)
+        return;
+
+    g_object_unref (scanner->input);
+    g_free (scanner->start);
+    g_free (scanner->end);
+    g_byte_array_unref (scanner->buffer);
+    g_free (scanner);
+}
+
+static const gchar *
+scanner_find (const gchar *data,
+              gsize n_data,
+              const gchar *marker,
+              gsize n_marker)
+{
+    const gchar *at = data;
+    const gchar *end = data + n_data;
+
+    while ((gsize)(end - at) >= n_marker) {
+        at = memchr (at, marker[0], (end - at) - n_marker + 1);
+        if (at == NULL)
+            return NULL;
+        if (memcmp (at, marker, n_marker) == 0)
+            return at;
+        at++;
+    }
+
+    return NULL;
+}
+
+static void
+scanner_discard (SeahorseBlockScanner *scanner,
+                 gsize length)
+{
+    if (length > 0)
+        g_byte_array_remove_range (scanner->buffer, 0, length);
+}
+
+static gboolean
+scanner_fill (SeahorseBlockScanner *scanner,
+              GCancellable *cancellable,
+              GError **error)
+{
+    gsize len = scanner->buffer->len;
+    gssize count;
+
+    g_byte_array_set_size (scanner->buffer, len + SCANNER_CHUNK);
+    count = g_input_stream_read (scanner->input, scanner->buffer->data + len,
+                                 SCANNER_CHUNK, cancellable, error);
+    g_byte_array_set_size (scanner->buffer, len + MAX (count, 0));
+
+    if (count == 0)
+        scanner->eof = TRUE;
+
+    return count >= 0;
+}
+
+/**
+ * seahorse_block_scanner_next:
+ * @scanner: The scanner
+ * @block: Returns the block, including the start and end signatures.
+ * @n_block: Returns the length of the block.
+ * @cancellable: Optional cancellation object
+ * @error: Location to place an error
+ *
+ * Finds the next block of data. The returned block points into the
+ * scanner's buffer, is not nul-terminated, and is only valid until the
+ * next call. A block missing its end signature runs to the end of the
+ * stream.
+ *
+ * Returns: FALSE when there are no more blocks, or on error.
+ */
+gboolean
+seahorse_block_scanner_next (SeahorseBlockScanner *scanner,
+                             const gchar **block,
+                             gsize *n_block,
+                             GCancellable *cancellable,
+                             GError **error)
+{
+    const gchar *data;
+    const gchar *at;
+    gsize searched;
+    gsize len;
+
+    g_return_val_if_fail (scanner != NULL, FALSE);
+    g_return_val_if_fail (block != NULL, FALSE);
+    g_return_val_if_fail (n_block != NULL, FALSE);
+
+    /* Drop the block returned last time */
+    scanner_discard (scanner, scanner->consumed);
+    scanner->consumed = 0;
+
     /* Look for the beginning */
-    t = start;
-    while (g_input_stream_read_all (input, &ch, 1, &read, NULL, NULL) && read == 1) {
-        
-        /* Match next char */            
-        if (*t == ch)
-            t++;
-
-        /* Did we find the whole string? */
-        if (!*t) {
-            buf = g_string_append (buf, start);
-            copied += strlen (start);
+    for (;;) {
+        data = (const gchar *)scanner->buffer->data;
+        len = scanner->buffer->len;
+        at = scanner_find (data, len, scanner->start, scanner->n_start);
+        if (at != NULL) {
+            scanner_discard (scanner, at - data);
             break;
         }
-    } 
-    
+
+        /* Only keep what could be the beginning of a signature */
+        if (len >= scanner->n_start)
+            scanner_discard (scanner, len - (scanner->n_start - 1));
+
+        if (scanner->eof || !scanner_fill (scanner, cancellable, error))
+            return FALSE;
+    }
+
     /* Look for the end */
-    t = end;
-    while (g_input_stream_read_all (input, &ch, 1, &read, NULL, NULL) && read == 1) {
-        
-        /* Match next char */
-        if (*t == ch)
-            t++;
-        
-        buf = g_string_append_c (buf, ch);
-        copied++;
-                
-        /* Did we find the whole string? */
-        if (!*t)
+    searched = scanner->n_start;
+    for (;;) {
+        data = (const gchar *)scanner->buffer->data;
+        len = scanner->buffer->len;
+        at = scanner_find (data + searched, len - searched,
+                           scanner->end, scanner->n_end);
+        if (at != NULL) {
+            *n_block = (at - data) + scanner->n_end;
+            break;
+        }
+
+        if (scanner->eof) {
+            *n_block = len;
             break;
+        }
+
+        /* Don't search the same data again, except for a partial signature */
+        if (len >= searched + scanner->n_end)
+            searched = len - (scanner->n_end - 1);
+
+        if (!scanner_fill (scanner, cancellable, error))
+            return FALSE;
     }
-    
-    return copied;
+
+    *block = (const gchar *)scanner->buffer->data;
+    scanner->consumed = *n_block;
+    return TRUE;
 }
 
 /**
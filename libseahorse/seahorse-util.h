@@ -43,10 +43,19 @@ void        seahorse_util_handle_error          (GError **error,
                                                  const gchar* description,
                                                  ...);
 
-guint       seahorse_util_read_data_block       (GString            *buf, 
-                                                 GInputStream*      input, 
-                                                 const gchar        *start, 
-                                                 const gchar*       end);
+typedef struct _SeahorseBlockScanner SeahorseBlockScanner;
+
+SeahorseBlockScanner * seahorse_block_scanner_new   (GInputStream *input,
+                                                     const gchar *start,
+                                                     const gchar *end);
+
+gboolean    seahorse_block_scanner_next         (SeahorseBlockScanner *scanner,
+                                                 const gchar **block,
+                                                 gsize *n_block,
+                                                 GCancellable *cancellable,
+                                                 GError **error);
+
+void        seahorse_block_scanner_free         (SeahorseBlockScanner *scanner);
 
 gboolean    seahorse_util_print_fd          (int fd, 
                                              const char* data);
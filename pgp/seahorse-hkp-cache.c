@@ -0,0 +1,702 @@
+/*
+ * Seahorse
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "seahorse-hkp-cache.h"
+
+#include "seahorse-common.h"
+
+#include <glib/gstdio.h>
+
+#include <errno.h>
+#include <string.h>
+
+/**
+ * SECTION:seahorse-hkp-cache
+ * @short_description: On-disk cache for HKP lookups
+ * @include:seahorse-hkp-cache.h
+ **/
+
+#ifdef WITH_HKP
+
+/* Entries younger than this are used without asking the server */
+#define CACHE_FRESH_SECONDS     (5 * 60)
+
+/* Delay before writing out the index after a change */
+#define CACHE_SAVE_DELAY        5
+
+#define CACHE_INDEX             "index"
+
+typedef struct {
+	gchar *uri;
+	gchar *body;            /* SHA-256 of the response body, also its file name */
+	gchar *etag;
+	gchar *last_modified;
+	gsize size;
+	gint64 stored;          /* When last fetched or revalidated, in seconds */
+	gint64 accessed;        /* When last used, in seconds */
+} CacheEntry;
+
+struct _SeahorseHkpCache {
+	gchar *directory;
+	gsize max_size;
+	gsize size;
+	GHashTable *entries;    /* uri -> CacheEntry */
+	GHashTable *bodies;     /* body digest -> number of entries using it */
+	guint save_timeout;
+
+	guint hits;
+	guint revalidated;
+	guint stale;
+	guint misses;
+	guint stores;
+	guint evictions;
+};
+
+typedef struct {
+	SeahorseHkpCache *cache;
+	SoupSession *session;
+	SoupMessage *message;
+	gchar *uri;
+	SoupSessionCallback callback;
+	gpointer user_data;
+	gboolean refetch;
+} CacheRequest;
+
+static SeahorseHkpCache *default_cache = NULL;
+
+static gint64
+cache_now (void)
+{
+	return g_get_real_time () / G_USEC_PER_SEC;
+}
+
+static void
+cache_entry_free (gpointer data)
+{
+	CacheEntry *entry = data;
+	g_free (entry->uri);
+	g_free (entry->body);
+	g_free (entry->etag);
+	g_free (entry->last_modified);
+	g_free (entry);
+}
+
+static gchar *
+cache_body_path (SeahorseHkpCache *cache,
+                 const gchar *body)
+{
+	return g_build_filename (cache->directory, body, NULL);
+}
+
+static void
+cache_body_ref (SeahorseHkpCache *cache,
+                CacheEntry *entry)
+{
+	guint refs;
+
+	refs = GPOINTER_TO_UINT (g_hash_table_lookup (cache->bodies, entry->body));
+	if (refs == 0)
+		cache->size += entry->size;
+	g_hash_table_insert (cache->bodies, g_strdup (entry->body), GUINT_TO_POINTER (refs + 1));
+}
+
+static void
+cache_body_unref (SeahorseHkpCache *cache,
+                  CacheEntry *entry)
+{
+	gchar *path;
+	guint refs;
+
+	refs = GPOINTER_TO_UINT (g_hash_table_lookup (cache->bodies, entry->body));
+	if (refs > 1) {
+		g_hash_table_insert (cache->bodies, g_strdup (entry->body), GUINT_TO_POINTER (refs - 1));
+		return;
+	}
+
+	g_hash_table_remove (cache->bodies, entry->body);
+	cache->size -= MIN (cache->size, entry->size);
+
+	path = cache_body_path (cache, entry->body);
+	g_unlink (path);
+	g_free (path);
+}
+
+static void
+cache_remove (SeahorseHkpCache *cache,
+              CacheEntry *entry)
+{
+	cache_body_unref (cache, entry);
+	g_hash_table_remove (cache->entries, entry->uri);
+}
+
+static gboolean
+on_cache_save_timeout (gpointer user_data)
+{
+	SeahorseHkpCache *cache = user_data;
+
+	cache->save_timeout = 0;
+	seahorse_hkp_cache_flush (cache);
+	seahorse_hkp_cache_dump (cache);
+	return FALSE;
+}
+
+static void
+cache_changed (SeahorseHkpCache *cache)
+{
+	if (cache->save_timeout == 0)
+		cache->save_timeout = g_timeout_add_seconds (CACHE_SAVE_DELAY,
+		                                             on_cache_save_timeout, cache);
+}
+
+static gint
+compare_entry_accessed (gconstpointer a,
+                        gconstpointer b)
+{
+	const CacheEntry *ea = a;
+	const CacheEntry *eb = b;
+
+	if (ea->accessed == eb->accessed)
+		return 0;
+	return ea->accessed < eb->accessed ? -1 : 1;
+}
+
+static void
+cache_evict (SeahorseHkpCache *cache)
+{
+	GList *entries, *l;
+
+	if (cache->size <= cache->max_size)
+		return;
+
+	/* Least recently used first */
+	entries = g_hash_table_get_values (cache->entries);
+	entries = g_list_sort (entries, compare_entry_accessed);
+
+	for (l = entries; l != NULL && cache->size > cache->max_size; l = g_list_next (l)) {
+		g_debug ("evicting %s from HKP cache", ((CacheEntry *)l->data)->uri);
+		cache_remove (cache, l->data);
+		cache->evictions++;
+	}
+
+	g_list_free (entries);
+	cache_changed (cache);
+}
+
+/*
+ * Bodies written after the index was last saved, or left behind by a
+ * crash, aren't counted against the size limit. Remove them.
+ */
+static void
+cache_remove_unlisted (SeahorseHkpCache *cache)
+{
+	const gchar *name;
+	GDir *dir;
+	gchar *path;
+	gsize i;
+
+	dir = g_dir_open (cache->directory, 0, NULL);
+	if (dir == NULL)
+		return;
+
+	while ((name = g_dir_read_name (dir)) != NULL) {
+		if (g_hash_table_contains (cache->bodies, name))
+			continue;
+
+		/* Only touch files named like a body digest */
+		for (i = 0; g_ascii_isxdigit (name[i]); i++);
+		if (i != 64 || name[i] != '\0')
+			continue;
+
+		g_debug ("removing unlisted HKP cache body %s", name);
+		path = cache_body_path (cache, name);
+		g_unlink (path);
+		g_free (path);
+	}
+
+	g_dir_close (dir);
+}
+
+static void
+cache_load_index (SeahorseHkpCache *cache)
+{
+	GKeyFile *index;
+	CacheEntry *entry;
+	GError *error = NULL;
+	gchar **groups;
+	gchar *path;
+	guint i;
+
+	index = g_key_file_new ();
+	path = g_build_filename (cache->directory, CACHE_INDEX, NULL);
+
+	if (!g_key_file_load_from_file (index, path, G_KEY_FILE_NONE, &error)) {
+		if (!g_error_matches (error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+			g_message ("couldn't load HKP cache index: %s", error->message);
+		g_clear_error (&error);
+		g_key_file_free (index);
+		g_free (path);
+		cache_remove_unlisted (cache);
+		return;
+	}
+
+	groups = g_key_file_get_groups (index, NULL);
+	for (i = 0; groups[i] != NULL; i++) {
+		entry = g_new0 (CacheEntry, 1);
+		entry->uri = g_key_file_get_string (index, groups[i], "uri", NULL);
+		entry->body = g_key_file_get_string (index, groups[i], "body", NULL);
+		entry->etag = g_key_file_get_string (index, groups[i], "etag", NULL);
+		entry->last_modified = g_key_file_get_string (index, groups[i], "last-modified", NULL);
+		entry->size = g_key_file_get_uint64 (index, groups[i], "size", NULL);
+		entry->stored = g_key_file_get_int64 (index, groups[i], "stored", NULL);
+		entry->accessed = g_key_file_get_int64 (index, groups[i], "accessed", NULL);
+
+		if (entry->uri == NULL || entry->body == NULL ||
+		    g_hash_table_lookup (cache->entries, entry->uri)) {
+			cache_entry_free (entry);
+			continue;
+		}
+
+		g_hash_table_insert (cache->entries, entry->uri, entry);
+		cache_body_ref (cache, entry);
+	}
+
+	g_strfreev (groups);
+	g_key_file_free (index);
+	g_free (path);
+
+	cache_remove_unlisted (cache);
+
+	/* In case the size limit was lowered */
+	cache_evict (cache);
+}
+
+/**
+ * seahorse_hkp_cache_new:
+ * @directory: The directory to store the cache in
+ * @max_size: The maximum size of the cached data in bytes
+ *
+ * Returns: A new cache, free with seahorse_hkp_cache_free()
+ */
+SeahorseHkpCache *
+seahorse_hkp_cache_new (const gchar *directory,
+                        gsize max_size)
+{
+	SeahorseHkpCache *cache;
+
+	g_return_val_if_fail (directory != NULL, NULL);
+
+	cache = g_new0 (SeahorseHkpCache, 1);
+	cache->directory = g_strdup (directory);
+	cache->max_size = max_size;
+	cache->entries = g_hash_table_new_full (g_str_hash, g_str_equal,
+	                                        NULL, cache_entry_free);
+	cache->bodies = g_hash_table_new_full (g_str_hash, g_str_equal,
+	                                       g_free, NULL);
+
+	if (max_size > 0) {
+		if (g_mkdir_with_parents (directory, 0700) < 0)
+			g_message ("couldn't create HKP cache directory: %s: %s",
+			           directory, g_strerror (errno));
+		cache_load_index (cache);
+	}
+
+	return cache;
+}
+
+/**
+ * seahorse_hkp_cache_get_default:
+ *
+ * Returns: The cache shared by all HKP sources, in the user's cache
+ *          directory and sized by the keyserver-cache-size setting.
+ */
+SeahorseHkpCache *
+seahorse_hkp_cache_get_default (void)
+{
+	gchar *directory;
+	gsize max_size;
+
+	if (default_cache == NULL) {
+		max_size = seahorse_app_settings_get_keyserver_cache_size (seahorse_app_settings_instance ());
+		directory = g_build_filename (g_get_user_cache_dir (), "seahorse", "hkp", NULL);
+		default_cache = seahorse_hkp_cache_new (directory, max_size * 1024 * 1024);
+		g_free (directory);
+	}
+
+	return default_cache;
+}
+
+/**
+ * seahorse_hkp_cache_free:
+ * @cache: The cache
+ *
+ * Writes out any pending changes and frees the cache.
+ */
+void
+seahorse_hkp_cache_free (SeahorseHkpCache *cache)
+{
+	if (cache == NULL)
+		return;
+
+	if (cache->save_timeout) {
+		g_source_remove (cache->save_timeout);
+		seahorse_hkp_cache_flush (cache);
+	}
+
+	if (cache == default_cache)
+		default_cache = NULL;
+
+	g_hash_table_destroy (cache->entries);
+	g_hash_table_destroy (cache->bodies);
+	g_free (cache->directory);
+	g_free (cache);
+}
+
+/**
+ * seahorse_hkp_cache_flush:
+ * @cache: The cache
+ *
+ * Writes the cache index to disk.
+ */
+void
+seahorse_hkp_cache_flush (SeahorseHkpCache *cache)
+{
+	GHashTableIter iter;
+	CacheEntry *entry;
+	GKeyFile *index;
+	GError *error = NULL;
+	gchar *group;
+	gchar *path;
+
+	g_return_if_fail (cache != NULL);
+
+	if (cache->max_size == 0)
+		return;
+
+	index = g_key_file_new ();
+
+	g_hash_table_iter_init (&iter, cache->entries);
+	while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&entry)) {
+		group = g_compute_checksum_for_string (G_CHECKSUM_SHA1, entry->uri, -1);
+		g_key_file_set_string (index, group, "uri", entry->uri);
+		g_key_file_set_string (index, group, "body", entry->body);
+		if (entry->etag)
+			g_key_file_set_string (index, group, "etag", entry->etag);
+		if (entry->last_modified)
+			g_key_file_set_string (index, group, "last-modified", entry->last_modified);
+		g_key_file_set_uint64 (index, group, "size", entry->size);
+		g_key_file_set_int64 (index, group, "stored", entry->stored);
+		g_key_file_set_int64 (index, group, "accessed", entry->accessed);
+		g_free (group);
+	}
+
+	path = g_build_filename (cache->directory, CACHE_INDEX, NULL);
+	if (!g_key_file_save_to_file (index, path, &error)) {
+		g_message ("couldn't write HKP cache index: %s", error->message);
+		g_clear_error (&error);
+	}
+
+	g_key_file_free (index);
+	g_free (path);
+}
+
+/**
+ * seahorse_hkp_cache_dump:
+ * @cache: The cache
+ *
+ * Prints the cache usage and hit/miss counts to the debug log.
+ */
+void
+seahorse_hkp_cache_dump (SeahorseHkpCache *cache)
+{
+	g_return_if_fail (cache != NULL);
+
+	g_debug ("HKP cache: %s: %u entries, %" G_GSIZE_FORMAT " of %" G_GSIZE_FORMAT " bytes",
+	         cache->directory, g_hash_table_size (cache->entries),
+	         cache->size, cache->max_size);
+	g_debug ("HKP cache: %u hits, %u revalidated, %u stale, %u misses, %u stored, %u evicted",
+	         cache->hits, cache->revalidated, cache->stale, cache->misses,
+	         cache->stores, cache->evictions);
+}
+
+/* Fills in the message response from the cached body, or removes the entry if that is gone */
+static gboolean
+cache_load_body (SeahorseHkpCache *cache,
+                 CacheEntry *entry,
+                 SoupMessage *message)
+{
+	GError *error = NULL;
+	gchar *contents;
+	gchar *path;
+	gsize length;
+
+	path = cache_body_path (cache, entry->body);
+	if (!g_file_get_contents (path, &contents, &length, &error)) {
+		g_message ("couldn't read HKP cache entry: %s", error->message);
+		g_clear_error (&error);
+		g_free (path);
+		cache_remove (cache, entry);
+		cache_changed (cache);
+		return FALSE;
+	}
+
+	g_free (path);
+
+	soup_message_set_status (message, SOUP_STATUS_OK);
+	soup_message_body_truncate (message->response_body);
+	soup_message_body_append (message->response_body, SOUP_MEMORY_TAKE,
+	                          contents, length);
+	soup_buffer_free (soup_message_body_flatten (message->response_body));
+
+	entry->accessed = cache_now ();
+	cache_changed (cache);
+	return TRUE;
+}
+
+static void
+cache_store (SeahorseHkpCache *cache,
+             const gchar *uri,
+             SoupMessage *message)
+{
+	CacheEntry *entry;
+	GError *error = NULL;
+	SoupBuffer *buffer;
+	gboolean written = FALSE;
+	gchar *body;
+	gchar *path;
+
+	buffer = soup_message_body_flatten (message->response_body);
+	if (buffer->length > cache->max_size) {
+		soup_buffer_free (buffer);
+		return;
+	}
+
+	body = g_compute_checksum_for_data (G_CHECKSUM_SHA256,
+	                                    (const guchar *)buffer->data, buffer->length);
+
+	entry = g_hash_table_lookup (cache->entries, uri);
+	if (entry != NULL)
+		cache_remove (cache, entry);
+
+	/* Only write the body if no other entry has the same content */
+	if (!g_hash_table_lookup (cache->bodies, body)) {
+		path = cache_body_path (cache, body);
+		if (!g_file_set_contents (path, buffer->data, buffer->length, &error)) {
+			g_message ("couldn't write HKP cache entry: %s", error->message);
+			g_clear_error (&error);
+			soup_buffer_free (buffer);
+			g_free (path);
+			g_free (body);
+			return;
+		}
+		g_free (path);
+		written = TRUE;
+	}
+
+	entry = g_new0 (CacheEntry, 1);
+	entry->uri = g_strdup (uri);
+	entry->body = body;
+	entry->etag = g_strdup (soup_message_headers_get_one (message->response_headers, "ETag"));
+	entry->last_modified = g_strdup (soup_message_headers_get_one (message->response_headers,
+	                                                                "Last-Modified"));
+	entry->size = buffer->length;
+	entry->stored = entry->accessed = cache_now ();
+
+	g_hash_table_insert (cache->entries, entry->uri, entry);
+	cache_body_ref (cache, entry);
+	cache->stores++;
+
+	soup_buffer_free (buffer);
+	cache_evict (cache);
+
+	/* Don't leave a body on disk that the index doesn't know about */
+	if (written) {
+		if (cache->save_timeout) {
+			g_source_remove (cache->save_timeout);
+			cache->save_timeout = 0;
+		}
+		seahorse_hkp_cache_flush (cache);
+	} else {
+		cache_changed (cache);
+	}
+}
+
+static void
+cache_request_free (CacheRequest *request)
+{
+	g_object_unref (request->session);
+	g_clear_object (&request->message);
+	g_free (request->uri);
+	g_free (request);
+}
+
+static gboolean
+on_cache_fresh_idle (gpointer user_data)
+{
+	CacheRequest *request = user_data;
+
+	(request->callback) (request->session, request->message, request->user_data);
+	cache_request_free (request);
+	return FALSE;
+}
+
+static void
+copy_response_header (const gchar *name,
+                      const gchar *value,
+                      gpointer user_data)
+{
+	soup_message_headers_append (user_data, name, value);
+}
+
+/* Hands the response of a refetch to the message the caller queued */
+static void
+cache_copy_response (SoupMessage *from,
+                     SoupMessage *to)
+{
+	SoupBuffer *buffer;
+
+	soup_message_set_status_full (to, from->status_code, from->reason_phrase);
+	soup_message_headers_clear (to->response_headers);
+	soup_message_headers_foreach (from->response_headers, copy_response_header,
+	                              to->response_headers);
+
+	buffer = soup_message_body_flatten (from->response_body);
+	soup_message_body_truncate (to->response_body);
+	soup_message_body_append_buffer (to->response_body, buffer);
+	soup_buffer_free (buffer);
+	soup_buffer_free (soup_message_body_flatten (to->response_body));
+}
+
+static void
+on_cache_message_complete (SoupSession *session,
+                           SoupMessage *message,
+                           gpointer user_data)
+{
+	CacheRequest *request = user_data;
+	SeahorseHkpCache *cache = request->cache;
+	SoupMessage *fresh;
+	CacheEntry *entry;
+	guint status;
+
+	entry = g_hash_table_lookup (cache->entries, request->uri);
+	status = message->status_code;
+
+	if (status == SOUP_STATUS_NOT_MODIFIED && entry != NULL &&
+	    cache_load_body (cache, entry, message)) {
+		entry->stored = cache_now ();
+		cache->revalidated++;
+
+	/* The entry went away while revalidating, so fetch it again in full */
+	} else if (status == SOUP_STATUS_NOT_MODIFIED && !request->refetch) {
+		g_debug ("refetching evicted HKP cache entry for %s", request->uri);
+		request->refetch = TRUE;
+		request->message = g_object_ref (message);
+		fresh = soup_message_new_from_uri ("GET", soup_message_get_uri (message));
+		soup_session_queue_message (session, fresh, on_cache_message_complete, request);
+		return;
+
+	} else if (SOUP_STATUS_IS_SUCCESSFUL (status)) {
+		cache_store (cache, request->uri, message);
+		cache->misses++;
+
+	/* Can't reach the server, so use what we have */
+	} else if (SOUP_STATUS_IS_TRANSPORT_ERROR (status) &&
+	           status != SOUP_STATUS_CANCELLED && entry != NULL &&
+	           cache_load_body (cache, entry, message)) {
+		g_debug ("serving stale HKP cache entry for %s", request->uri);
+		cache->stale++;
+
+	} else {
+		cache->misses++;
+	}
+
+	if (request->refetch) {
+		cache_copy_response (message, request->message);
+		message = request->message;
+	}
+
+	(request->callback) (session, message, request->user_data);
+	cache_request_free (request);
+}
+
+/**
+ * seahorse_hkp_cache_queue_message:
+ * @cache: The cache
+ * @session: The session to send the message on
+ * @message: A GET message
+ * @callback: Called when the response is available
+ * @user_data: Passed to @callback
+ *
+ * Like soup_session_queue_message(), but answers from the cache where
+ * possible, and stores successful responses in the cache.
+ */
+void
+seahorse_hkp_cache_queue_message (SeahorseHkpCache *cache,
+                                  SoupSession *session,
+                                  SoupMessage *message,
+                                  SoupSessionCallback callback,
+                                  gpointer user_data)
+{
+	CacheRequest *request;
+	CacheEntry *entry;
+
+	g_return_if_fail (SOUP_IS_SESSION (session));
+	g_return_if_fail (SOUP_IS_MESSAGE (message));
+	g_return_if_fail (callback != NULL);
+
+	if (cache == NULL || cache->max_size == 0 ||
+	    message->method != SOUP_METHOD_GET) {
+		soup_session_queue_message (session, message, callback, user_data);
+		return;
+	}
+
+	request = g_new0 (CacheRequest, 1);
+	request->cache = cache;
+	request->session = g_object_ref (session);
+	request->uri = soup_uri_to_string (soup_message_get_uri (message), FALSE);
+	request->callback = callback;
+	request->user_data = user_data;
+
+	entry = g_hash_table_lookup (cache->entries, request->uri);
+
+	/* Recent enough to not bother the server */
+	if (entry != NULL && cache_now () - entry->stored < CACHE_FRESH_SECONDS) {
+		if (cache_load_body (cache, entry, message)) {
+			cache->hits++;
+			request->message = message;
+			g_idle_add (on_cache_fresh_idle, request);
+			return;
+		}
+
+		/* The entry is gone along with its body */
+		entry = NULL;
+	}
+
+	if (entry != NULL) {
+		if (entry->etag)
+			soup_message_headers_replace (message->request_headers,
+			                              "If-None-Match", entry->etag);
+		if (entry->last_modified)
+			soup_message_headers_replace (message->request_headers,
+			                              "If-Modified-Since", entry->last_modified);
+	}
+
+	soup_session_queue_message (session, message, on_cache_message_complete, request);
+}
+
+#endif /* WITH_HKP */
@@ -0,0 +1,59 @@
+/*
+ * Seahorse
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * SeahorseHkpCache: An on-disk cache of HKP lookup responses.
+ *
+ * - Response bodies are stored in files named by their SHA-256 digest,
+ *   so identical responses for different requests are only stored once.
+ * - Entries are revalidated with If-None-Match/If-Modified-Since, and
+ *   served stale when the key server can't be reached.
+ * - The least recently used entries are evicted to keep within the
+ *   configured size.
+ */
+
+#ifndef __SEAHORSE_HKP_CACHE_H__
+#define __SEAHORSE_HKP_CACHE_H__
+
+#include "config.h"
+
+#ifdef WITH_HKP
+
+#include <libsoup/soup.h>
+
+typedef struct _SeahorseHkpCache SeahorseHkpCache;
+
+SeahorseHkpCache *    seahorse_hkp_cache_get_default     (void);
+
+SeahorseHkpCache *    seahorse_hkp_cache_new             (const gchar *directory,
+                                                          gsize max_size);
+
+void                  seahorse_hkp_cache_free            (SeahorseHkpCache *cache);
+
+void                  seahorse_hkp_cache_queue_message   (SeahorseHkpCache *cache,
+                                                          SoupSession *session,
+                                                          SoupMessage *message,
+                                                          SoupSessionCallback callback,
+                                                          gpointer user_data);
+
+void                  seahorse_hkp_cache_flush           (SeahorseHkpCache *cache);
+
+void                  seahorse_hkp_cache_dump            (SeahorseHkpCache *cache);
+
+#endif /* WITH_HKP */
+
+#endif /* __SEAHORSE_HKP_CACHE_H__ */
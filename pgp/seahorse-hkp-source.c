@@ -27,6 +27,8 @@
 
 #include "seahorse-hkp-source.h"
 
+#include "seahorse-hkp-cache.h"
+#include "seahorse-pgp-armor.h"
 #include "seahorse-pgp-key.h"
 #include "seahorse-pgp-subkey.h"
 #include "seahorse-pgp-uid.h"
@@ -695,8 +697,9 @@ seahorse_hkp_source_search_async (SeahorseServerSource *source,
 	g_hash_table_destroy (form);
 
 	message = soup_message_new_from_uri ("GET", uri);
-	soup_session_queue_message (closure->session, message,
-	                            on_search_message_complete, g_object_ref (res));
+	seahorse_hkp_cache_queue_message (seahorse_hkp_cache_get_default (),
+	                                  closure->session, message,
+	                                  on_search_message_complete, g_object_ref (res));
 
 	seahorse_progress_prep_and_begin (cancellable, message, NULL);
 
@@ -723,27 +726,289 @@ seahorse_hkp_source_search_finish (SeahorseServerSource *source,
 	return TRUE;
 }
 
+/* Upper bound on the key data sent to the server in one request */
+#define HKP_UPLOAD_BATCH_SIZE (256 * 1024)
+
+typedef struct {
+	gchar *fingerprint;     /* NULL when the key couldn't be parsed */
+	GBytes *data;           /* Binary key data, or the armored block when raw */
+	gboolean raw;
+} UploadKey;
+
+typedef struct {
+	GPtrArray *keys;        /* UploadKey */
+	gsize size;
+	gboolean raw;
+} UploadBatch;
+
 typedef struct {
 	SeahorseHKPSource *source;
-	GInputStream *input;
 	GCancellable *cancellable;
 	gulong cancelled_sig;
 	SoupSession *session;
+	SoupURI *uri;
+	GQueue *batches;
 	gint requests;
+	gint max_requests;
+	guint total;
+	GPtrArray *failures;
 } source_import_closure;
 
+static UploadKey *
+upload_key_new (const gchar *fingerprint,
+                gconstpointer data,
+                gsize n_data,
+                gboolean raw)
+{
+	UploadKey *key = g_new0 (UploadKey, 1);
+	key->fingerprint = g_strdup (fingerprint);
+	key->data = g_bytes_new (data, n_data);
+	key->raw = raw;
+	return key;
+}
+
+static UploadKey *
+upload_key_copy (UploadKey *key)
+{
+	UploadKey *copy = g_new0 (UploadKey, 1);
+	copy->fingerprint = g_strdup (key->fingerprint);
+	copy->data = g_bytes_ref (key->data);
+	copy->raw = key->raw;
+	return copy;
+}
+
+static void
+upload_key_free (gpointer data)
+{
+	UploadKey *key = data;
+	g_free (key->fingerprint);
+	g_bytes_unref (key->data);
+	g_free (key);
+}
+
+static UploadBatch *
+upload_batch_new (void)
+{
+	UploadBatch *batch = g_new0 (UploadBatch, 1);
+	batch->keys = g_ptr_array_new_with_free_func (upload_key_free);
+	return batch;
+}
+
+static void
+upload_batch_free (gpointer data)
+{
+	UploadBatch *batch = data;
+	g_ptr_array_free (batch->keys, TRUE);
+	g_free (batch);
+}
+
+static void
+upload_batch_add (UploadBatch *batch,
+                  UploadKey *key)
+{
+	g_ptr_array_add (batch->keys, key);
+	batch->size += g_bytes_get_size (key->data);
+	batch->raw = batch->raw || key->raw;
+}
+
+/* All the keys in the batch as a single armored block */
+static gchar *
+upload_batch_keytext (UploadBatch *batch)
+{
+	GByteArray *packets;
+	UploadKey *key;
+	GString *text;
+	gconstpointer data;
+	gsize n_data;
+	guint i;
+
+	if (batch->raw) {
+		g_assert (batch->keys->len == 1);
+		key = batch->keys->pdata[0];
+		data = g_bytes_get_data (key->data, &n_data);
+		return g_strndup (data, n_data);
+	}
+
+	packets = g_byte_array_sized_new (batch->size);
+	for (i = 0; i < batch->keys->len; i++) {
+		key = batch->keys->pdata[i];
+		data = g_bytes_get_data (key->data, &n_data);
+		g_byte_array_append (packets, data, n_data);
+	}
+
+	text = g_string_sized_new ((batch->size * 4) / 3 + 256);
+	seahorse_pgp_armor_append (text, packets->data, packets->len);
+	g_byte_array_unref (packets);
+
+	return g_string_free (text, FALSE);
+}
+
 static void
 source_import_free (gpointer data)
 {
 	source_import_closure *closure = data;
 	g_object_unref (closure->source);
-	g_object_unref (closure->input);
 	g_cancellable_disconnect (closure->cancellable, closure->cancelled_sig);
 	g_clear_object (&closure->cancellable);
 	g_object_unref (closure->session);
+	if (closure->uri)
+		soup_uri_free (closure->uri);
+	g_queue_free_full (closure->batches, upload_batch_free);
+	g_ptr_array_free (closure->failures, TRUE);
 	g_free (closure);
 }
 
+static void
+import_queue_key (source_import_closure *closure,
+                  UploadKey *key)
+{
+	UploadBatch *batch;
+	gsize size;
+
+	batch = g_queue_peek_tail (closure->batches);
+	size = g_bytes_get_size (key->data);
+
+	/* Keys we couldn't parse are sent as is, on their own */
+	if (batch == NULL || batch->raw || key->raw ||
+	    (batch->keys->len > 0 && batch->size + size > HKP_UPLOAD_BATCH_SIZE)) {
+		batch = upload_batch_new ();
+		g_queue_push_tail (closure->batches, batch);
+	}
+
+	upload_batch_add (batch, key);
+	closure->total++;
+}
+
+static gboolean
+on_import_add_key (const guchar *key,
+                   gsize n_key,
+                   const gchar *fingerprint,
+                   gpointer user_data)
+{
+	GPtrArray *keys = user_data;
+	g_ptr_array_add (keys, upload_key_new (fingerprint, key, n_key, FALSE));
+	return TRUE;
+}
+
+static void
+import_queue_block (source_import_closure *closure,
+                    const gchar *block,
+                    gsize n_block)
+{
+	GPtrArray *keys;
+	guchar *data;
+	gsize n_data;
+	guint i;
+
+	keys = g_ptr_array_new ();
+	data = seahorse_pgp_armor_decode (block, n_block, &n_data);
+	if (data == NULL || !seahorse_pgp_armor_foreach_key (data, n_data, on_import_add_key, keys) ||
+	    keys->len == 0) {
+		g_ptr_array_foreach (keys, (GFunc)upload_key_free, NULL);
+		g_ptr_array_set_size (keys, 0);
+		g_ptr_array_add (keys, upload_key_new (NULL, block, n_block, TRUE));
+	}
+
+	for (i = 0; i < keys->len; i++)
+		import_queue_key (closure, keys->pdata[i]);
+
+	g_ptr_array_free (keys, TRUE);
+	g_free (data);
+}
+
+static void
+import_key_failed (source_import_closure *closure,
+                   UploadKey *key,
+                   const gchar *message)
+{
+	g_message ("couldn't send key %s to server: %s",
+	           key->fingerprint ? key->fingerprint : "(unknown)", message);
+	g_ptr_array_add (closure->failures, g_strdup (message));
+}
+
+static void
+import_batch_failed (source_import_closure *closure,
+                     UploadBatch *batch,
+                     const gchar *message,
+                     gboolean retry)
+{
+	UploadBatch *single;
+	guint i;
+
+	/* Send each key on its own, to find out which ones the server refuses */
+	if (retry && batch->keys->len > 1) {
+		for (i = batch->keys->len; i > 0; i--) {
+			single = upload_batch_new ();
+			upload_batch_add (single, upload_key_copy (batch->keys->pdata[i - 1]));
+			g_queue_push_head (closure->batches, single);
+		}
+		return;
+	}
+
+	for (i = 0; i < batch->keys->len; i++)
+		import_key_failed (closure, batch->keys->pdata[i], message);
+}
+
+static gboolean
+response_mentions_key (const gchar *response,
+                       const gchar *fingerprint)
+{
+	gsize len;
+
+	if (fingerprint == NULL)
+		return FALSE;
+
+	/* The full fingerprint, or the long and short key ids */
+	len = strlen (fingerprint);
+	return strstr (response, fingerprint) != NULL ||
+	       (len > 16 && strstr (response, fingerprint + len - 16) != NULL) ||
+	       (len > 8 && strstr (response, fingerprint + len - 8) != NULL);
+}
+
+/*
+ * Servers list the keys they accepted in their response, but in no
+ * particular format. When an error is reported, keys that were listed
+ * still count as sent.
+ */
+static void
+import_batch_result (source_import_closure *closure,
+                     UploadBatch *batch,
+                     const gchar *response,
+                     const gchar *errmsg)
+{
+	gboolean *mentioned;
+	guint n_mentioned = 0;
+	UploadKey *key;
+	gchar *text;
+	guint i;
+
+	if (errmsg == NULL)
+		return;
+
+	text = g_ascii_strup (response, -1);
+	mentioned = g_new0 (gboolean, batch->keys->len);
+	for (i = 0; i < batch->keys->len; i++) {
+		key = batch->keys->pdata[i];
+		mentioned[i] = response_mentions_key (text, key->fingerprint);
+		if (mentioned[i])
+			n_mentioned++;
+	}
+
+	if (n_mentioned == 0) {
+		import_batch_failed (closure, batch, errmsg, TRUE);
+	} else {
+		for (i = 0; i < batch->keys->len; i++) {
+			if (!mentioned[i])
+				import_key_failed (closure, batch->keys->pdata[i], errmsg);
+		}
+	}
+
+	g_free (mentioned);
+	g_free (text);
+}
+
+static void      import_send_batches         (GSimpleAsyncResult *res);
+
 static void
 on_import_message_complete (SoupSession *session,
                             SoupMessage *message,
@@ -751,37 +1016,103 @@ on_import_message_complete (SoupSession *session,
 {
 	GSimpleAsyncResult *res = G_SIMPLE_ASYNC_RESULT (user_data);
 	source_import_closure *closure = g_simple_async_result_get_op_res_gpointer (res);
+	UploadBatch *batch;
 	GError *error = NULL;
 	gchar *errmsg;
 
 	g_assert (closure->requests > 0);
-	seahorse_progress_end (closure->cancellable, GUINT_TO_POINTER (closure->requests));
+	seahorse_progress_end (closure->cancellable, message);
 	closure->requests--;
 
-	if (hkp_message_propagate_error (closure->source, message, &error)) {
-		g_simple_async_result_take_error (res, error);
-		g_simple_async_result_complete_in_idle (res);
+	batch = g_object_get_data (G_OBJECT (message), "seahorse-batch");
+	g_assert (batch != NULL);
 
-	} else if ((errmsg = get_send_result (message->response_body->data)) != NULL) {
-		g_set_error (&error, HKP_ERROR_DOMAIN, message->status_code, "%s", errmsg);
-		g_simple_async_result_take_error (res, error);
-		g_simple_async_result_complete_in_idle (res);
-		g_free (errmsg);
+	if (g_cancellable_is_cancelled (closure->cancellable)) {
+		g_queue_free_full (closure->batches, upload_batch_free);
+		closure->batches = g_queue_new ();
+
+	} else if (hkp_message_propagate_error (closure->source, message, &error)) {
+		/* Only retry key by key if the server refused the keys */
+		import_batch_failed (closure, batch, error->message,
+		                     !SOUP_STATUS_IS_TRANSPORT_ERROR (message->status_code) &&
+		                     !SOUP_STATUS_IS_SERVER_ERROR (message->status_code));
+		g_error_free (error);
 
-	/* A successful status from the server is all we want in this case */
 	} else {
-		if (closure->requests == 0)
-			g_simple_async_result_complete_in_idle (res);
+		errmsg = get_send_result (message->response_body->data);
+		import_batch_result (closure, batch, message->response_body->data, errmsg);
+		g_free (errmsg);
 	}
 
+	import_send_batches (res);
 	g_object_unref (res);
 }
 
+static void
+import_send_batches (GSimpleAsyncResult *res)
+{
+	source_import_closure *closure = g_simple_async_result_get_op_res_gpointer (res);
+	SoupMessage *message;
+	UploadBatch *batch;
+	GHashTable *form;
+	gchar *keytext;
+	gchar *server;
+	gchar *body;
+
+	while (closure->requests < closure->max_requests &&
+	       !g_queue_is_empty (closure->batches)) {
+		batch = g_queue_pop_head (closure->batches);
+
+		form = g_hash_table_new (g_str_hash, g_str_equal);
+		keytext = upload_batch_keytext (batch);
+		g_hash_table_insert (form, "keytext", keytext);
+		body = soup_form_encode_urlencoded (form);
+		g_hash_table_destroy (form);
+		g_free (keytext);
+
+		message = soup_message_new_from_uri ("POST", closure->uri);
+		soup_message_set_request (message, "application/x-www-form-urlencoded",
+		                          SOUP_MEMORY_TAKE, body, strlen (body));
+		g_object_set_data_full (G_OBJECT (message), "seahorse-batch",
+		                        batch, upload_batch_free);
+
+		g_debug ("sending %u keys in %" G_GSIZE_FORMAT " bytes to server",
+		         batch->keys->len, batch->size);
+
+		closure->requests++;
+		soup_session_queue_message (closure->session, message,
+		                            on_import_message_complete, g_object_ref (res));
+		seahorse_progress_prep_and_begin (closure->cancellable, message, NULL);
+	}
+
+	if (closure->requests > 0)
+		return;
+
+	/* All done */
+	if (g_cancellable_is_cancelled (closure->cancellable)) {
+		g_simple_async_result_set_error (res, G_IO_ERROR, G_IO_ERROR_CANCELLED,
+		                                 _("The operation was cancelled"));
+
+	} else if (closure->failures->len > 0) {
+		g_object_get (closure->source, "key-server", &server, NULL);
+		g_simple_async_result_set_error (res, HKP_ERROR_DOMAIN, 0,
+		                                 ngettext ("Couldn’t send %u of %u key to server “%s”: %s",
+		                                           "Couldn’t send %u of %u keys to server “%s”: %s",
+		                                           closure->total),
+		                                 closure->failures->len, closure->total, server,
+		                                 (gchar *)closure->failures->pdata[0]);
+		g_free (server);
+	}
+
+	g_simple_async_result_complete_in_idle (res);
+}
+
 /**
 * sksrc: The HKP source to use
 * input: The input stream to add
 *
-* Imports a list of keys from the input stream to the keyserver
+* Imports a list of keys from the input stream to the keyserver. Keys are
+* sent in batches, with only a limited number of requests at a time.
 **/
 static void
 seahorse_hkp_source_import_async (SeahorseServerSource *source,
@@ -793,83 +1124,46 @@ seahorse_hkp_source_import_async (SeahorseServerSource *source,
 	SeahorseHKPSource *self = SEAHORSE_HKP_SOURCE (source);
 	GSimpleAsyncResult *res;
 	source_import_closure *closure;
-	SoupMessage *message;
-	GList *keydata = NULL;
-	GString *buf = NULL;
-	GHashTable *form;
-	gchar *key;
-	SoupURI *uri;
-	GList *l;
-	guint len;
+	SeahorseBlockScanner *scanner;
+	GError *error = NULL;
+	const gchar *block;
+	gsize len;
 
 	res = g_simple_async_result_new (G_OBJECT (source), callback, user_data,
 	                                 seahorse_hkp_source_import_async);
 	closure = g_new0 (source_import_closure, 1);
 	closure->cancellable = cancellable ? g_object_ref (cancellable) : NULL;
-	closure->input = g_object_ref (input);
 	closure->source = g_object_ref (self);
 	closure->session = create_hkp_soup_session ();
+	closure->batches = g_queue_new ();
+	closure->failures = g_ptr_array_new_with_free_func (g_free);
+	closure->max_requests = seahorse_app_settings_get_keyserver_max_requests (seahorse_app_settings_instance ());
+	closure->max_requests = MAX (closure->max_requests, 1);
 	g_simple_async_result_set_op_res_gpointer (res, closure, source_import_free);
 
-	for (;;) {
-
-		buf = g_string_sized_new (2048);
-		len = seahorse_util_read_data_block (buf, input,
-		                                     "-----BEGIN PGP PUBLIC KEY BLOCK-----",
-		                                     "-----END PGP PUBLIC KEY BLOCK-----");
-
-		if (len > 0) {
-			keydata = g_list_prepend (keydata, g_string_free (buf, FALSE));
-		} else {
-			g_string_free (buf, TRUE);
-			break;
-		}
-	}
+	scanner = seahorse_block_scanner_new (input, PGP_KEY_BEGIN, PGP_KEY_END);
+	while (seahorse_block_scanner_next (scanner, &block, &len, cancellable, &error))
+		import_queue_block (closure, block, len);
+	seahorse_block_scanner_free (scanner);
 
-	if (g_list_length (keydata) == 0) {
+	if (error != NULL) {
+		g_simple_async_result_take_error (res, error);
 		g_simple_async_result_complete_in_idle (res);
 		g_object_unref (res);
 		return;
 	}
 
 	/* Figure out the URI we're sending to */
-	uri = get_http_server_uri (self, "/pks/add");
-	g_return_if_fail (uri);
-
-	/* New operation and away we go */
-	keydata = g_list_reverse (keydata);
-
-	form = g_hash_table_new (g_str_hash, g_str_equal);
-	for (l = keydata; l; l = g_list_next (l)) {
-		g_assert (l->data != NULL);
-		g_hash_table_remove_all (form);
-
-		g_hash_table_insert (form, "keytext", l->data);
-		key = soup_form_encode_urlencoded (form);
-
-		message = soup_message_new_from_uri ("POST", uri);
-		soup_message_set_request (message, "application/x-www-form-urlencoded",
-		                          SOUP_MEMORY_TAKE, key, strlen (key));
-
-		soup_session_queue_message (closure->session, message,
-		                            on_import_message_complete, g_object_ref (res));
-
-		closure->requests++;
-		seahorse_progress_prep_and_begin (cancellable, GUINT_TO_POINTER (closure->requests), NULL);
-	}
-	g_hash_table_destroy (form);
+	closure->uri = get_http_server_uri (self, "/pks/add");
+	g_return_if_fail (closure->uri);
 
 	if (cancellable)
 		closure->cancelled_sig = g_cancellable_connect (cancellable,
 		                                                G_CALLBACK (on_session_cancelled),
 		                                                closure->session, NULL);
 
-	soup_uri_free (uri);
-
-	for (l = keydata; l != NULL; l = g_list_next (l))
-		g_free (l->data);
-	g_list_free (keydata);
-
+	/* New operation and away we go */
+	import_send_batches (res);
 	g_object_unref (res);
 }
 
@@ -911,6 +1205,78 @@ export_closure_free (gpointer data)
 	g_free (closure);
 }
 
+typedef struct {
+	const gchar *keyid;
+	GByteArray *matched;
+} ExportFilter;
+
+static gboolean
+on_export_filter_key (const guchar *key,
+                      gsize n_key,
+                      const gchar *fingerprint,
+                      gpointer user_data)
+{
+	ExportFilter *filter = user_data;
+	gchar *keyid = NULL;
+	gboolean matches;
+
+	if (fingerprint != NULL) {
+		matches = seahorse_pgp_armor_fingerprint_matches (fingerprint, filter->keyid);
+
+	/* A v3 fingerprint was asked for, which we have no way to check */
+	} else if (strlen (filter->keyid) > 16) {
+		matches = TRUE;
+
+	/* Older keys are matched by the key id in their modulus */
+	} else {
+		keyid = seahorse_pgp_armor_calc_keyid (key, n_key);
+		matches = seahorse_pgp_armor_fingerprint_matches (keyid, filter->keyid);
+	}
+
+	if (matches)
+		g_byte_array_append (filter->matched, key, n_key);
+	else
+		g_debug ("dropping key %s which was not requested (%s)",
+		         fingerprint ? fingerprint : keyid ? keyid : "(unknown)",
+		         filter->keyid);
+
+	g_free (keyid);
+	return TRUE;
+}
+
+/*
+ * Keyservers return every key matching the search, so only keep the keys
+ * whose fingerprint actually matches what was requested.
+ */
+static void
+export_filter_block (ExportClosure *closure,
+                     const gchar *keyid,
+                     const gchar *block,
+                     gsize n_block)
+{
+	ExportFilter filter;
+	guchar *data;
+	gsize n_data;
+
+	data = seahorse_pgp_armor_decode (block, n_block, &n_data);
+	if (data == NULL) {
+		g_message ("couldn't decode key block returned from server for %s", keyid);
+		return;
+	}
+
+	filter.keyid = keyid;
+	filter.matched = g_byte_array_new ();
+
+	if (!seahorse_pgp_armor_foreach_key (data, n_data, on_export_filter_key, &filter))
+		g_message ("invalid key data returned from server for %s", keyid);
+	else if (filter.matched->len > 0)
+		seahorse_pgp_armor_append (closure->data, filter.matched->data,
+		                           filter.matched->len);
+
+	g_byte_array_unref (filter.matched);
+	g_free (data);
+}
+
 static void
 on_export_message_complete (SoupSession *session,
                             SoupMessage *message,
@@ -919,12 +1285,14 @@ on_export_message_complete (SoupSession *session,
 	GSimpleAsyncResult *res = G_SIMPLE_ASYNC_RESULT (user_data);
 	ExportClosure *closure = g_simple_async_result_get_op_res_gpointer (res);
 	GError *error = NULL;
+	const gchar *keyid;
 	const gchar *start;
 	const gchar *end;
 	const gchar *text;
 	guint len;
 
 	seahorse_progress_end (closure->cancellable, message);
+	keyid = g_object_get_data (G_OBJECT (message), "seahorse-keyid");
 
 	if (hkp_message_propagate_error (closure->source, message, &error)) {
 		g_simple_async_result_take_error (res, error);
@@ -940,8 +1308,8 @@ on_export_message_complete (SoupSession *session,
 			if (!detect_key (text, len, &start, &end))
 				break;
 
-			g_string_append_len (closure->data, start, end - start);
-			g_string_append_c (closure->data, '\n');
+			end += strlen (PGP_KEY_END);
+			export_filter_block (closure, keyid, start, end - start);
 		}
 	}
 
@@ -954,6 +1322,28 @@ on_export_message_complete (SoupSession *session,
 	g_object_unref (res);
 }
 
+/*
+ * Returns the term to search for a key on the server: the full fingerprint
+ * if we have one, otherwise the longest key id that we can.
+ */
+static gchar *
+get_export_search_term (const gchar *keyid)
+{
+	gsize len;
+
+	len = strlen (keyid);
+
+	/* v4 and v5 fingerprints */
+	if (len == 40 || len == 64)
+		return g_strdup_printf ("0x%s", keyid);
+
+	/* Otherwise the 64-bit key id, or whatever we were given */
+	if (len > 16)
+		keyid += (len - 16);
+
+	return g_strdup_printf ("0x%s", keyid);
+}
+
 /**
 * sksrc: A HKP source
 * keyids: the keyids to look up
@@ -973,10 +1363,9 @@ seahorse_hkp_source_export_async (SeahorseServerSource *source,
 	GSimpleAsyncResult *res;
 	SoupMessage *message;
 	SoupURI *uri;
-	const gchar *fpr;
-	gchar hexfpr[11];
+	gchar *keyid;
+	gchar *search;
 	GHashTable *form;
-	guint len;
 	gint i;
 
 	res = g_simple_async_result_new (G_OBJECT (self), callback, user_data,
@@ -997,42 +1386,47 @@ seahorse_hkp_source_export_async (SeahorseServerSource *source,
 	uri = get_http_server_uri (self, "/pks/lookup");
 	g_return_if_fail (uri);
 
-	/* prepend the hex prefix (0x) to make keyservers happy */
-	strncpy (hexfpr, "0x", 3);
-
 	form = g_hash_table_new (g_str_hash, g_str_equal);
 	for (i = 0; keyids[i] != NULL; i++) {
 		g_hash_table_remove_all (form);
 
-		/* Get the key id and limit it to 8 characters */
-		fpr = keyids[i];
-		len = strlen (fpr);
-		if (len > 8)
-			fpr += (len - 8);
-	
-		strncpy (hexfpr + 2, fpr, 9);
+		keyid = seahorse_pgp_armor_compact_keyid (keyids[i]);
+		if (!keyid[0]) {
+			g_free (keyid);
+			continue;
+		}
 
 		/* The get key URI */
+		search = get_export_search_term (keyid);
 		g_hash_table_insert (form, "op", "get");
-		g_hash_table_insert (form, "search", (char *)hexfpr);
+		g_hash_table_insert (form, "search", search);
+		g_hash_table_insert (form, "options", "mr");
 		soup_uri_set_query_from_form (uri, form);
+		g_free (search);
 
 		message = soup_message_new_from_uri ("GET", uri);
+		g_object_set_data_full (G_OBJECT (message), "seahorse-keyid",
+		                        keyid, g_free);
 
-		soup_session_queue_message (closure->session, message,
-		                            on_export_message_complete,
-		                            g_object_ref (res));
+		seahorse_hkp_cache_queue_message (seahorse_hkp_cache_get_default (),
+		                                  closure->session, message,
+		                                  on_export_message_complete,
+		                                  g_object_ref (res));
 
 		closure->requests++;
 		seahorse_progress_prep_and_begin (cancellable, message, NULL);
 	}
 
+	if (closure->requests == 0)
+		g_simple_async_result_complete_in_idle (res);
+
 	if (cancellable)
 		closure->cancelled_sig = g_cancellable_connect (cancellable,
 		                                                G_CALLBACK (on_session_cancelled),
 		                                                closure->session, NULL);
 
 	g_hash_table_destroy (form);
+	soup_uri_free (uri);
 	g_object_unref (res);
 }
 
@@ -475,6 +475,8 @@ on_search_completed (GObject *source,
 	SeahorseKeyserverResults *self = SEAHORSE_KEYSERVER_RESULTS (user_data);
 	GError *error = NULL;
 	GtkWindow *window;
+	GtkBuilder *builder;
+	GtkStatusbar *status;
 
 	seahorse_pgp_backend_search_remote_finish (NULL, result, &error);
 	if (error != NULL) {
@@ -483,6 +485,14 @@ on_search_completed (GObject *source,
 		seahorse_util_show_error (GTK_WIDGET (window),
 		                          _("The search for keys failed."), error->message);
 		g_error_free (error);
+
+	/* Let the user know there's more to be found */
+	} else if (seahorse_pgp_backend_search_remote_truncated (NULL, result)) {
+		builder = seahorse_catalog_get_builder (SEAHORSE_CATALOG (self));
+		status = GTK_STATUSBAR (gtk_builder_get_object (builder, "status"));
+		if (status != NULL)
+			gtk_statusbar_push (status, gtk_statusbar_get_context_id (status, "search-truncated"),
+			                    _("More keys match this search than were shown. Try a more specific search."));
 	}
 
 	g_object_unref (self);
@@ -501,6 +511,7 @@ seahorse_keyserver_results_show (const char* search_text, GtkWindow *parent)
 	SeahorseKeyserverResults* self;
 	GCancellable *cancellable;
 	GtkBuilder *builder;
+	gint timeout;
 
 	g_return_if_fail (search_text != NULL);
 
@@ -515,10 +526,13 @@ seahorse_keyserver_results_show (const char* search_text, GtkWindow *parent)
 
 	cancellable = g_cancellable_new ();
 
-	seahorse_pgp_backend_search_remote_async (NULL, search_text,
-	                                          self->pv->collection,
-	                                          cancellable, on_search_completed,
-	                                          g_object_ref (self));
+	/* Slow servers are only given up on if the user asked for that */
+	timeout = seahorse_app_settings_get_keyserver_search_timeout (seahorse_app_settings_instance ());
+	seahorse_pgp_backend_search_remote_full_async (NULL, search_text,
+	                                               self->pv->collection, 0,
+	                                               MAX (timeout, 0) * 1000,
+	                                               cancellable, on_search_completed,
+	                                               g_object_ref (self));
 
 	builder = seahorse_catalog_get_builder (SEAHORSE_CATALOG (self));
 	seahorse_progress_attach (cancellable, builder);
@@ -22,8 +22,10 @@
 
 #include "seahorse-keyserver-sync.h"
 
+#include "seahorse-gpgme-exporter.h"
+#include "seahorse-gpgme-key.h"
+#include "seahorse-pgp-armor.h"
 #include "seahorse-pgp-backend.h"
-#include "seahorse-transfer.h"
 
 #include "seahorse-common.h"
 
@@ -39,42 +41,355 @@ void            on_sync_ok_clicked                (GtkButton *button,
 void            on_sync_configure_clicked         (GtkButton *button,
                                                    SeahorseWidget *swidget);
 
+/* -----------------------------------------------------------------------------
+ * PUBLISHED KEYS
+ *
+ * For each key server we remember a digest of the packets of every key
+ * we published there. Only keys whose packets changed since, such as
+ * those with new signatures or user ids, are sent again.
+ */
+
+typedef struct {
+	SeahorseServerSource *source;
+	gchar *keyserver;
+	GCancellable *cancellable;
+	GHashTable *digests;       /* fingerprint -> digest, of the keys sent */
+	guint n_sent;
+} PublishClosure;
+
+static void
+publish_closure_free (gpointer user_data)
+{
+	PublishClosure *closure = user_data;
+	g_object_unref (closure->source);
+	g_free (closure->keyserver);
+	g_clear_object (&closure->cancellable);
+	g_hash_table_destroy (closure->digests);
+	g_free (closure);
+}
+
+static gchar *
+published_keys_path (void)
+{
+	return g_build_filename (g_get_user_data_dir (), "seahorse", "published-keys", NULL);
+}
+
+static GKeyFile *
+published_keys_load (void)
+{
+	GKeyFile *file;
+	GError *error = NULL;
+	gchar *path;
+
+	file = g_key_file_new ();
+	path = published_keys_path ();
+	if (!g_key_file_load_from_file (file, path, G_KEY_FILE_NONE, &error)) {
+		if (!g_error_matches (error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+			g_message ("couldn't read published keys: %s", error->message);
+		g_clear_error (&error);
+	}
+
+	g_free (path);
+	return file;
+}
+
 static void
-on_transfer_upload_complete (GObject *object,
-                             GAsyncResult *result,
-                             gpointer user_data)
+published_keys_save (GKeyFile *file)
 {
-	SeahorsePlace *place = SEAHORSE_PLACE (user_data);
 	GError *error = NULL;
-	gchar *publish_to;
+	gchar *path;
+	gchar *dir;
 
-	if (!seahorse_pgp_backend_transfer_finish (SEAHORSE_PGP_BACKEND (object), result, &error)) {
-		publish_to = seahorse_app_settings_get_server_publish_to (seahorse_app_settings_instance ());
-		seahorse_util_handle_error (&error, NULL,
-		                            _("Couldn’t publish keys to server"), publish_to);
-		g_free (publish_to);
+	path = published_keys_path ();
+	dir = g_path_get_dirname (path);
+	g_mkdir_with_parents (dir, 0700);
+
+	if (!g_key_file_save_to_file (file, path, &error)) {
+		g_message ("couldn't save published keys: %s", error->message);
+		g_clear_error (&error);
 	}
 
-	g_object_unref (place);
+	g_free (dir);
+	g_free (path);
+}
+
+typedef struct {
+	PublishClosure *closure;
+	GKeyFile *published;
+	GByteArray *changed;
+	guint total;
+} PublishDiff;
+
+static gboolean
+on_publish_diff_key (const guchar *key,
+                     gsize n_key,
+                     const gchar *fingerprint,
+                     gpointer user_data)
+{
+	PublishDiff *diff = user_data;
+	gchar *previous;
+	gchar *digest;
+
+	diff->total++;
+	digest = g_compute_checksum_for_data (G_CHECKSUM_SHA256, key, n_key);
+
+	if (fingerprint != NULL) {
+		previous = g_key_file_get_string (diff->published, diff->closure->keyserver,
+		                                  fingerprint, NULL);
+		if (g_strcmp0 (previous, digest) == 0) {
+			g_free (previous);
+			g_free (digest);
+			return TRUE;
+		}
+		g_free (previous);
+		g_hash_table_replace (diff->closure->digests, g_strdup (fingerprint), digest);
+	} else {
+		g_free (digest);
+	}
+
+	diff->closure->n_sent++;
+	g_byte_array_append (diff->changed, key, n_key);
+	return TRUE;
 }
 
 static void
-on_transfer_download_complete (GObject *object,
-                               GAsyncResult *result,
-                               gpointer user_data)
+on_publish_import_complete (GObject *object,
+                            GAsyncResult *result,
+                            gpointer user_data)
 {
-	SeahorsePlace *place = SEAHORSE_PLACE (user_data);
+	GSimpleAsyncResult *res = G_SIMPLE_ASYNC_RESULT (user_data);
+	PublishClosure *closure = g_simple_async_result_get_op_res_gpointer (res);
 	GError *error = NULL;
+	GHashTableIter iter;
+	GKeyFile *published;
+	gpointer fingerprint, digest;
+
+	seahorse_server_source_import_finish (SEAHORSE_SERVER_SOURCE (object), result, &error);
+
+	if (error != NULL) {
+		g_simple_async_result_take_error (res, error);
+
+	/* Remember what the server has now */
+	} else {
+		published = published_keys_load ();
+		g_hash_table_iter_init (&iter, closure->digests);
+		while (g_hash_table_iter_next (&iter, &fingerprint, &digest))
+			g_key_file_set_string (published, closure->keyserver, fingerprint, digest);
+		published_keys_save (published);
+		g_key_file_free (published);
+	}
+
+	g_simple_async_result_complete (res);
+	g_object_unref (res);
+}
+
+/**
+ * seahorse_keyserver_sync_publish_async:
+ * @source: The key server to publish to
+ * @keyserver: The key server's address, as in the publish-to setting
+ * @keys: The packets of the keys to publish
+ * @cancellable: Allows cancellation
+ * @callback: Called when done
+ * @user_data: Passed to @callback
+ *
+ * Sends the keys whose packets changed since they were last published to
+ * @keyserver, in a single upload. If @keys can't be split into keys,
+ * they are all sent.
+ */
+void
+seahorse_keyserver_sync_publish_async (SeahorseServerSource *source,
+                                       const gchar *keyserver,
+                                       GBytes *keys,
+                                       GCancellable *cancellable,
+                                       GAsyncReadyCallback callback,
+                                       gpointer user_data)
+{
+	GSimpleAsyncResult *res;
+	PublishClosure *closure;
+	GInputStream *input;
+	PublishDiff diff;
+	GString *armored;
+	gconstpointer data;
+	gsize n_data;
+
+	g_return_if_fail (SEAHORSE_IS_SERVER_SOURCE (source));
+	g_return_if_fail (keyserver != NULL);
+	g_return_if_fail (keys != NULL);
+
+	res = g_simple_async_result_new (NULL, callback, user_data,
+	                                 seahorse_keyserver_sync_publish_async);
+	closure = g_new0 (PublishClosure, 1);
+	closure->source = g_object_ref (source);
+	closure->keyserver = g_strdup (keyserver);
+	closure->cancellable = cancellable ? g_object_ref (cancellable) : NULL;
+	closure->digests = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+	g_simple_async_result_set_op_res_gpointer (res, closure, publish_closure_free);
+
+	diff.closure = closure;
+	diff.published = published_keys_load ();
+	diff.changed = g_byte_array_new ();
+	diff.total = 0;
+
+	data = g_bytes_get_data (keys, &n_data);
+	if (!seahorse_pgp_armor_foreach_key (data, n_data, on_publish_diff_key, &diff)) {
+		/* Couldn't make sense of it, send everything */
+		g_byte_array_set_size (diff.changed, 0);
+		g_byte_array_append (diff.changed, data, n_data);
+		g_hash_table_remove_all (closure->digests);
+		closure->n_sent = diff.total;
+	}
+
+	g_key_file_free (diff.published);
+
+	if (diff.changed->len == 0) {
+		g_debug ("all %u keys already published to %s", diff.total, keyserver);
+		g_byte_array_unref (diff.changed);
+		g_simple_async_result_complete_in_idle (res);
+		g_object_unref (res);
+		return;
+	}
+
+	g_debug ("publishing %u of %u keys to %s", closure->n_sent, diff.total, keyserver);
+
+	armored = g_string_sized_new ((diff.changed->len * 4) / 3 + 256);
+	seahorse_pgp_armor_append (armored, diff.changed->data, diff.changed->len);
+	g_byte_array_unref (diff.changed);
+
+	n_data = armored->len;
+	input = g_memory_input_stream_new_from_data (g_string_free (armored, FALSE), n_data, g_free);
+	seahorse_server_source_import_async (source, input, cancellable,
+	                                     on_publish_import_complete, g_object_ref (res));
+	g_object_unref (input);
+	g_object_unref (res);
+}
+
+/**
+ * seahorse_keyserver_sync_publish_finish:
+ * @result: The result passed to the callback
+ * @n_sent: Location for the number of keys sent, or NULL
+ * @error: Location for an error
+ *
+ * Returns: Whether the changed keys were published
+ */
+gboolean
+seahorse_keyserver_sync_publish_finish (GAsyncResult *result,
+                                        guint *n_sent,
+                                        GError **error)
+{
+	PublishClosure *closure;
+
+	g_return_val_if_fail (g_simple_async_result_is_valid (result, NULL,
+	                      seahorse_keyserver_sync_publish_async), FALSE);
+
+	if (g_simple_async_result_propagate_error (G_SIMPLE_ASYNC_RESULT (result), error))
+		return FALSE;
+
+	closure = g_simple_async_result_get_op_res_gpointer (G_SIMPLE_ASYNC_RESULT (result));
+	if (n_sent)
+		*n_sent = closure->n_sent;
+	return TRUE;
+}
+
+typedef struct {
+	SeahorseServerSource *source;
 	gchar *keyserver;
+	GCancellable *cancellable;
+} SyncPublish;
+
+static void
+sync_publish_free (SyncPublish *sync)
+{
+	seahorse_progress_end (sync->cancellable, sync);
+	g_object_unref (sync->source);
+	g_free (sync->keyserver);
+	g_clear_object (&sync->cancellable);
+	g_free (sync);
+}
+
+static void
+on_sync_published (GObject *object,
+                   GAsyncResult *result,
+                   gpointer user_data)
+{
+	SyncPublish *sync = user_data;
+	GError *error = NULL;
 
-	if (!seahorse_transfer_finish (result, &error)) {
-		g_object_get (place, "key-server", &keyserver, NULL);
+	if (!seahorse_keyserver_sync_publish_finish (result, NULL, &error))
 		seahorse_util_handle_error (&error, NULL,
-		                            _("Couldn’t retrieve keys from server: %s"), keyserver);
-		g_free (keyserver);
+		                            _("Couldn’t publish keys to server"), sync->keyserver);
+
+	sync_publish_free (sync);
+}
+
+static void
+on_sync_exported (GObject *object,
+                  GAsyncResult *result,
+                  gpointer user_data)
+{
+	SyncPublish *sync = user_data;
+	GError *error = NULL;
+	GBytes *keys;
+	guchar *data;
+	gsize n_data;
+
+	data = seahorse_exporter_export_finish (SEAHORSE_EXPORTER (object), result,
+	                                        &n_data, &error);
+	if (error != NULL) {
+		seahorse_util_handle_error (&error, NULL,
+		                            _("Couldn’t publish keys to server"), sync->keyserver);
+		sync_publish_free (sync);
+		return;
 	}
 
-	g_object_unref (place);
+	keys = g_bytes_new_take (data, n_data);
+	seahorse_keyserver_sync_publish_async (sync->source, sync->keyserver, keys,
+	                                       sync->cancellable, on_sync_published, sync);
+	g_bytes_unref (keys);
+}
+
+/* Send the keys that changed since they were last published to @source */
+static void
+keyserver_sync_publish (GList *keys,
+                        SeahorseServerSource *source,
+                        const gchar *keyserver,
+                        GCancellable *cancellable)
+{
+	SeahorseExporter *exporter;
+	SyncPublish *sync;
+	GList *local = NULL;
+	GList *l;
+
+	for (l = keys; l != NULL; l = g_list_next (l)) {
+		if (SEAHORSE_IS_GPGME_KEY (l->data))
+			local = g_list_prepend (local, l->data);
+	}
+
+	if (local == NULL)
+		return;
+
+	sync = g_new0 (SyncPublish, 1);
+	sync->source = g_object_ref (source);
+	sync->keyserver = g_strdup (keyserver);
+	sync->cancellable = cancellable ? g_object_ref (cancellable) : NULL;
+
+	seahorse_progress_prep_and_begin (cancellable, sync, _("Publishing keys"));
+
+	local = g_list_reverse (local);
+	exporter = seahorse_gpgme_exporter_new_multiple (local, FALSE);
+	seahorse_exporter_export (exporter, cancellable, on_sync_exported, sync);
+	g_object_unref (exporter);
+	g_list_free (local);
+}
+
+static void
+on_sync_retrieved (GObject *object,
+                   GAsyncResult *result,
+                   gpointer user_data)
+{
+	GError *error = NULL;
+
+	if (!seahorse_pgp_backend_retrieve_finish (SEAHORSE_PGP_BACKEND (object), result, &error))
+		seahorse_util_handle_error (&error, NULL, _("Couldn’t retrieve keys from the key servers"));
 }
 
 G_MODULE_EXPORT void
@@ -183,10 +498,8 @@ seahorse_keyserver_sync (GList *keys)
 	SeahorseGpgmeKeyring *keyring;
 	gchar *keyserver;
 	GCancellable *cancellable;
-	gchar **keyservers;
 	GPtrArray *keyids;
 	GList *l;
-	guint i;
 
 	if (!keys)
 		return;
@@ -198,26 +511,13 @@ seahorse_keyserver_sync (GList *keys)
 		g_ptr_array_add (keyids, (gchar *)seahorse_pgp_key_get_keyid (l->data));
 	g_ptr_array_add (keyids, NULL);
 
-	/* And now synchronizing keys from the servers */
-	keyservers = seahorse_servers_get_uris ();
-	for (i = 0; keyservers[i] != NULL; i++) {
-		source = seahorse_pgp_backend_lookup_remote (NULL, keyservers[i]);
-
-		/* This can happen if the URI scheme is not supported */
-		if (source == NULL)
-			continue;
-
-		keyring = seahorse_pgp_backend_get_default_keyring (NULL);
-		seahorse_transfer_keyids_async (SEAHORSE_SERVER_SOURCE (source),
-		                                SEAHORSE_PLACE (keyring),
-		                                (const gchar **)keyids->pdata,
-		                                cancellable,
-		                                on_transfer_download_complete,
-		                                g_object_ref (source));
-	}
+	/* And now synchronizing keys from the servers, merging what each has */
+	keyring = seahorse_pgp_backend_get_default_keyring (NULL);
+	seahorse_pgp_backend_retrieve_full_async (NULL, (const gchar **)keyids->pdata,
+	                                          SEAHORSE_PLACE (keyring), TRUE,
+	                                          cancellable, on_sync_retrieved, NULL);
 
 	g_ptr_array_free (keyids, TRUE);
-	g_strfreev (keyservers);
 
 	/* Publishing keys online */
 	keyserver = seahorse_app_settings_get_server_publish_to (seahorse_app_settings_instance ());
@@ -225,11 +525,8 @@ seahorse_keyserver_sync (GList *keys)
 		source = seahorse_pgp_backend_lookup_remote (NULL, keyserver);
 
 		/* This can happen if the URI scheme is not supported */
-		if (source != NULL) {
-			seahorse_pgp_backend_transfer_async (NULL, keys, SEAHORSE_PLACE (source),
-			                                     cancellable, on_transfer_upload_complete,
-			                                     g_object_ref (source));
-		}
+		if (source != NULL)
+			keyserver_sync_publish (keys, source, keyserver, cancellable);
 	}
 
 	g_free (keyserver);
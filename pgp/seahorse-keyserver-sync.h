@@ -22,8 +22,21 @@
 
 #include <gtk/gtk.h>
 
+#include "seahorse-server-source.h"
+
 void        seahorse_keyserver_sync             (GList *keys);
 
+void        seahorse_keyserver_sync_publish_async  (SeahorseServerSource *source,
+                                                    const gchar *keyserver,
+                                                    GBytes *keys,
+                                                    GCancellable *cancellable,
+                                                    GAsyncReadyCallback callback,
+                                                    gpointer user_data);
+
+gboolean    seahorse_keyserver_sync_publish_finish (GAsyncResult *result,
+                                                    guint *n_sent,
+                                                    GError **error);
+
 
 GtkWindow*  seahorse_keyserver_sync_show        (GList *keys,
                                                  GtkWindow *parent);
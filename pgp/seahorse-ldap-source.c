@@ -46,9 +46,6 @@
 
 #ifdef WITH_LDAP
 
-/* Amount of keys to load in a batch */
-#define DEFAULT_LOAD_BATCH 30
-
 /* -----------------------------------------------------------------------------
  * SERVER INFO
  */
@@ -69,28 +66,46 @@ free_ldap_server_info (LDAPServerInfo *sinfo)
     }
 }
 
+/* Server info is discovered once per host, and shared between sources */
+static GHashTable *server_infos = NULL;
+
 static void
 set_ldap_server_info (SeahorseLDAPSource *lsrc, LDAPServerInfo *sinfo)
 {
-    g_object_set_data_full (G_OBJECT (lsrc), "server-info", sinfo,
-                            (GDestroyNotify)free_ldap_server_info);
+    gchar *server;
+
+    if (!server_infos)
+        server_infos = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                              (GDestroyNotify)free_ldap_server_info);
+
+    g_object_get (lsrc, "key-server", &server, NULL);
+    g_hash_table_replace (server_infos, server, sinfo);
 }
 
 static LDAPServerInfo*         
 get_ldap_server_info (SeahorseLDAPSource *lsrc, gboolean force)
 {
-    LDAPServerInfo *sinfo;
-    
-    sinfo = g_object_get_data (G_OBJECT (lsrc), "server-info");
+    LDAPServerInfo *sinfo = NULL;
+    gchar *server;
+
+    if (server_infos) {
+        g_object_get (lsrc, "key-server", &server, NULL);
+        sinfo = g_hash_table_lookup (server_infos, server);
+        g_free (server);
+    }
+
+    if (!sinfo)
+        sinfo = g_object_get_data (G_OBJECT (lsrc), "server-info");
  
     /* When we're asked to force getting the data, we fill in 
-     * some defaults */   
+     * some defaults, just for this source */   
     if (!sinfo && force) {
         sinfo = g_new0 (LDAPServerInfo, 1);
         sinfo->base_dn = g_strdup ("OU=ACTIVE,O=PGP KEYSPACE,C=US");
         sinfo->key_attr = g_strdup ("pgpKey");
         sinfo->version = 0;
-        set_ldap_server_info (lsrc, sinfo);
+        g_object_set_data_full (G_OBJECT (lsrc), "server-info", sinfo,
+                                (GDestroyNotify)free_ldap_server_info);
     } 
     
     return sinfo;
@@ -103,26 +118,75 @@ get_ldap_server_info (SeahorseLDAPSource *lsrc, gboolean force)
  
 #define LDAP_ERROR_DOMAIN (get_ldap_error_domain())
 
-static gchar**
-get_ldap_values (LDAP *ld, LDAPMessage *entry, const char *attribute)
+/* 
+ * Values are parsed straight from the bervals libldap returns, without
+ * making a nul terminated copy of each one first.
+ */
+
+static gboolean
+berval_equal (const struct berval *bv, const gchar *str)
 {
-    GArray *array;
-    struct berval **bv;
-    gchar *value;
-    int num, i;
+    gsize len = strlen (str);
+    return bv->bv_len == len && g_ascii_strncasecmp (bv->bv_val, str, len) == 0;
+}
 
-    bv = ldap_get_values_len (ld, entry, attribute);
-    if (!bv)
-        return NULL;
+/* Short values are copied onto the stack to terminate them */
+static void
+berval_to_buffer (const struct berval *bv, gchar *buffer, gsize n_buffer)
+{
+    gsize len = MIN (bv->bv_len, n_buffer - 1);
+    memcpy (buffer, bv->bv_val, len);
+    buffer[len] = '\0';
+}
 
-    array = g_array_new (TRUE, TRUE, sizeof (gchar*));
-    num = ldap_count_values_len (bv);
-    for(i = 0; i < num; i++) {
-        value = g_strndup (bv[i]->bv_val, bv[i]->bv_len);
-        g_array_append_val(array, value);
-    }
+static long int
+parse_int_value (const struct berval *bv)
+{
+    gchar buffer[32];
+    berval_to_buffer (bv, buffer, sizeof (buffer));
+    return atoi (buffer);
+}
 
-    return (gchar**)g_array_free (array, FALSE);
+static gboolean
+parse_boolean_value (const struct berval *bv)
+{
+    return parse_int_value (bv) == 1;
+}
+
+static long int
+parse_date_value (const struct berval *bv)
+{
+    gchar buffer[32];
+    struct tm t;
+
+    berval_to_buffer (bv, buffer, sizeof (buffer));
+    memset(&t, 0, sizeof (t));
+
+    /* YYYYMMDDHHmmssZ */
+    sscanf(buffer, "%4d%2d%2d%2d%2d%2d",
+        &t.tm_year, &t.tm_mon, &t.tm_mday, 
+        &t.tm_hour, &t.tm_min, &t.tm_sec);
+
+    t.tm_year -= 1900;
+    t.tm_isdst = -1;
+    t.tm_mon--;
+
+    return mktime (&t);
+}
+
+static const gchar*
+parse_algo_value (const struct berval *bv)
+{
+	if (berval_equal (bv, "DH/DSS") ||
+	    berval_equal (bv, "Elg") ||
+	    berval_equal (bv, "Elgamal") ||
+	    berval_equal (bv, "DSS/DH"))
+		return "Elgamal";
+	if (berval_equal (bv, "RSA"))
+		return "RSA";
+	if (berval_equal (bv, "DSA"))
+		return "DSA";
+	return NULL;
 }
 
 #if WITH_DEBUG
@@ -131,9 +195,9 @@ static void
 dump_ldap_entry (LDAP *ld, LDAPMessage *res)
 {
     BerElement *pos;
-    gchar **values;
-    gchar **v;
+    struct berval **values;
     char *t;
+    int i;
     
     t = ldap_get_dn (ld, res);
     g_debug ("dn: %s\n", t);
@@ -142,11 +206,11 @@ dump_ldap_entry (LDAP *ld, LDAPMessage *res)
     for (t = ldap_first_attribute (ld, res, &pos); t; 
          t = ldap_next_attribute (ld, res, pos)) {
              
-        values = get_ldap_values (ld, res, t);
-        for (v = values; *v; v++) 
-            g_debug ("%s: %s\n", t, *v);
+        values = ldap_get_values_len (ld, res, t);
+        for (i = 0; values && values[i]; i++) 
+            g_debug ("%s: %.*s\n", t, (int)values[i]->bv_len, values[i]->bv_val);
 
-        g_strfreev (values);
+        ldap_value_free_len (values);
         ldap_memfree (t);
     }
     
@@ -167,101 +231,31 @@ get_ldap_error_domain ()
 static gchar*
 get_string_attribute (LDAP *ld, LDAPMessage *res, const char *attribute)
 {
-    gchar **vals;
+    struct berval **vals;
     gchar *v;
     
-    vals = get_ldap_values (ld, res, attribute);
+    vals = ldap_get_values_len (ld, res, attribute);
     if (!vals)
         return NULL; 
-    v = vals[0] ? g_strdup (vals[0]) : NULL;
-    g_strfreev (vals);
+    v = vals[0] ? g_strndup (vals[0]->bv_val, vals[0]->bv_len) : NULL;
+    ldap_value_free_len (vals);
     return v;
 }
 
-static gboolean
-get_boolean_attribute (LDAP* ld, LDAPMessage *res, const char *attribute)
-{
-    gchar **vals;
-    gboolean b;
-    
-    vals = get_ldap_values (ld, res, attribute);
-    if (!vals)
-        return FALSE;
-    b = vals[0] && atoi (vals[0]) == 1;
-    g_strfreev (vals);
-    return b;
-}
-
 static long int
 get_int_attribute (LDAP* ld, LDAPMessage *res, const char *attribute)
 {
-    gchar **vals;
+    struct berval **vals;
     long int d;
     
-    vals = get_ldap_values (ld, res, attribute);
+    vals = ldap_get_values_len (ld, res, attribute);
     if (!vals)
         return 0;
-    d = vals[0] ? atoi (vals[0]) : 0;
-    g_strfreev (vals);
+    d = vals[0] ? parse_int_value (vals[0]) : 0;
+    ldap_value_free_len (vals);
     return d;         
 }
 
-static long int
-get_date_attribute (LDAP* ld, LDAPMessage *res, const char *attribute)
-{
-    struct tm t;
-    gchar **vals;
-    long int d = 0;
-    
-    vals = get_ldap_values (ld, res, attribute);
-    if (!vals)
-        return 0;
-        
-    if (vals[0]) {
-        memset(&t, 0, sizeof (t));
-
-        /* YYYYMMDDHHmmssZ */
-        sscanf(vals[0], "%4d%2d%2d%2d%2d%2d",
-            &t.tm_year, &t.tm_mon, &t.tm_mday, 
-            &t.tm_hour, &t.tm_min, &t.tm_sec);
-
-        t.tm_year -= 1900;
-        t.tm_isdst = -1;
-        t.tm_mon--;
-
-        d = mktime (&t);
-    }        
-
-    g_strfreev (vals);
-    return d;         
-}
-
-static const gchar*
-get_algo_attribute (LDAP* ld, LDAPMessage *res, const char *attribute)
-{
-	const gchar *a = NULL;
-	gchar **vals;
-    
-	vals = get_ldap_values (ld, res, attribute);
-	if (!vals)
-		return 0;
-    
-	if (vals[0]) {
-		if (g_ascii_strcasecmp (vals[0], "DH/DSS") == 0 || 
-		    g_ascii_strcasecmp (vals[0], "Elg") == 0 ||
-		    g_ascii_strcasecmp (vals[0], "Elgamal") == 0 ||
-		    g_ascii_strcasecmp (vals[0], "DSS/DH") == 0)
-			a = "Elgamal";
-		if (g_ascii_strcasecmp (vals[0], "RSA") == 0)
-			a = "RSA";
-		if (g_ascii_strcasecmp (vals[0], "DSA") == 0)
-			a = "DSA";     
-	}
-    
-	g_strfreev (vals);
-	return a;
-}
-
 /* 
  * Escapes a value so it's safe to use in an LDAP filter. Also trims
  * any spaces which cause problems with some LDAP servers.
@@ -297,6 +291,7 @@ escape_ldap_value (const gchar *v)
     return result;
 }
 
+/* Called with a NULL @result when cancelled, or when the connection fails */
 typedef gboolean (*SeahorseLdapCallback)   (LDAPMessage *result,
                                             gpointer user_data);
 
@@ -304,6 +299,7 @@ typedef struct {
 	GSource source;
 	LDAP *ldap;
 	int ldap_op;
+	gpointer tag;
 	GCancellable *cancellable;
 	gboolean cancelled;
 	gint cancelled_sig;
@@ -318,15 +314,36 @@ seahorse_ldap_gsource_prepare (GSource *gsource,
 	if (ldap_gsource->cancelled)
 		return TRUE;
 
-	/* No other way, but to poll */
-	*timeout = 50;
+	/* Connection not yet open, no other way but to poll */
+	*timeout = ldap_gsource->tag ? -1 : 50;
 	return FALSE;
 }
 
 static gboolean
 seahorse_ldap_gsource_check (GSource *gsource)
 {
-	return TRUE;
+	SeahorseLdapGSource *ldap_gsource = (SeahorseLdapGSource *)gsource;
+
+	if (ldap_gsource->cancelled || !ldap_gsource->tag)
+		return TRUE;
+
+	return g_source_query_unix_fd (gsource, ldap_gsource->tag) != 0;
+}
+
+static void
+seahorse_ldap_gsource_watch (SeahorseLdapGSource *ldap_gsource)
+{
+	int fd = -1;
+
+	if (ldap_gsource->tag)
+		return;
+
+	/* The socket is only there once the connection is made */
+	if (ldap_get_option (ldap_gsource->ldap, LDAP_OPT_DESC, &fd) != LDAP_OPT_SUCCESS || fd < 0)
+		return;
+
+	ldap_gsource->tag = g_source_add_unix_fd ((GSource *)ldap_gsource, fd,
+	                                          G_IO_IN | G_IO_HUP | G_IO_ERR);
 }
 
 static gboolean
@@ -338,14 +355,18 @@ seahorse_ldap_gsource_dispatch (GSource *gsource,
 	struct timeval timeout;
 	LDAPMessage *result;
 	gboolean ret;
-	int rc, i;
+	int rc;
 
 	if (ldap_gsource->cancelled) {
 		((SeahorseLdapCallback)callback) (NULL, user_data);
 		return FALSE;
 	}
 
-	for (i = 0; i < DEFAULT_LOAD_BATCH; i++) {
+	/*
+	 * Drain everything that's available: libldap reads ahead, so
+	 * results can be waiting even when the socket isn't readable.
+	 */
+	for (;;) {
 
 		/* This effects a poll */
 		timeout.tv_sec = 0;
@@ -354,12 +375,14 @@ seahorse_ldap_gsource_dispatch (GSource *gsource,
 		rc = ldap_result (ldap_gsource->ldap, ldap_gsource->ldap_op,
 		                  0, &timeout, &result);
 		if (rc == -1) {
-			g_warning ("ldap_result failed with rc = %d, errno = %s",
-			           rc, g_strerror (errno));
+			g_debug ("ldap_result failed with rc = %d, errno = %s",
+			         rc, g_strerror (errno));
+			((SeahorseLdapCallback)callback) (NULL, user_data);
 			return FALSE;
 
 		/* Timeout */
 		} else if (rc == 0) {
+			seahorse_ldap_gsource_watch (ldap_gsource);
 			return TRUE;
 		}
 
@@ -369,8 +392,6 @@ seahorse_ldap_gsource_dispatch (GSource *gsource,
 		if (!ret)
 			return FALSE;
 	}
-
-	return TRUE;
 }
 
 static void
@@ -395,6 +416,9 @@ on_ldap_gsource_cancelled (GCancellable *cancellable,
 {
 	SeahorseLdapGSource *ldap_gsource = user_data;
 	ldap_gsource->cancelled = TRUE;
+
+	/* Wake up the main loop, it may be waiting on the socket */
+	g_source_set_ready_time ((GSource *)ldap_gsource, 0);
 }
 
 static GSource *
@@ -412,6 +436,9 @@ seahorse_ldap_gsource_new (LDAP *ldap,
 	ldap_gsource->ldap = ldap;
 	ldap_gsource->ldap_op = ldap_op;
 
+	/* Wait on the socket rather than polling */
+	seahorse_ldap_gsource_watch (ldap_gsource);
+
 	if (cancellable) {
 		ldap_gsource->cancellable = g_object_ref (cancellable);
 		ldap_gsource->cancelled_sig = g_cancellable_connect (cancellable,
@@ -439,9 +466,167 @@ seahorse_ldap_source_propagate_error (SeahorseLDAPSource *self,
 	return TRUE;
 }
 
+/* Why an operation got a NULL result: it was cancelled, or the connection failed */
+static GError *
+seahorse_ldap_source_result_error (SeahorseLDAPSource *self,
+                                   LDAP *ldap,
+                                   GCancellable *cancellable)
+{
+	GError *error = NULL;
+	int rc = LDAP_SUCCESS;
+
+	if (g_cancellable_is_cancelled (cancellable))
+		return g_error_new_literal (G_IO_ERROR, G_IO_ERROR_CANCELLED,
+		                            _("The operation was cancelled"));
+
+	if (ldap_get_option (ldap, LDAP_OPT_RESULT_CODE, &rc) != LDAP_OPT_SUCCESS ||
+	    rc == LDAP_SUCCESS)
+		rc = LDAP_SERVER_DOWN;
+
+	seahorse_ldap_source_propagate_error (self, rc, &error);
+	return error;
+}
+
+/* -----------------------------------------------------------------------------
+ * CONNECTION POOL
+ */
+
+/* Idle connections are kept around for this many seconds */
+#define LDAP_IDLE_TIMEOUT 60
+
+/* The maximum number of idle connections kept per source */
+#define LDAP_MAX_IDLE 4
+
+typedef struct {
+	SeahorseLDAPSource *source;
+	LDAP *ldap;
+	guint timeout_id;
+} LDAPConnection;
+
+static void
+ldap_connection_free (gpointer data)
+{
+	LDAPConnection *conn = data;
+	if (conn->timeout_id)
+		g_source_remove (conn->timeout_id);
+	ldap_unbind_ext (conn->ldap, NULL, NULL);
+	g_free (conn);
+}
+
+static gboolean
+on_ldap_connection_idle_timeout (gpointer user_data)
+{
+	LDAPConnection *conn = user_data;
+
+	g_debug ("closing idle LDAP connection");
+	conn->timeout_id = 0;
+	g_queue_remove (conn->source->connections, conn);
+	ldap_connection_free (conn);
+	return FALSE;
+}
+
+/* A connection that has been idle should have nothing to read */
+static gboolean
+ldap_connection_is_alive (LDAP *ldap)
+{
+	GPollFD pfd;
+	int fd = -1;
+
+	if (ldap_get_option (ldap, LDAP_OPT_DESC, &fd) != LDAP_OPT_SUCCESS || fd < 0)
+		return FALSE;
+
+	pfd.fd = fd;
+	pfd.events = G_IO_IN | G_IO_HUP | G_IO_ERR;
+	pfd.revents = 0;
+
+	/* Readable means closed, or a notice of disconnection */
+	return g_poll (&pfd, 1, 0) == 0;
+}
+
+static LDAP *
+seahorse_ldap_source_take_connection (SeahorseLDAPSource *self)
+{
+	LDAPConnection *conn;
+	LDAP *ldap;
+
+	while ((conn = g_queue_pop_head (self->connections)) != NULL) {
+		if (ldap_connection_is_alive (conn->ldap)) {
+			ldap = conn->ldap;
+			conn->ldap = NULL;
+			g_source_remove (conn->timeout_id);
+			g_free (conn);
+			return ldap;
+		}
+
+		/* Dropped while idle, we'll reconnect */
+		g_debug ("discarding dropped LDAP connection");
+		ldap_connection_free (conn);
+	}
+
+	return NULL;
+}
+
+/*
+ * The server may drop an idle connection without us noticing until it's
+ * used. When an operation on a reused connection fails that way before
+ * any results come back, it's released here and the operation should
+ * start again on a new connection. That only happens once.
+ */
+static gboolean
+seahorse_ldap_source_should_retry (SeahorseLDAPSource *self,
+                                   LDAP **ldap,
+                                   gboolean reused,
+                                   gboolean received,
+                                   gboolean *retried,
+                                   GError *error)
+{
+	if (!reused || received || *retried)
+		return FALSE;
+	if (!g_error_matches (error, LDAP_ERROR_DOMAIN, LDAP_SERVER_DOWN) &&
+	    !g_error_matches (error, LDAP_ERROR_DOMAIN, LDAP_CONNECT_ERROR))
+		return FALSE;
+
+	g_debug ("reused LDAP connection was dropped, reconnecting");
+	*retried = TRUE;
+	ldap_unbind_ext (*ldap, NULL, NULL);
+	*ldap = NULL;
+
+	/* The other idle connections are likely gone too */
+	g_queue_free_full (self->connections, ldap_connection_free);
+	self->connections = g_queue_new ();
+
+	return TRUE;
+}
+
+/*
+ * Returns a connection once an operation is done with it. Only pass
+ * @reuse when the operation has completed, and no results are pending.
+ */
+static void
+seahorse_ldap_source_release (SeahorseLDAPSource *self,
+                              LDAP *ldap,
+                              gboolean reuse)
+{
+	LDAPConnection *conn;
+
+	if (!reuse || g_queue_get_length (self->connections) >= LDAP_MAX_IDLE) {
+		ldap_unbind_ext (ldap, NULL, NULL);
+		return;
+	}
+
+	conn = g_new0 (LDAPConnection, 1);
+	conn->source = self;
+	conn->ldap = ldap;
+	conn->timeout_id = g_timeout_add_seconds (LDAP_IDLE_TIMEOUT,
+	                                          on_ldap_connection_idle_timeout,
+	                                          conn);
+	g_queue_push_head (self->connections, conn);
+}
+
 typedef struct {
 	GCancellable *cancellable;
 	LDAP *ldap;
+	gboolean reused;
 } source_connect_closure;
 
 static void
@@ -467,6 +652,13 @@ on_connect_server_info_completed (LDAPMessage *result,
 	int type;
 	int rc;
 
+	if (result == NULL) {
+		g_simple_async_result_take_error (res, seahorse_ldap_source_result_error (self, closure->ldap,
+		                                                                          closure->cancellable));
+		g_simple_async_result_complete_in_idle (res);
+		return FALSE;
+	}
+
 	type = ldap_msgtype (result);
 	g_return_val_if_fail (type == LDAP_RES_SEARCH_ENTRY || type == LDAP_RES_SEARCH_RESULT, FALSE);
 
@@ -526,6 +718,13 @@ on_connect_bind_completed (LDAPMessage *result,
 	int code;
 	int rc;
 
+	if (result == NULL) {
+		g_simple_async_result_take_error (res, seahorse_ldap_source_result_error (self, closure->ldap,
+		                                                                          closure->cancellable));
+		g_simple_async_result_complete_in_idle (res);
+		return FALSE;
+	}
+
 	g_return_val_if_fail (ldap_msgtype (result) == LDAP_RES_BIND, FALSE);
 
 	/* The result of the bind operation */
@@ -682,6 +881,15 @@ seahorse_ldap_source_connect_async (SeahorseLDAPSource *source,
 	closure->cancellable = cancellable ? g_object_ref (cancellable) : NULL;
 	g_simple_async_result_set_op_res_gpointer (res, closure, source_connect_free);
 
+	/* Reuse an idle connection that's already bound */
+	closure->ldap = seahorse_ldap_source_take_connection (source);
+	if (closure->ldap != NULL) {
+		closure->reused = TRUE;
+		g_simple_async_result_complete_in_idle (res);
+		g_object_unref (res);
+		return;
+	}
+
 	g_object_get (source, "key-server", &server, NULL);
 	g_return_if_fail (server && server[0]);
 	if ((pos = strchr (server, ':')) != NULL)
@@ -712,6 +920,7 @@ seahorse_ldap_source_connect_async (SeahorseLDAPSource *source,
 static LDAP *
 seahorse_ldap_source_connect_finish (SeahorseLDAPSource *source,
                                      GAsyncResult *result,
+                                     gboolean *reused,
                                      GError **error)
 {
 	source_connect_closure *closure;
@@ -726,6 +935,8 @@ seahorse_ldap_source_connect_finish (SeahorseLDAPSource *source,
 	closure = g_simple_async_result_get_op_res_gpointer (G_SIMPLE_ASYNC_RESULT (result));
 	ldap = closure->ldap;
 	closure->ldap = NULL;
+	if (reused)
+		*reused = closure->reused;
 	return ldap;
 }
 
@@ -734,13 +945,32 @@ G_DEFINE_TYPE (SeahorseLDAPSource, seahorse_ldap_source, SEAHORSE_TYPE_SERVER_SO
 static void 
 seahorse_ldap_source_init (SeahorseLDAPSource *self)
 {
+	self->connections = g_queue_new ();
+}
 
+static void
+seahorse_ldap_source_finalize (GObject *gobject)
+{
+	SeahorseLDAPSource *self = SEAHORSE_LDAP_SOURCE (gobject);
+
+	g_queue_free_full (self->connections, ldap_connection_free);
+
+	G_OBJECT_CLASS (seahorse_ldap_source_parent_class)->finalize (gobject);
 }
 
 typedef struct {
+	SeahorseLDAPSource *source;
 	GCancellable *cancellable;
+	gchar *match;
 	gchar *filter;
 	LDAP *ldap;
+	gboolean reuse;
+	gboolean reused;           /* The connection came from the pool */
+	gboolean received;
+	gboolean retried;
+	gboolean completed;
+	guint page_size;
+	struct berval cookie;
 	GcrSimpleCollection *results;
 } source_search_closure;
 
@@ -750,9 +980,13 @@ source_search_free (gpointer data)
 	source_search_closure *closure = data;
 	g_clear_object (&closure->cancellable);
 	g_clear_object (&closure->results);
+	g_free (closure->match);
 	g_free (closure->filter);
+	if (closure->cookie.bv_val)
+		ber_memfree (closure->cookie.bv_val);
 	if (closure->ldap)
-		ldap_unbind_ext (closure->ldap, NULL, NULL);
+		seahorse_ldap_source_release (closure->source, closure->ldap, closure->reuse);
+	g_object_unref (closure->source);
 	g_free (closure);
 }
 
@@ -762,38 +996,77 @@ static const char *PGP_ATTRIBUTES[] = {
 	"pgprevoked",
 	"pgpdisabled",
 	"pgpkeycreatetime",
-	"pgpkeyexpiretime"
+	"pgpkeyexpiretime",
 	"pgpkeysize",
 	"pgpkeytype",
 	NULL
 };
 
-/* Add a key to the key source from an LDAP entry */
+/*
+ * Add a key to the key source from an LDAP entry. The attributes are
+ * walked once, and the values point into the message itself.
+ */
 static void
 search_parse_key_from_ldap_entry (SeahorseLDAPSource *self,
                                   GcrSimpleCollection *results,
                                   LDAP *ldap,
                                   LDAPMessage *res)
 {
-	const gchar *algo;
-	long int timestamp;
-	long int expires;
-	gchar *fpr, *fingerprint;
-	gchar *uidstr;
-	gboolean revoked;
-	gboolean disabled;
-	int length;
+	const gchar *algo = NULL;
+	long int timestamp = 0;
+	long int expires = 0;
+	gchar *fpr = NULL;
+	gchar *fingerprint;
+	gchar *uidstr = NULL;
+	gboolean revoked = FALSE;
+	gboolean disabled = FALSE;
+	int length = 0;
+	BerElement *ber = NULL;
+	struct berval dn, attr;
+	BerVarray values;
+	struct berval *bv;
+	int rc;
 
 	g_return_if_fail (ldap_msgtype (res) == LDAP_RES_SEARCH_ENTRY);
 
-	fpr = get_string_attribute (ldap, res, "pgpcertid");
-	uidstr = get_string_attribute (ldap, res, "pgpuserid");
-	revoked = get_boolean_attribute (ldap, res, "pgprevoked");
-	disabled = get_boolean_attribute (ldap, res, "pgpdisabled");
-	timestamp = get_date_attribute (ldap, res, "pgpkeycreatetime");
-	expires = get_date_attribute (ldap, res, "pgpkeyexpiretime");
-	algo = get_algo_attribute (ldap, res, "pgpkeytype");
-	length = get_int_attribute (ldap, res, "pgpkeysize");
+	rc = ldap_get_dn_ber (ldap, res, &ber, &dn);
+	if (rc != LDAP_SUCCESS) {
+		g_warning ("couldn't parse LDAP entry: %s", ldap_err2string (rc));
+		return;
+	}
+
+	for (rc = ldap_get_attribute_ber (ldap, res, ber, &attr, &values);
+	     rc == LDAP_SUCCESS && attr.bv_val != NULL;
+	     rc = ldap_get_attribute_ber (ldap, res, ber, &attr, &values)) {
+
+		if (values == NULL)
+			continue;
+
+		bv = &values[0];
+		if (bv->bv_val == NULL) {
+			/* No values */
+		} else if (fpr == NULL && berval_equal (&attr, "pgpcertid")) {
+			fpr = g_strndup (bv->bv_val, bv->bv_len);
+		} else if (uidstr == NULL && berval_equal (&attr, "pgpuserid")) {
+			uidstr = g_strndup (bv->bv_val, bv->bv_len);
+		} else if (berval_equal (&attr, "pgprevoked")) {
+			revoked = parse_boolean_value (bv);
+		} else if (berval_equal (&attr, "pgpdisabled")) {
+			disabled = parse_boolean_value (bv);
+		} else if (berval_equal (&attr, "pgpkeycreatetime")) {
+			timestamp = parse_date_value (bv);
+		} else if (berval_equal (&attr, "pgpkeyexpiretime")) {
+			expires = parse_date_value (bv);
+		} else if (berval_equal (&attr, "pgpkeytype")) {
+			algo = parse_algo_value (bv);
+		} else if (berval_equal (&attr, "pgpkeysize")) {
+			length = parse_int_value (bv);
+		}
+
+		ber_memfree (values);
+	}
+
+	ber_free (ber, 0);
 
 	if (fpr && uidstr) {
 		SeahorsePgpSubkey *subkey;
@@ -848,19 +1121,139 @@ search_parse_key_from_ldap_entry (SeahorseLDAPSource *self,
 	g_free (uidstr);
 }
 
+static void         on_search_connect_completed     (GObject *source,
+                                                     GAsyncResult *result,
+                                                     gpointer user_data);
+
+static void
+search_complete (GSimpleAsyncResult *res,
+                 GError *error)
+{
+	source_search_closure *closure = g_simple_async_result_get_op_res_gpointer (res);
+
+	if (closure->completed)
+		return;
+
+	if (seahorse_ldap_source_should_retry (closure->source, &closure->ldap, closure->reused,
+	                                       closure->received, &closure->retried, error)) {
+		g_error_free (error);
+		seahorse_ldap_source_connect_async (closure->source, closure->cancellable,
+		                                    on_search_connect_completed,
+		                                    g_object_ref (res));
+		return;
+	}
+
+	closure->completed = TRUE;
+
+	if (error != NULL)
+		g_simple_async_result_take_error (res, error);
+	else
+		closure->reuse = TRUE;
+
+	seahorse_progress_end (closure->cancellable, res);
+	g_simple_async_result_complete (res);
+}
+
+/*
+ * Requests the next page of results, using the Simple Paged Results
+ * control (RFC 2696). Servers that don't support it return everything.
+ */
+static gboolean
+search_send_page (GSimpleAsyncResult *res)
+{
+	source_search_closure *closure = g_simple_async_result_get_op_res_gpointer (res);
+	SeahorseLDAPSource *self = closure->source;
+	LDAPControl *controls[2] = { NULL, NULL };
+	LDAPServerInfo *sinfo;
+	GError *error = NULL;
+	int ldap_op;
+	int rc;
+
+	sinfo = get_ldap_server_info (self, TRUE);
+
+	g_debug ("Searching Server ... base: %s, filter: %s",
+	         sinfo->base_dn, closure->filter);
+
+	if (closure->page_size > 0) {
+		rc = ldap_create_page_control (closure->ldap, closure->page_size,
+		                               closure->cookie.bv_val ? &closure->cookie : NULL,
+		                               0, &controls[0]);
+		if (seahorse_ldap_source_propagate_error (self, rc, &error)) {
+			search_complete (res, error);
+			return FALSE;
+		}
+	}
+
+	rc = ldap_search_ext (closure->ldap, sinfo->base_dn, LDAP_SCOPE_SUBTREE,
+	                      closure->filter, (char **)PGP_ATTRIBUTES, 0,
+	                      controls[0] ? controls : NULL, NULL, NULL, 0, &ldap_op);
+
+	if (controls[0])
+		ldap_control_free (controls[0]);
+
+	if (seahorse_ldap_source_propagate_error (self, rc, &error)) {
+		search_complete (res, error);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/* Whether the server has another page of results for us */
+static gboolean
+search_parse_page (source_search_closure *closure,
+                   LDAPControl **controls)
+{
+	LDAPControl *control;
+	ber_int_t estimate;
+	int rc;
+
+	if (closure->cookie.bv_val)
+		ber_memfree (closure->cookie.bv_val);
+	closure->cookie.bv_val = NULL;
+	closure->cookie.bv_len = 0;
+
+	if (closure->page_size == 0 || controls == NULL)
+		return FALSE;
+
+	control = ldap_control_find (LDAP_CONTROL_PAGEDRESULTS, controls, NULL);
+	if (control == NULL)
+		return FALSE;
+
+	rc = ldap_parse_pageresponse_control (closure->ldap, control,
+	                                      &estimate, &closure->cookie);
+	if (rc != LDAP_SUCCESS)
+		return FALSE;
+
+	return closure->cookie.bv_val != NULL && closure->cookie.bv_len > 0;
+}
+
 static gboolean
 on_search_search_completed (LDAPMessage *result,
                             gpointer user_data)
 {
 	GSimpleAsyncResult *res = G_SIMPLE_ASYNC_RESULT (user_data);
 	source_search_closure *closure = g_simple_async_result_get_op_res_gpointer (res);
-	SeahorseLDAPSource *self = SEAHORSE_LDAP_SOURCE (g_async_result_get_source_object (user_data));
+	SeahorseLDAPSource *self = closure->source;
+	LDAPControl **controls = NULL;
 	GError *error = NULL;
+	gboolean more;
 	char *message;
 	int code;
 	int type;
 	int rc;
 
+	if (closure->completed)
+		return FALSE;
+
+	if (result == NULL) {
+		search_complete (res, seahorse_ldap_source_result_error (self, closure->ldap,
+		                                                         closure->cancellable));
+		return FALSE;
+	}
+
+	closure->received = TRUE;
+
 	type = ldap_msgtype (result);
 	g_return_val_if_fail (type == LDAP_RES_SEARCH_ENTRY || type == LDAP_RES_SEARCH_RESULT, FALSE);
 
@@ -875,29 +1268,36 @@ on_search_search_completed (LDAPMessage *result,
 		                                  closure->ldap, result);
 		return TRUE; /* keep calling this callback */
 
-	/* All entries done */
+	/* All entries in this page done */
 	} else {
 		rc = ldap_parse_result (closure->ldap, result, &code, NULL,
-		                        &message, NULL, NULL, 0);
+		                        &message, NULL, &controls, 0);
 		g_return_val_if_fail (rc == LDAP_SUCCESS, FALSE);
 
-		/* Error codes that we ignore */
+		more = search_parse_page (closure, controls);
+		ldap_controls_free (controls);
+
+		/* The server had more matches than it would return */
 		switch (code) {
 		case LDAP_SIZELIMIT_EXCEEDED:
+		case LDAP_ADMINLIMIT_EXCEEDED:
+			g_debug ("search results truncated: %s", message ? message : "");
+			g_signal_emit_by_name (self, "search-truncated", closure->match);
 			code = LDAP_SUCCESS;
+			more = FALSE;
 			break;
 		};
 
 		/* Failure */
 		if (code != LDAP_SUCCESS)
-			g_simple_async_result_set_error (res, LDAP_ERROR_DOMAIN,
-			                                 code, "%s", message);
-		else if (seahorse_ldap_source_propagate_error (self, code, &error))
-			g_simple_async_result_take_error (res, error);
+			error = g_error_new (LDAP_ERROR_DOMAIN, code, "%s", message);
 
 		ldap_memfree (message);
-		seahorse_progress_end (closure->cancellable, res);
-		g_simple_async_result_complete (res);
+
+		if (error == NULL && more)
+			return search_send_page (res);
+
+		search_complete (res, error);
 		return FALSE;
 	}
 }
@@ -909,14 +1309,11 @@ on_search_connect_completed (GObject *source,
 {
 	GSimpleAsyncResult *res = G_SIMPLE_ASYNC_RESULT (user_data);
 	source_search_closure *closure = g_simple_async_result_get_op_res_gpointer (res);
-	SeahorseLDAPSource *self = SEAHORSE_LDAP_SOURCE (source);
 	GError *error = NULL;
-	LDAPServerInfo *sinfo;
-	int ldap_op;
-	int rc;
+	GSource *gsource;
 
 	closure->ldap = seahorse_ldap_source_connect_finish (SEAHORSE_LDAP_SOURCE (source),
-	                                                     result, &error);
+	                                                     result, &closure->reused, &error);
 	if (error != NULL) {
 		g_simple_async_result_take_error (res, error);
 		g_simple_async_result_complete (res);
@@ -924,21 +1321,9 @@ on_search_connect_completed (GObject *source,
 		return;
 	}
 
-	sinfo = get_ldap_server_info (self, TRUE);
-
-	g_debug ("Searching Server ... base: %s, filter: %s",
-	         sinfo->base_dn, closure->filter);
-
-	rc = ldap_search_ext (closure->ldap, sinfo->base_dn, LDAP_SCOPE_SUBTREE,
-	                      closure->filter, (char **)PGP_ATTRIBUTES, 0,
-	                      NULL, NULL, NULL, 0, &ldap_op);
-
-	if (seahorse_ldap_source_propagate_error (self, rc, &error)) {
-		g_simple_async_result_take_error (res, error);
-		g_simple_async_result_complete (res);
-
-	} else {
-		GSource *gsource = seahorse_ldap_gsource_new (closure->ldap, ldap_op,
+	if (search_send_page (res)) {
+		/* One source for the results of all the pages */
+		gsource = seahorse_ldap_gsource_new (closure->ldap, LDAP_RES_ANY,
 		                                     closure->cancellable);
 		g_source_set_callback (gsource, (GSourceFunc)on_search_search_completed,
 		                       g_object_ref (res), g_object_unref);
@@ -949,7 +1334,6 @@ on_search_connect_completed (GObject *source,
 	g_object_unref (res);
 }
 
-
 static void
 seahorse_ldap_source_search_async (SeahorseServerSource *source,
                                    const gchar *match,
@@ -966,8 +1350,11 @@ seahorse_ldap_source_search_async (SeahorseServerSource *source,
 	res = g_simple_async_result_new (G_OBJECT (source), callback, user_data,
 	                                 seahorse_ldap_source_search_async);
 	closure = g_new0 (source_search_closure, 1);
+	closure->source = g_object_ref (self);
 	closure->cancellable = cancellable ? g_object_ref (cancellable) : NULL;
 	closure->results = g_object_ref (results);
+	closure->match = g_strdup (match);
+	closure->page_size = MAX (seahorse_app_settings_get_keyserver_page_size (seahorse_app_settings_instance ()), 0);
 	text = escape_ldap_value (match);
 	closure->filter = g_strdup_printf ("(pgpuserid=*%s*)", text);
 	g_free (text);
@@ -997,10 +1384,21 @@ seahorse_ldap_source_search_finish (SeahorseServerSource *source,
 }
 
 typedef struct {
+	SeahorseLDAPSource *source;
 	GPtrArray *keydata;
-	gint current_index;
+	guint next_index;
+	guint num_begun;
+	GHashTable *pending;       /* ldap_op -> keydata */
+	guint window;
+	guint num_failed;
+	gint first_code;
 	GCancellable *cancellable;
 	LDAP *ldap;
+	gboolean reuse;
+	gboolean reused;           /* The connection came from the pool */
+	gboolean received;
+	gboolean retried;
+	gboolean completed;
 } source_import_closure;
 
 static void
@@ -1008,14 +1406,64 @@ source_import_free (gpointer data)
 {
 	source_import_closure *closure = data;
 	g_ptr_array_free (closure->keydata, TRUE);
+	g_hash_table_destroy (closure->pending);
 	g_clear_object (&closure->cancellable);
 	if (closure->ldap)
-		ldap_unbind_ext (closure->ldap, NULL, NULL);
+		seahorse_ldap_source_release (closure->source, closure->ldap, closure->reuse);
+	g_object_unref (closure->source);
 	g_free (closure);
 }
 
-static void       import_send_key       (SeahorseLDAPSource *self,
-                                         GSimpleAsyncResult *res);
+static void         on_import_connect_completed     (GObject *source,
+                                                     GAsyncResult *result,
+                                                     gpointer user_data);
+
+static void
+import_complete (GSimpleAsyncResult *res,
+                 GError *error)
+{
+	source_import_closure *closure = g_simple_async_result_get_op_res_gpointer (res);
+	gchar *server;
+
+	if (closure->completed)
+		return;
+
+	/* Nothing was answered, so send all the keys again */
+	if (seahorse_ldap_source_should_retry (closure->source, &closure->ldap, closure->reused,
+	                                       closure->received, &closure->retried, error)) {
+		g_error_free (error);
+		g_hash_table_remove_all (closure->pending);
+		closure->next_index = 0;
+		seahorse_ldap_source_connect_async (closure->source, closure->cancellable,
+		                                    on_import_connect_completed,
+		                                    g_object_ref (res));
+		return;
+	}
+
+	closure->completed = TRUE;
+
+	if (error != NULL) {
+		g_simple_async_result_take_error (res, error);
+
+	} else if (closure->num_failed > 0) {
+		g_object_get (closure->source, "key-server", &server, NULL);
+		g_simple_async_result_set_error (res, LDAP_ERROR_DOMAIN, closure->first_code,
+		                                 ngettext ("Couldn’t send %u of %u key to server “%s”: %s",
+		                                           "Couldn’t send %u of %u keys to server “%s”: %s",
+		                                           closure->keydata->len),
+		                                 closure->num_failed, closure->keydata->len,
+		                                 server, ldap_err2string (closure->first_code));
+		closure->reuse = TRUE;
+		g_free (server);
+
+	} else {
+		closure->reuse = TRUE;
+	}
+
+	g_simple_async_result_complete (res);
+}
+
+static gboolean   import_send_keys      (GSimpleAsyncResult *res);
 
 /* Called when results come in for a key send */
 static gboolean
@@ -1024,88 +1472,128 @@ on_import_add_completed (LDAPMessage *result,
 {
 	GSimpleAsyncResult *res = G_SIMPLE_ASYNC_RESULT (user_data);
 	source_import_closure *closure = g_simple_async_result_get_op_res_gpointer (res);
-	SeahorseLDAPSource *self = SEAHORSE_LDAP_SOURCE (g_async_result_get_source_object (user_data));
-	GError *error = NULL;
+	gchar *keydata;
 	char *message;
+	int ldap_op;
 	int code;
 	int rc;
 
+	if (closure->completed)
+		return FALSE;
+
+	if (result == NULL) {
+		import_complete (res, seahorse_ldap_source_result_error (closure->source, closure->ldap,
+		                                                         closure->cancellable));
+		return FALSE;
+	}
+
+	closure->received = TRUE;
 	g_return_val_if_fail (ldap_msgtype (result) == LDAP_RES_ADD, FALSE);
 
+	ldap_op = ldap_msgid (result);
+	keydata = g_hash_table_lookup (closure->pending, GINT_TO_POINTER (ldap_op));
+	g_return_val_if_fail (keydata != NULL, TRUE);
+
 	rc = ldap_parse_result (closure->ldap, result, &code, NULL,
 	                        &message, NULL, NULL, 0);
 	g_return_val_if_fail (rc == LDAP_SUCCESS, FALSE);
 
 	/* TODO: Somehow communicate this to the user */
-	if (code == LDAP_ALREADY_EXISTS)
+	if (code == LDAP_ALREADY_EXISTS) {
+		g_debug ("key was already on the server");
 		code = LDAP_SUCCESS;
+	}
+
+	/* A key the server refused, carry on with the others */
+	if (code != LDAP_SUCCESS) {
+		g_message ("couldn't send key to server: %s: %s",
+		           ldap_err2string (code), message ? message : "");
+		if (closure->num_failed++ == 0)
+			closure->first_code = code;
+	}
 
 	ldap_memfree (message);
 
-	if (seahorse_ldap_source_propagate_error (self, code, &error)) {
-		g_simple_async_result_take_error (res, error);
-		g_simple_async_result_complete (res);
-		return FALSE; /* don't call for this source again */
-	}
+	g_hash_table_remove (closure->pending, GINT_TO_POINTER (ldap_op));
+	seahorse_progress_end (closure->cancellable, keydata);
 
-	import_send_key (self, res);
-	return FALSE; /* don't call for this source again */
+	return import_send_keys (res);
 }
 
-static void
-import_send_key (SeahorseLDAPSource *self,
-                 GSimpleAsyncResult *res)
+/*
+ * Keeps a window of add operations outstanding on the connection.
+ * Returns whether results are still expected.
+ */
+static gboolean
+import_send_keys (GSimpleAsyncResult *res)
 {
 	source_import_closure *closure = g_simple_async_result_get_op_res_gpointer (res);
+	SeahorseLDAPSource *self = closure->source;
 	LDAPServerInfo *sinfo;
 	gchar *base;
 	LDAPMod mod;
 	LDAPMod *attrs[2];
 	char *values[2];
-	GSource *gsource;
 	GError *error = NULL;
 	gchar *keydata;
 	int ldap_op;
 	int rc;
 
-	if (closure->current_index >= 0) {
-		keydata = closure->keydata->pdata[closure->current_index];
-		seahorse_progress_end (closure->cancellable, keydata);
-	}
+	sinfo = get_ldap_server_info (self, TRUE);
+	base = g_strdup_printf ("pgpCertid=virtual,%s", sinfo->base_dn);
 
-	closure->current_index++;
+	while (g_hash_table_size (closure->pending) < closure->window &&
+	       closure->next_index < closure->keydata->len) {
+		keydata = closure->keydata->pdata[closure->next_index++];
 
-	/* All done, complete operation */
-	if (closure->current_index == (gint)closure->keydata->len) {
-		g_simple_async_result_complete (res);
-		return;
-	}
+		/* Keys sent again after reconnecting have already begun */
+		if (closure->next_index > closure->num_begun) {
+			seahorse_progress_begin (closure->cancellable, keydata);
+			closure->num_begun = closure->next_index;
+		}
+		values[0] = keydata;
+		values[1] = NULL;
 
-	keydata = closure->keydata->pdata[closure->current_index];
-	seahorse_progress_begin (closure->cancellable, keydata);
-	values[0] = keydata;
-	values[1] = NULL;
+		memset (&mod, 0, sizeof (mod));
+		mod.mod_op = LDAP_MOD_ADD;
+		mod.mod_type = sinfo->key_attr;
+		mod.mod_values = values;
 
-	sinfo = get_ldap_server_info (self, TRUE);
-	memset (&mod, 0, sizeof (mod));
-	mod.mod_op = LDAP_MOD_ADD;
-	mod.mod_type = sinfo->key_attr;
-	mod.mod_values = values;
+		attrs[0] = &mod;
+		attrs[1] = NULL;
 
-	attrs[0] = &mod;
-	attrs[1] = NULL;
+		rc = ldap_add_ext (closure->ldap, base, attrs, NULL, NULL, &ldap_op);
+		if (seahorse_ldap_source_propagate_error (self, rc, &error)) {
+			g_free (base);
+			import_complete (res, error);
+			return FALSE;
+		}
 
-	base = g_strdup_printf ("pgpCertid=virtual,%s", sinfo->base_dn);
-	rc = ldap_add_ext (closure->ldap, base, attrs, NULL, NULL, &ldap_op);
+		g_hash_table_insert (closure->pending, GINT_TO_POINTER (ldap_op), keydata);
+	}
 
 	g_free (base);
 
-	if (seahorse_ldap_source_propagate_error (self, rc, &error)) {
-		g_simple_async_result_complete (res);
-		return;
+	/* All done, complete operation */
+	if (g_hash_table_size (closure->pending) == 0) {
+		import_complete (res, NULL);
+		return FALSE;
 	}
 
-	gsource = seahorse_ldap_gsource_new (closure->ldap, ldap_op,
+	return TRUE;
+}
+
+static void
+import_start (GSimpleAsyncResult *res)
+{
+	source_import_closure *closure = g_simple_async_result_get_op_res_gpointer (res);
+	GSource *gsource;
+
+	if (!import_send_keys (res))
+		return;
+
+	/* One source for the results of all the adds */
+	gsource = seahorse_ldap_gsource_new (closure->ldap, LDAP_RES_ANY,
 	                                     closure->cancellable);
 	g_source_set_callback (gsource, (GSourceFunc)on_import_add_completed,
 	                       g_object_ref (res), g_object_unref);
@@ -1123,12 +1611,12 @@ on_import_connect_completed (GObject *source,
 	GError *error = NULL;
 
 	closure->ldap = seahorse_ldap_source_connect_finish (SEAHORSE_LDAP_SOURCE (source),
-	                                                     result, &error);
+	                                                     result, &closure->reused, &error);
 	if (error != NULL) {
 		g_simple_async_result_take_error (res, error);
 		g_simple_async_result_complete (res);
 	} else {
-		import_send_key (SEAHORSE_LDAP_SOURCE (source), res);
+		import_start (res);
 	}
 
 	g_object_unref (res);
@@ -1143,30 +1631,37 @@ seahorse_ldap_source_import_async (SeahorseServerSource *source,
 {
 	SeahorseLDAPSource *self = SEAHORSE_LDAP_SOURCE (source);
 	source_import_closure *closure;
+	SeahorseBlockScanner *scanner;
 	GSimpleAsyncResult *res;
+	GError *error = NULL;
+	const gchar *block;
 	gchar *keydata;
-	guint len;
+	gsize len;
 
 	res = g_simple_async_result_new (G_OBJECT (source), callback, user_data,
 	                                 seahorse_ldap_source_import_async);
 	closure = g_new0 (source_import_closure, 1);
+	closure->source = g_object_ref (self);
 	closure->cancellable = cancellable ? g_object_ref (cancellable) : NULL;
-	closure->current_index = -1;
+	closure->pending = g_hash_table_new (g_direct_hash, g_direct_equal);
+	closure->window = MAX (seahorse_app_settings_get_keyserver_max_requests (seahorse_app_settings_instance ()), 1);
 	g_simple_async_result_set_op_res_gpointer (res, closure, source_import_free);
 
 	closure->keydata =g_ptr_array_new_with_free_func (g_free);
-	for (;;) {
-		GString *buf = g_string_sized_new (2048);
-		len = seahorse_util_read_data_block (buf, input, "-----BEGIN PGP PUBLIC KEY BLOCK-----",
-		                                     "-----END PGP PUBLIC KEY BLOCK-----");
-		if (len > 0) {
-			keydata = g_string_free (buf, FALSE);
-			g_ptr_array_add (closure->keydata, keydata);
-			seahorse_progress_prep (closure->cancellable, keydata, NULL);
-		} else {
-			g_string_free (buf, TRUE);
-			break;
-		}
+	scanner = seahorse_block_scanner_new (input, "-----BEGIN PGP PUBLIC KEY BLOCK-----",
+	                                      "-----END PGP PUBLIC KEY BLOCK-----");
+	while (seahorse_block_scanner_next (scanner, &block, &len, cancellable, &error)) {
+		keydata = g_strndup (block, len);
+		g_ptr_array_add (closure->keydata, keydata);
+		seahorse_progress_prep (closure->cancellable, keydata, NULL);
+	}
+	seahorse_block_scanner_free (scanner);
+
+	if (error != NULL) {
+		g_simple_async_result_take_error (res, error);
+		g_simple_async_result_complete_in_idle (res);
+		g_object_unref (res);
+		return;
 	}
 
 	seahorse_ldap_source_connect_async (self, cancellable,
@@ -1191,29 +1686,121 @@ seahorse_ldap_source_import_finish (SeahorseServerSource *source,
 	return NULL;
 }
 
+/* Key ids per search, and searches in flight during an export */
+#define EXPORT_BATCH_SIZE     50
+#define EXPORT_MAX_SEARCHES   4
+
 typedef struct {
+	GPtrArray *fingerprints;   /* Borrowed from the closure */
+	int ldap_op;
+} ExportBatch;
+
+typedef struct {
+	SeahorseLDAPSource *source;
 	GPtrArray *fingerprints;
-	gint current_index;
+	GHashTable *requested;     /* pgpcertid -> fingerprint */
+	GHashTable *found;         /* fingerprint */
+	GHashTable *batches;       /* ldap_op -> ExportBatch */
+	guint next_index;
+	guint num_begun;
+	GPtrArray *missing;        /* Fingerprints the server didn't have, borrowed */
 	GString *data;
 	GCancellable *cancellable;
 	LDAP *ldap;
+	gboolean reuse;
+	gboolean reused;           /* The connection came from the pool */
+	gboolean received;
+	gboolean retried;
+	gboolean completed;
 } ExportClosure;
 
+static void
+export_batch_free (gpointer data)
+{
+	ExportBatch *batch = data;
+	g_ptr_array_free (batch->fingerprints, TRUE);
+	g_free (batch);
+}
+
 static void
 export_closure_free (gpointer data)
 {
 	ExportClosure *closure = data;
 	g_ptr_array_free (closure->fingerprints, TRUE);
+	g_hash_table_destroy (closure->requested);
+	g_hash_table_destroy (closure->found);
+	g_hash_table_destroy (closure->batches);
+	g_ptr_array_free (closure->missing, TRUE);
 	if (closure->data)
 		g_string_free (closure->data, TRUE);
 	g_clear_object (&closure->cancellable);
 	if (closure->ldap)
-		ldap_unbind_ext (closure->ldap, NULL, NULL);
+		seahorse_ldap_source_release (closure->source, closure->ldap, closure->reuse);
+	g_object_unref (closure->source);
 	g_free (closure);
 }
 
-static void     export_retrieve_key     (SeahorseLDAPSource *self,
-                                         GSimpleAsyncResult *res);
+/* The pgpcertid servers use, the last 16 digits of the fingerprint */
+static gchar *
+calc_export_certid (const gchar *fingerprint)
+{
+	gsize length = strlen (fingerprint);
+	if (length > 16)
+		fingerprint += (length - 16);
+	return g_ascii_strup (fingerprint, -1);
+}
+
+static void         on_export_connect_completed     (GObject *source,
+                                                     GAsyncResult *result,
+                                                     gpointer user_data);
+
+static void
+export_complete (GSimpleAsyncResult *res,
+                 GError *error)
+{
+	ExportClosure *closure = g_simple_async_result_get_op_res_gpointer (res);
+	SeahorseLDAPSource *self = closure->source;
+	gchar *server;
+
+	if (closure->completed)
+		return;
+
+	/* Nothing was answered, so search for all the keys again */
+	if (seahorse_ldap_source_should_retry (self, &closure->ldap, closure->reused,
+	                                       closure->received, &closure->retried, error)) {
+		g_error_free (error);
+		g_hash_table_remove_all (closure->batches);
+		closure->next_index = 0;
+		seahorse_ldap_source_connect_async (self, closure->cancellable,
+		                                    on_export_connect_completed,
+		                                    g_object_ref (res));
+		return;
+	}
+
+	closure->completed = TRUE;
+
+	if (error != NULL) {
+		g_simple_async_result_take_error (res, error);
+
+	/*
+	 * Nothing at all was found. This is an answer from the server, not a
+	 * failure to talk to it, so callers can tell the two apart.
+	 */
+	} else if (closure->missing->len > 0 && closure->missing->len == closure->fingerprints->len) {
+		g_object_get (self, "key-server", &server, NULL);
+		g_simple_async_result_set_error (res, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+		                                 _("Couldn’t communicate with %s: %s"),
+		                                 server, ldap_err2string (LDAP_NO_SUCH_OBJECT));
+		g_free (server);
+
+	} else {
+		closure->reuse = TRUE;
+	}
+
+	g_simple_async_result_complete (res);
+}
+
+static gboolean     export_retrieve_keys    (GSimpleAsyncResult *res);
 
 static gboolean
 on_export_search_completed (LDAPMessage *result,
@@ -1221,114 +1808,183 @@ on_export_search_completed (LDAPMessage *result,
 {
 	GSimpleAsyncResult *res = G_SIMPLE_ASYNC_RESULT (user_data);
 	ExportClosure *closure = g_simple_async_result_get_op_res_gpointer (res);
-	SeahorseLDAPSource *self = SEAHORSE_LDAP_SOURCE (g_async_result_get_source_object (G_ASYNC_RESULT (res)));
+	SeahorseLDAPSource *self = closure->source;
 	LDAPServerInfo *sinfo;
+	const gchar *fingerprint;
+	ExportBatch *batch;
 	char *message;
 	GError *error = NULL;
+	gchar *certid;
 	gchar *key;
 	int code;
 	int type;
 	int rc;
+	guint i;
+
+	if (closure->completed)
+		return FALSE;
+
+	if (result == NULL) {
+		export_complete (res, seahorse_ldap_source_result_error (self, closure->ldap,
+		                                                         closure->cancellable));
+		return FALSE;
+	}
+
+	closure->received = TRUE;
 
 	type = ldap_msgtype (result);
 	g_return_val_if_fail (type == LDAP_RES_SEARCH_ENTRY || type == LDAP_RES_SEARCH_RESULT, FALSE);
 	sinfo = get_ldap_server_info (self, TRUE);
 
+	batch = g_hash_table_lookup (closure->batches, GINT_TO_POINTER (ldap_msgid (result)));
+	g_return_val_if_fail (batch != NULL, TRUE);
+
 	/* An LDAP Entry */
 	if (type == LDAP_RES_SEARCH_ENTRY) {
 
-		g_debug ("Server Info Result");
+		g_debug ("Retrieved Key Entry");
 #ifdef WITH_DEBUG
 		dump_ldap_entry (closure->ldap, result);
 #endif
 
 		key = get_string_attribute (closure->ldap, result, sinfo->key_attr);
-
 		if (key == NULL) {
 			g_warning ("key server missing pgp key data");
-			seahorse_ldap_source_propagate_error (self, LDAP_NO_SUCH_OBJECT, &error);
-			g_simple_async_result_take_error (res, error);
-			g_simple_async_result_complete (res);
-			return FALSE;
+			return TRUE;
+		}
+
+		/* Map it back to what was asked for */
+		certid = get_string_attribute (closure->ldap, result, "pgpcertid");
+		if (certid != NULL) {
+			g_strstrip (certid);
+			for (i = 0; certid[i]; i++)
+				certid[i] = g_ascii_toupper (certid[i]);
+			fingerprint = g_hash_table_lookup (closure->requested, certid);
+			if (fingerprint != NULL)
+				g_hash_table_add (closure->found, (gpointer)fingerprint);
+			else
+				g_debug ("unrequested key %s from server", certid);
 		}
 
 		g_string_append (closure->data, key);
 		g_string_append_c (closure->data, '\n');
 
+		g_free (certid);
 		g_free (key);
 		return TRUE;
 
-	/* No more entries, result */
+	/* No more entries for this batch */
 	} else {
 		rc = ldap_parse_result (closure->ldap, result, &code, NULL,
 		                        &message, NULL, NULL, 0);
 		g_return_val_if_fail (rc == LDAP_SUCCESS, FALSE);
+		ldap_memfree (message);
 
-		if (seahorse_ldap_source_propagate_error (self, code, &error)) {
-			g_simple_async_result_take_error (res, error);
-			g_simple_async_result_complete (res);
+		/* Some servers answer this rather than an empty result */
+		if (code != LDAP_NO_SUCH_OBJECT &&
+		    seahorse_ldap_source_propagate_error (self, code, &error)) {
+			export_complete (res, error);
 			return FALSE;
 		}
 
-		ldap_memfree (message);
+		for (i = 0; i < batch->fingerprints->len; i++) {
+			fingerprint = batch->fingerprints->pdata[i];
+			if (!g_hash_table_contains (closure->found, fingerprint)) {
+				g_debug ("key %s was not found on the key server", fingerprint);
+				g_ptr_array_add (closure->missing, (gpointer)fingerprint);
+			}
+			seahorse_progress_end (closure->cancellable, fingerprint);
+		}
+
+		g_hash_table_remove (closure->batches, GINT_TO_POINTER (batch->ldap_op));
 
 		/* Process more keys if possible */
-		export_retrieve_key (self, res);
-		return FALSE;
+		return export_retrieve_keys (res);
 	}
 }
 
-static void
-export_retrieve_key (SeahorseLDAPSource *self,
-                     GSimpleAsyncResult *res)
+/*
+ * Keeps several searches going at once, each looking for a batch of
+ * keys at a time. Returns whether results are still expected.
+ */
+static gboolean
+export_retrieve_keys (GSimpleAsyncResult *res)
 {
 	ExportClosure *closure = g_simple_async_result_get_op_res_gpointer (res);
+	SeahorseLDAPSource *self = closure->source;
 	LDAPServerInfo *sinfo;
-	gchar *filter;
-	char *attrs[2];
-	GSource *gsource;
 	const gchar *fingerprint;
+	ExportBatch *batch;
+	GString *filter;
+	char *attrs[3];
 	GError *error = NULL;
-	int length, rc;
-	int ldap_op;
+	gchar *certid;
+	int rc;
 
-	if (closure->current_index > 0) {
-		fingerprint = closure->fingerprints->pdata[closure->current_index];
-		seahorse_progress_end (closure->cancellable, fingerprint);
-	}
+	sinfo = get_ldap_server_info (self, TRUE);
+	attrs[0] = sinfo->key_attr;
+	attrs[1] = "pgpcertid";
+	attrs[2] = NULL;
+
+	while (g_hash_table_size (closure->batches) < EXPORT_MAX_SEARCHES &&
+	       closure->next_index < closure->fingerprints->len) {
+
+		batch = g_new0 (ExportBatch, 1);
+		batch->fingerprints = g_ptr_array_new ();
+		filter = g_string_new ("(|");
+
+		while (batch->fingerprints->len < EXPORT_BATCH_SIZE &&
+		       closure->next_index < closure->fingerprints->len) {
+			fingerprint = closure->fingerprints->pdata[closure->next_index++];
+			g_ptr_array_add (batch->fingerprints, (gpointer)fingerprint);
+
+			/* Keys searched for again after reconnecting have already begun */
+			if (closure->next_index > closure->num_begun) {
+				seahorse_progress_begin (closure->cancellable, fingerprint);
+				closure->num_begun = closure->next_index;
+			}
+
+			certid = calc_export_certid (fingerprint);
+			g_string_append_printf (filter, "(pgpcertid=%s)", certid);
+			g_hash_table_insert (closure->requested, certid, (gpointer)fingerprint);
+		}
 
-	closure->current_index++;
+		g_string_append_c (filter, ')');
 
-	/* All done, complete operation */
-	if (closure->current_index == (gint)closure->fingerprints->len) {
-		g_simple_async_result_complete (res);
-		return;
-	}
+		rc = ldap_search_ext (closure->ldap, sinfo->base_dn, LDAP_SCOPE_SUBTREE,
+		                      filter->str, attrs, 0,
+		                      NULL, NULL, NULL, 0, &batch->ldap_op);
+		g_string_free (filter, TRUE);
 
-	fingerprint = closure->fingerprints->pdata[closure->current_index];
-	seahorse_progress_begin (closure->cancellable, fingerprint);
-	length = strlen (fingerprint);
-	if (length > 16)
-		fingerprint += (length - 16);
+		if (seahorse_ldap_source_propagate_error (self, rc, &error)) {
+			export_batch_free (batch);
+			export_complete (res, error);
+			return FALSE;
+		}
 
-	filter = g_strdup_printf ("(pgpcertid=%.16s)", fingerprint);
-	sinfo = get_ldap_server_info (self, TRUE);
+		g_hash_table_insert (closure->batches, GINT_TO_POINTER (batch->ldap_op), batch);
+	}
 
-	attrs[0] = sinfo->key_attr;
-	attrs[1] = NULL;
+	/* All done, complete operation */
+	if (g_hash_table_size (closure->batches) == 0) {
+		export_complete (res, NULL);
+		return FALSE;
+	}
 
-	rc = ldap_search_ext (closure->ldap, sinfo->base_dn, LDAP_SCOPE_SUBTREE,
-	                      filter, attrs, 0,
-	                      NULL, NULL, NULL, 0, &ldap_op);
-	g_free (filter);
+	return TRUE;
+}
 
-	if (seahorse_ldap_source_propagate_error (self, rc, &error)) {
-		g_simple_async_result_take_error (res, error);
-		g_simple_async_result_complete (res);
+static void
+export_start (GSimpleAsyncResult *res)
+{
+	ExportClosure *closure = g_simple_async_result_get_op_res_gpointer (res);
+	GSource *gsource;
+
+	if (!export_retrieve_keys (res))
 		return;
-	}
 
-	gsource = seahorse_ldap_gsource_new (closure->ldap, ldap_op,
+	/* One source for the results of all the searches */
+	gsource = seahorse_ldap_gsource_new (closure->ldap, LDAP_RES_ANY,
 	                                     closure->cancellable);
 	g_source_set_callback (gsource, (GSourceFunc)on_export_search_completed,
 	                       g_object_ref (res), g_object_unref);
@@ -1346,12 +2002,12 @@ on_export_connect_completed (GObject *source,
 	GError *error = NULL;
 
 	closure->ldap = seahorse_ldap_source_connect_finish (SEAHORSE_LDAP_SOURCE (source),
-	                                                     result, &error);
+	                                                     result, &closure->reused, &error);
 	if (error != NULL) {
 		g_simple_async_result_take_error (res, error);
 		g_simple_async_result_complete (res);
 	} else {
-		export_retrieve_key (SEAHORSE_LDAP_SOURCE (source), res);
+		export_start (res);
 	}
 
 	g_object_unref (res);
@@ -1373,15 +2029,20 @@ seahorse_ldap_source_export_async (SeahorseServerSource *source,
 	res = g_simple_async_result_new (G_OBJECT (self), callback, user_data,
 	                                 seahorse_ldap_source_export_async);
 	closure = g_new0 (ExportClosure, 1);
+	closure->source = g_object_ref (self);
 	closure->data = g_string_sized_new (1024);
 	closure->cancellable = cancellable ? g_object_ref (cancellable) : NULL;
 	closure->fingerprints = g_ptr_array_new_with_free_func (g_free);
+	closure->requested = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	closure->found = g_hash_table_new (g_direct_hash, g_direct_equal);
+	closure->missing = g_ptr_array_new ();
+	closure->batches = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+	                                          NULL, export_batch_free);
 	for (i = 0; keyids[i] != NULL; i++) {
 		fingerprint = g_strdup (keyids[i]);
 		g_ptr_array_add (closure->fingerprints, fingerprint);
 		seahorse_progress_prep (closure->cancellable, fingerprint, NULL);
 	}
-	closure->current_index = -1;
 	g_simple_async_result_set_op_res_gpointer (res, closure, export_closure_free);
 
 	seahorse_ldap_source_connect_async (self, cancellable,
@@ -1414,12 +2075,46 @@ seahorse_ldap_source_export_finish (SeahorseServerSource *source,
 	return output;
 }
 
+/**
+ * seahorse_ldap_source_export_get_missing
+ * @self: The LDAP source the keys were exported from
+ * @result: The result of the export
+ *
+ * Lists the keys that were asked for, but that the server said it
+ * doesn't have. This works whether the export succeeded with some of
+ * the keys, or failed with %G_IO_ERROR_NOT_FOUND for all of them.
+ *
+ * Returns: (transfer full): The missing fingerprints or key ids, as
+ *          they were passed to the export. Free with g_strfreev().
+ */
+gchar **
+seahorse_ldap_source_export_get_missing (SeahorseLDAPSource *self,
+                                         GAsyncResult *result)
+{
+	ExportClosure *closure;
+	gchar **missing;
+	guint i;
+
+	g_return_val_if_fail (SEAHORSE_IS_LDAP_SOURCE (self), NULL);
+	g_return_val_if_fail (g_simple_async_result_is_valid (result, G_OBJECT (self),
+	                      seahorse_ldap_source_export_async), NULL);
+
+	closure = g_simple_async_result_get_op_res_gpointer (G_SIMPLE_ASYNC_RESULT (result));
+	missing = g_new0 (gchar *, closure->missing->len + 1);
+	for (i = 0; i < closure->missing->len; i++)
+		missing[i] = g_strdup (closure->missing->pdata[i]);
+	return missing;
+}
+
 /* Initialize the basic class stuff */
 static void
 seahorse_ldap_source_class_init (SeahorseLDAPSourceClass *klass)
 {
+	GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
 	SeahorseServerSourceClass *server_class = SEAHORSE_SERVER_SOURCE_CLASS (klass);
 
+	gobject_class->finalize = seahorse_ldap_source_finalize;
+
 	server_class->search_async = seahorse_ldap_source_search_async;
 	server_class->search_finish = seahorse_ldap_source_search_finish;
 	server_class->export_async = seahorse_ldap_source_export_async;
@@ -45,6 +45,7 @@ struct _SeahorseLDAPSource {
     SeahorseServerSource parent;
 
     /*< private >*/
+    GQueue *connections;
 };
 
 struct _SeahorseLDAPSourceClass {
@@ -58,6 +59,9 @@ SeahorseLDAPSource*   seahorse_ldap_source_new     (const gchar *uri,
 
 gboolean              seahorse_ldap_is_valid_uri   (const gchar *uri);
 
+gchar **              seahorse_ldap_source_export_get_missing (SeahorseLDAPSource *self,
+                                                               GAsyncResult *result);
+
 #endif /* WITH_LDAP */
 
 #endif /* __SEAHORSE_SERVER_SOURCE_H__ */
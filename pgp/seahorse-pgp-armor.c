@@ -0,0 +1,481 @@
+/*
+ * Seahorse
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "seahorse-pgp-armor.h"
+
+#include <string.h>
+
+/**
+ * SECTION:seahorse-pgp-armor
+ * @short_description: Armor and packet helpers for OpenPGP key data
+ * @include:seahorse-pgp-armor.h
+ *
+ * See: http://tools.ietf.org/html/rfc4880
+ **/
+
+#define CRC24_INIT 0xB704CEL
+#define CRC24_POLY 0x1864CFBL
+
+#define PGP_PACKET_SECRET_KEY   5
+#define PGP_PACKET_PUBLIC_KEY   6
+
+static guint32
+calc_crc24 (const guchar *data,
+            gsize n_data)
+{
+	guint32 crc = CRC24_INIT;
+	gint i;
+
+	while (n_data--) {
+		crc ^= (*data++) << 16;
+		for (i = 0; i < 8; i++) {
+			crc <<= 1;
+			if (crc & 0x1000000)
+				crc ^= CRC24_POLY;
+		}
+	}
+
+	return crc & 0xFFFFFFL;
+}
+
+static gboolean
+check_crc24 (const guchar *data,
+             gsize n_data,
+             const gchar *crc_text)
+{
+	guchar *crc;
+	gsize n_crc;
+	guint32 value;
+	gboolean ret;
+
+	crc = g_base64_decode (crc_text, &n_crc);
+	if (n_crc != 3) {
+		g_free (crc);
+		return FALSE;
+	}
+
+	value = calc_crc24 (data, n_data);
+	ret = crc[0] == ((value >> 16) & 0xFF) &&
+	      crc[1] == ((value >> 8) & 0xFF) &&
+	      crc[2] == (value & 0xFF);
+
+	g_free (crc);
+	return ret;
+}
+
+/**
+ * seahorse_pgp_armor_decode:
+ * @text: Text containing an ASCII armored block
+ * @n_text: Length of @text
+ * @n_data: Returns the length of the decoded data
+ *
+ * Decodes the first armored block found in @text. The armor checksum is
+ * verified when present.
+ *
+ * Returns: The binary data, free with g_free(), or NULL if no valid
+ *          block was found.
+ */
+guchar *
+seahorse_pgp_armor_decode (const gchar *text,
+                           gsize n_text,
+                           gsize *n_data)
+{
+	const gchar *at, *end, *eol;
+	gboolean headers = TRUE;
+	gboolean complete = FALSE;
+	gchar *crc_text = NULL;
+	guchar *data;
+	guint save = 0;
+	gint state = 0;
+	gsize n_line;
+	gsize len = 0;
+
+	g_return_val_if_fail (text != NULL, NULL);
+	g_return_val_if_fail (n_data != NULL, NULL);
+
+	end = text + n_text;
+	at = g_strstr_len (text, n_text, "-----BEGIN ");
+	if (at == NULL)
+		return NULL;
+
+	/* Skip over the begin line */
+	at = memchr (at, '\n', end - at);
+	if (at == NULL)
+		return NULL;
+	at++;
+
+	data = g_malloc (((n_text / 4) + 1) * 3);
+
+	for (; at < end; at = eol + 1) {
+		eol = memchr (at, '\n', end - at);
+		if (eol == NULL)
+			eol = end;
+
+		n_line = eol - at;
+		while (n_line > 0 && g_ascii_isspace (at[n_line - 1]))
+			n_line--;
+
+		/* The end line */
+		if (n_line >= 5 && strncmp (at, "-----", 5) == 0) {
+			complete = TRUE;
+			break;
+		}
+
+		/* Armor headers, up to the first blank line */
+		if (headers) {
+			if (n_line == 0) {
+				headers = FALSE;
+				continue;
+			}
+			if (memchr (at, ':', n_line))
+				continue;
+			headers = FALSE;
+		}
+
+		if (n_line == 0)
+			continue;
+
+		if (at[0] == '=') {
+			g_free (crc_text);
+			crc_text = g_strndup (at + 1, n_line - 1);
+			continue;
+		}
+
+		len += g_base64_decode_step (at, n_line, data + len, &state, &save);
+	}
+
+	if (!complete || len == 0 ||
+	    (crc_text != NULL && !check_crc24 (data, len, crc_text))) {
+		g_free (crc_text);
+		g_free (data);
+		return NULL;
+	}
+
+	g_free (crc_text);
+	*n_data = len;
+	return data;
+}
+
+/**
+ * seahorse_pgp_armor_append:
+ * @output: The string to append to
+ * @data: Binary OpenPGP public key data
+ * @n_data: Length of @data
+ *
+ * Appends @data to @output as an ASCII armored public key block.
+ */
+void
+seahorse_pgp_armor_append (GString *output,
+                           const guchar *data,
+                           gsize n_data)
+{
+	guchar crc[3];
+	gchar *encoded;
+	guint32 value;
+	gsize i, len;
+
+	g_return_if_fail (output != NULL);
+	g_return_if_fail (data != NULL || n_data == 0);
+
+	g_string_append (output, SEAHORSE_PGP_KEY_BEGIN "\n\n");
+
+	encoded = g_base64_encode (data, n_data);
+	len = strlen (encoded);
+	for (i = 0; i < len; i += 64) {
+		g_string_append_len (output, encoded + i, MIN (64, len - i));
+		g_string_append_c (output, '\n');
+	}
+	g_free (encoded);
+
+	value = calc_crc24 (data, n_data);
+	crc[0] = (value >> 16) & 0xFF;
+	crc[1] = (value >> 8) & 0xFF;
+	crc[2] = value & 0xFF;
+	encoded = g_base64_encode (crc, sizeof (crc));
+	g_string_append_printf (output, "=%s\n", encoded);
+	g_free (encoded);
+
+	g_string_append (output, SEAHORSE_PGP_KEY_END "\n");
+}
+
+static gboolean
+read_packet_header (const guchar *data,
+                    gsize n_data,
+                    guint *tag,
+                    gsize *n_header,
+                    gsize *n_body)
+{
+	guchar ctb;
+
+	if (n_data < 2)
+		return FALSE;
+
+	ctb = data[0];
+	if (!(ctb & 0x80))
+		return FALSE;
+
+	/* New format packet */
+	if (ctb & 0x40) {
+		*tag = ctb & 0x3F;
+		if (data[1] < 192) {
+			*n_header = 2;
+			*n_body = data[1];
+		} else if (data[1] < 224) {
+			if (n_data < 3)
+				return FALSE;
+			*n_header = 3;
+			*n_body = ((data[1] - 192) << 8) + data[2] + 192;
+		} else if (data[1] == 255) {
+			if (n_data < 6)
+				return FALSE;
+			*n_header = 6;
+			*n_body = ((gsize)data[2] << 24) | (data[3] << 16) |
+			          (data[4] << 8) | data[5];
+		} else {
+			/* Partial body lengths never occur in key material */
+			return FALSE;
+		}
+
+	/* Old format packet */
+	} else {
+		*tag = (ctb >> 2) & 0x0F;
+		switch (ctb & 0x03) {
+		case 0:
+			*n_header = 2;
+			*n_body = data[1];
+			break;
+		case 1:
+			if (n_data < 3)
+				return FALSE;
+			*n_header = 3;
+			*n_body = (data[1] << 8) | data[2];
+			break;
+		case 2:
+			if (n_data < 5)
+				return FALSE;
+			*n_header = 5;
+			*n_body = ((gsize)data[1] << 24) | (data[2] << 16) |
+			          (data[3] << 8) | data[4];
+			break;
+		default:
+			/* Indeterminate length, runs to the end */
+			*n_header = 1;
+			*n_body = n_data - 1;
+			break;
+		}
+	}
+
+	return *n_header + *n_body <= n_data;
+}
+
+/*
+ * v4 fingerprints are the SHA-1 of 0x99, a two octet length and the key
+ * packet body. v5 fingerprints are the SHA-256 of 0x9A, a four octet
+ * length and the body.
+ */
+static gchar *
+calc_fingerprint (const guchar *body,
+                  gsize n_body)
+{
+	GChecksum *checksum;
+	guchar prefix[5];
+	gsize n_prefix;
+	gchar *fingerprint;
+
+	if (n_body < 1)
+		return NULL;
+
+	if (body[0] == 4 && n_body <= 0xFFFF) {
+		checksum = g_checksum_new (G_CHECKSUM_SHA1);
+		prefix[0] = 0x99;
+		prefix[1] = (n_body >> 8) & 0xFF;
+		prefix[2] = n_body & 0xFF;
+		n_prefix = 3;
+
+	} else if (body[0] == 5 && n_body <= G_MAXUINT32) {
+		checksum = g_checksum_new (G_CHECKSUM_SHA256);
+		prefix[0] = 0x9A;
+		prefix[1] = (n_body >> 24) & 0xFF;
+		prefix[2] = (n_body >> 16) & 0xFF;
+		prefix[3] = (n_body >> 8) & 0xFF;
+		prefix[4] = n_body & 0xFF;
+		n_prefix = 5;
+
+	} else {
+		return NULL;
+	}
+
+	g_checksum_update (checksum, prefix, n_prefix);
+	g_checksum_update (checksum, body, n_body);
+	fingerprint = g_ascii_strup (g_checksum_get_string (checksum), -1);
+	g_checksum_free (checksum);
+
+	return fingerprint;
+}
+
+/**
+ * seahorse_pgp_armor_foreach_key:
+ * @data: Binary (dearmored) OpenPGP data
+ * @n_data: Length of @data
+ * @func: Called for each transferable key
+ * @user_data: Passed to @func
+ *
+ * Splits an OpenPGP packet stream into transferable keys, ie: a primary
+ * key packet together with all the packets that follow it up to the
+ * next primary key.
+ *
+ * Returns: FALSE if the packet stream was malformed.
+ */
+gboolean
+seahorse_pgp_armor_foreach_key (const guchar *data,
+                                gsize n_data,
+                                SeahorsePgpKeyFunc func,
+                                gpointer user_data)
+{
+	const guchar *key = NULL;
+	gchar *fingerprint = NULL;
+	gsize n_header, n_body;
+	gsize at = 0;
+	guint tag;
+
+	g_return_val_if_fail (data != NULL || n_data == 0, FALSE);
+	g_return_val_if_fail (func != NULL, FALSE);
+
+	while (at < n_data) {
+		if (!read_packet_header (data + at, n_data - at, &tag, &n_header, &n_body)) {
+			g_free (fingerprint);
+			return FALSE;
+		}
+
+		if (tag == PGP_PACKET_PUBLIC_KEY || tag == PGP_PACKET_SECRET_KEY) {
+			if (key != NULL && !(func) (key, (data + at) - key, fingerprint, user_data)) {
+				g_free (fingerprint);
+				return TRUE;
+			}
+
+			g_free (fingerprint);
+			key = data + at;
+			if (tag == PGP_PACKET_PUBLIC_KEY)
+				fingerprint = calc_fingerprint (data + at + n_header, n_body);
+			else
+				fingerprint = NULL;
+		}
+
+		at += n_header + n_body;
+	}
+
+	if (key != NULL)
+		(func) (key, (data + n_data) - key, fingerprint, user_data);
+
+	g_free (fingerprint);
+	return TRUE;
+}
+
+/**
+ * seahorse_pgp_armor_calc_keyid:
+ * @key: A transferable key, starting with its primary key packet
+ * @n_key: Length of @key
+ *
+ * For keys without a fingerprint we can calculate. The key id of a v3 RSA
+ * key is the low 64 bits of its modulus.
+ *
+ * Returns: The upper case hex key id, or NULL if not a v3 RSA key
+ */
+gchar *
+seahorse_pgp_armor_calc_keyid (const guchar *key,
+                               gsize n_key)
+{
+	const guchar *body;
+	gsize n_header, n_body;
+	gsize n_modulus;
+	guint tag;
+
+	g_return_val_if_fail (key != NULL || n_key == 0, NULL);
+
+	if (!read_packet_header (key, n_key, &tag, &n_header, &n_body))
+		return NULL;
+	if (tag != PGP_PACKET_PUBLIC_KEY && tag != PGP_PACKET_SECRET_KEY)
+		return NULL;
+
+	/* Version, creation time, validity days, algorithm, then the modulus */
+	body = key + n_header;
+	if (n_body < 10 || (body[0] != 2 && body[0] != 3))
+		return NULL;
+	if (body[7] < 1 || body[7] > 3)
+		return NULL;
+
+	n_modulus = (((body[8] << 8) | body[9]) + 7) / 8;
+	if (n_modulus < 8 || 10 + n_modulus > n_body)
+		return NULL;
+
+	return g_strdup_printf ("%02X%02X%02X%02X%02X%02X%02X%02X",
+	                        body[n_modulus + 2], body[n_modulus + 3],
+	                        body[n_modulus + 4], body[n_modulus + 5],
+	                        body[n_modulus + 6], body[n_modulus + 7],
+	                        body[n_modulus + 8], body[n_modulus + 9]);
+}
+
+/**
+ * seahorse_pgp_armor_compact_keyid:
+ * @keyid: A key id or fingerprint, possibly with whitespace
+ *
+ * Returns: The hex digits of @keyid in upper case, free with g_free()
+ */
+gchar *
+seahorse_pgp_armor_compact_keyid (const gchar *keyid)
+{
+	GString *result;
+
+	g_return_val_if_fail (keyid != NULL, NULL);
+
+	/* Allow a leading 0x as keyservers use */
+	if (keyid[0] == '0' && (keyid[1] == 'x' || keyid[1] == 'X'))
+		keyid += 2;
+
+	result = g_string_sized_new (41);
+	for (; *keyid; keyid++) {
+		if (g_ascii_isxdigit (*keyid))
+			g_string_append_c (result, g_ascii_toupper (*keyid));
+	}
+
+	return g_string_free (result, FALSE);
+}
+
+/**
+ * seahorse_pgp_armor_fingerprint_matches:
+ * @fingerprint: A compact upper case fingerprint
+ * @keyid: A compact upper case fingerprint, 64-bit or 32-bit key id
+ *
+ * v4 key ids are the rightmost bits of the fingerprint, v5 key ids the
+ * leftmost.
+ *
+ * Returns: Whether @keyid identifies the key with @fingerprint
+ */
+gboolean
+seahorse_pgp_armor_fingerprint_matches (const gchar *fingerprint,
+                                        const gchar *keyid)
+{
+	if (fingerprint == NULL || keyid == NULL || !keyid[0])
+		return FALSE;
+
+	if (strlen (fingerprint) == 64)
+		return g_str_has_prefix (fingerprint, keyid);
+
+	return g_str_has_suffix (fingerprint, keyid);
+}
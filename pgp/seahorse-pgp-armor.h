@@ -0,0 +1,64 @@
+/*
+ * Seahorse
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * Minimal helpers for dealing with ASCII armored OpenPGP keys without
+ * going through GPGME: decoding and encoding the armor, and walking the
+ * packet stream one transferable key at a time.
+ */
+
+#ifndef __SEAHORSE_PGP_ARMOR_H__
+#define __SEAHORSE_PGP_ARMOR_H__
+
+#include <glib.h>
+
+#define SEAHORSE_PGP_KEY_BEGIN   "-----BEGIN PGP PUBLIC KEY BLOCK-----"
+#define SEAHORSE_PGP_KEY_END     "-----END PGP PUBLIC KEY BLOCK-----"
+
+/*
+ * Called for each transferable key found in a packet stream. The
+ * @fingerprint is the upper case hex fingerprint of the primary key,
+ * or NULL if it could not be calculated (ie: not a v4 or v5 key).
+ * Return FALSE to stop iterating.
+ */
+typedef gboolean (*SeahorsePgpKeyFunc)       (const guchar *key,
+                                              gsize n_key,
+                                              const gchar *fingerprint,
+                                              gpointer user_data);
+
+guchar *        seahorse_pgp_armor_decode          (const gchar *text,
+                                                    gsize n_text,
+                                                    gsize *n_data);
+
+void            seahorse_pgp_armor_append          (GString *output,
+                                                    const guchar *data,
+                                                    gsize n_data);
+
+gboolean        seahorse_pgp_armor_foreach_key     (const guchar *data,
+                                                    gsize n_data,
+                                                    SeahorsePgpKeyFunc func,
+                                                    gpointer user_data);
+
+gchar *         seahorse_pgp_armor_calc_keyid      (const guchar *key,
+                                                    gsize n_key);
+
+gchar *         seahorse_pgp_armor_compact_keyid   (const gchar *keyid);
+
+gboolean        seahorse_pgp_armor_fingerprint_matches (const gchar *fingerprint,
+                                                        const gchar *keyid);
+
+#endif /* __SEAHORSE_PGP_ARMOR_H__ */
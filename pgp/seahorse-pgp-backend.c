@@ -22,7 +22,12 @@
 
 #include "seahorse-gpgme-dialogs.h"
 #include "seahorse-pgp-actions.h"
+#include "seahorse-pgp-armor.h"
 #include "seahorse-pgp-backend.h"
+#include "seahorse-pgp-key.h"
+#include "seahorse-pgp-refresh.h"
+#include "seahorse-pgp-signature.h"
+#include "seahorse-pgp-uid.h"
 #include "seahorse-server-source.h"
 #include "seahorse-transfer.h"
 #include "seahorse-unknown-source.h"
@@ -53,6 +58,14 @@ struct _SeahorsePgpBackend {
 	SeahorseDiscovery *discovery;
 	SeahorseUnknownSource *unknown;
 	GHashTable *remotes;
+	GHashTable *latencies;
+#ifdef WITH_KEYSERVER
+	SeahorsePgpRefresh *refresh;
+	GHashTable *discovering;        /* keyid, being looked up */
+	GHashTable *undiscovered;       /* keyid -> when not found, in seconds */
+	GPtrArray *discover_pending;
+	guint discover_idle;
+#endif
 	GtkActionGroup *actions;
 	gboolean loaded;
 };
@@ -78,6 +91,16 @@ seahorse_pgp_backend_init (SeahorsePgpBackend *self)
 
 	self->remotes = g_hash_table_new_full (g_str_hash, g_str_equal,
 	                                       g_free, g_object_unref);
+	self->latencies = g_hash_table_new_full (g_str_hash, g_str_equal,
+	                                         g_free, g_free);
+#ifdef WITH_KEYSERVER
+	self->discovering = g_hash_table_new_full (seahorse_pgp_keyid_hash,
+	                                           seahorse_pgp_keyid_equal,
+	                                           g_free, NULL);
+	self->undiscovered = g_hash_table_new_full (seahorse_pgp_keyid_hash,
+	                                            seahorse_pgp_keyid_equal,
+	                                            g_free, g_free);
+#endif
 
 	self->actions = seahorse_pgp_backend_actions_instance ();
 
@@ -154,6 +177,11 @@ on_place_loaded (GObject       *object,
 	backend->loaded = TRUE;
 	g_object_notify (G_OBJECT (backend), "loaded");
 
+#ifdef WITH_KEYSERVER
+	if (backend->refresh == NULL)
+		backend->refresh = seahorse_pgp_refresh_new (backend);
+#endif
+
 	g_object_unref (backend);
 }
 
@@ -243,12 +271,20 @@ seahorse_pgp_backend_finalize (GObject *obj)
 #ifdef WITH_KEYSERVER
 	g_signal_handlers_disconnect_by_func (seahorse_pgp_settings_instance (),
 	                                      on_settings_keyservers_changed, self);
+	seahorse_pgp_refresh_free (self->refresh);
+	if (self->discover_idle)
+		g_source_remove (self->discover_idle);
+	if (self->discover_pending)
+		g_ptr_array_free (self->discover_pending, TRUE);
+	g_hash_table_destroy (self->discovering);
+	g_hash_table_destroy (self->undiscovered);
 #endif
 
 	g_clear_object (&self->keyring);
 	g_clear_object (&self->discovery);
 	g_clear_object (&self->unknown);
 	g_hash_table_destroy (self->remotes);
+	g_hash_table_destroy (self->latencies);
 	g_clear_object (&self->actions);
 	pgp_backend = NULL;
 
@@ -425,21 +461,326 @@ seahorse_pgp_backend_remove_remote (SeahorsePgpBackend *self,
 	g_hash_table_remove (self->remotes, uri);
 }
 
+/* A server that failed counts as having taken at least this long */
+#define SEARCH_FAILED_LATENCY    15000
+
+/* Servers much slower than the fastest one are only asked after this delay */
+#define SEARCH_HEDGE_DELAY       1000
+#define SEARCH_DEMOTE_FACTOR     4
+
+typedef struct {
+	SeahorseServerSource *source;
+	gchar *uri;
+	GcrSimpleCollection *results;
+	GCancellable *cancellable;
+	gulong added_sig;
+	gulong truncated_sig;
+	gdouble latency;
+	gint64 started;
+	gboolean running;
+	gboolean demoted;
+} search_remote_server;
+
 typedef struct {
+	SeahorsePgpBackend *backend;
+	gchar *search;
+	GcrSimpleCollection *results;
 	GCancellable *cancellable;
+	gulong cancelled_sig;
+	GPtrArray *servers;
+	GHashTable *seen;
+	guint num_results;
+	guint max_results;
 	gint num_searches;
-	GList *objects;
+	guint timeout_id;
+	guint hedge_id;
+	gboolean completed;
+	gboolean truncated;
+	GError *error;
 } search_remote_closure;
 
+static void
+search_remote_server_free (gpointer data)
+{
+	search_remote_server *server = data;
+	g_signal_handler_disconnect (server->results, server->added_sig);
+	g_signal_handler_disconnect (server->source, server->truncated_sig);
+	g_object_unref (server->source);
+	g_object_unref (server->results);
+	g_object_unref (server->cancellable);
+	g_free (server->uri);
+	g_free (server);
+}
+
 static void
 search_remote_closure_free (gpointer user_data)
 {
 	search_remote_closure *closure = user_data;
+	g_cancellable_disconnect (closure->cancellable, closure->cancelled_sig);
 	g_clear_object (&closure->cancellable);
-	g_list_free (closure->objects);
+	g_ptr_array_free (closure->servers, TRUE);
+	g_hash_table_destroy (closure->seen);
+	g_object_unref (closure->results);
+	g_object_unref (closure->backend);
+	g_clear_error (&closure->error);
+	g_free (closure->search);
 	g_free (closure);
 }
 
+static gint
+compare_server_latency (gconstpointer a,
+                        gconstpointer b)
+{
+	const search_remote_server *sa = *((search_remote_server **)a);
+	const search_remote_server *sb = *((search_remote_server **)b);
+
+	if (sa->latency < sb->latency)
+		return -1;
+	if (sa->latency > sb->latency)
+		return 1;
+	return 0;
+}
+
+/* An exponentially weighted average of the time taken by each server */
+static void
+record_server_latency (SeahorsePgpBackend *self,
+                       const gchar *uri,
+                       gdouble latency,
+                       gboolean lower_bound)
+{
+	gdouble *value;
+
+	value = g_hash_table_lookup (self->latencies, uri);
+	if (value == NULL) {
+		value = g_new (gdouble, 1);
+		*value = latency;
+		g_hash_table_insert (self->latencies, g_strdup (uri), value);
+	} else if (!lower_bound || latency > *value) {
+		*value = (*value * 0.7) + (latency * 0.3);
+	}
+
+	g_debug ("key server %s: %.0f ms average", uri, *value);
+}
+
+static gchar *
+calc_uid_label (SeahorsePgpUid *uid)
+{
+	return seahorse_pgp_uid_calc_label (seahorse_pgp_uid_get_name (uid),
+	                                    seahorse_pgp_uid_get_email (uid),
+	                                    seahorse_pgp_uid_get_comment (uid));
+}
+
+static void
+merge_uid_signatures (SeahorsePgpUid *uid,
+                      SeahorsePgpUid *other)
+{
+	GList *signatures, *l, *k;
+	const gchar *keyid;
+	gboolean changed = FALSE;
+
+	signatures = g_list_copy (seahorse_pgp_uid_get_signatures (uid));
+	for (l = seahorse_pgp_uid_get_signatures (other); l != NULL; l = g_list_next (l)) {
+		keyid = seahorse_pgp_signature_get_keyid (l->data);
+		for (k = signatures; k != NULL; k = g_list_next (k)) {
+			if (seahorse_pgp_keyid_equal (keyid, seahorse_pgp_signature_get_keyid (k->data)))
+				break;
+		}
+		if (k == NULL) {
+			signatures = g_list_append (signatures, l->data);
+			changed = TRUE;
+		}
+	}
+
+	if (changed)
+		seahorse_pgp_uid_set_signatures (uid, signatures);
+	g_list_free (signatures);
+}
+
+/* Add the user ids and signatures that only @other knows about to @key */
+static void
+merge_remote_key (SeahorsePgpKey *key,
+                  SeahorsePgpKey *other)
+{
+	GHashTable *labels;
+	SeahorsePgpUid *uid;
+	GList *created = NULL;
+	GList *uids, *l;
+	gchar *label;
+
+	labels = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	uids = g_list_copy (seahorse_pgp_key_get_uids (key));
+	for (l = uids; l != NULL; l = g_list_next (l))
+		g_hash_table_insert (labels, calc_uid_label (l->data), l->data);
+
+	for (l = seahorse_pgp_key_get_uids (other); l != NULL; l = g_list_next (l)) {
+		label = calc_uid_label (l->data);
+		uid = g_hash_table_lookup (labels, label);
+		if (uid != NULL) {
+			merge_uid_signatures (uid, l->data);
+			g_free (label);
+		} else {
+			uid = seahorse_pgp_uid_new (key, NULL);
+			seahorse_pgp_uid_set_name (uid, seahorse_pgp_uid_get_name (l->data));
+			seahorse_pgp_uid_set_email (uid, seahorse_pgp_uid_get_email (l->data));
+			seahorse_pgp_uid_set_comment (uid, seahorse_pgp_uid_get_comment (l->data));
+			seahorse_pgp_uid_set_validity (uid, seahorse_pgp_uid_get_validity (l->data));
+			seahorse_pgp_uid_set_signatures (uid, seahorse_pgp_uid_get_signatures (l->data));
+			g_hash_table_insert (labels, label, uid);
+			uids = g_list_append (uids, uid);
+			created = g_list_prepend (created, uid);
+		}
+	}
+
+	if (created != NULL)
+		seahorse_pgp_key_set_uids (key, uids);
+
+	g_list_free_full (created, g_object_unref);
+	g_list_free (uids);
+	g_hash_table_destroy (labels);
+}
+
+static void
+search_remote_complete (GSimpleAsyncResult *res)
+{
+	search_remote_closure *closure = g_simple_async_result_get_op_res_gpointer (res);
+	search_remote_server *server;
+	gint64 now;
+	guint i;
+
+	if (closure->completed)
+		return;
+	closure->completed = TRUE;
+
+	if (closure->timeout_id)
+		g_source_remove (closure->timeout_id);
+	closure->timeout_id = 0;
+	if (closure->hedge_id)
+		g_source_remove (closure->hedge_id);
+	closure->hedge_id = 0;
+
+	/* Give up on the servers that are still going */
+	now = g_get_monotonic_time ();
+	for (i = 0; i < closure->servers->len; i++) {
+		server = closure->servers->pdata[i];
+		if (!server->started)
+			closure->truncated = TRUE;
+		if (!server->running)
+			continue;
+		closure->truncated = TRUE;
+		if (!g_cancellable_is_cancelled (closure->cancellable))
+			record_server_latency (closure->backend, server->uri,
+			                       (now - server->started) / 1000.0, TRUE);
+		g_cancellable_cancel (server->cancellable);
+	}
+
+	/* Only fail if nothing at all was found */
+	if (closure->error != NULL && closure->num_results == 0) {
+		g_simple_async_result_take_error (res, closure->error);
+		closure->error = NULL;
+	}
+
+	g_simple_async_result_complete_in_idle (res);
+}
+
+static void
+on_server_results_added (GcrCollection *collection,
+                         GObject *object,
+                         gpointer user_data)
+{
+	GSimpleAsyncResult *res = G_SIMPLE_ASYNC_RESULT (user_data);
+	search_remote_closure *closure = g_simple_async_result_get_op_res_gpointer (res);
+	SeahorsePgpKey *key;
+	SeahorsePgpKey *previous;
+	const gchar *identifier;
+
+	if (closure->completed || !SEAHORSE_IS_PGP_KEY (object))
+		return;
+
+	key = SEAHORSE_PGP_KEY (object);
+	identifier = seahorse_pgp_key_get_fingerprint (key);
+	if (identifier == NULL || !identifier[0])
+		identifier = seahorse_pgp_key_get_keyid (key);
+	if (identifier == NULL)
+		return;
+
+	/* The same key from another server */
+	previous = g_hash_table_lookup (closure->seen, identifier);
+	if (previous != NULL) {
+		merge_remote_key (previous, key);
+		return;
+	}
+
+	g_hash_table_insert (closure->seen, g_strdup (identifier), key);
+	gcr_simple_collection_add (closure->results, object);
+	closure->num_results++;
+
+	if (closure->max_results > 0 && closure->num_results >= closure->max_results)
+		search_remote_complete (res);
+}
+
+static void
+on_server_search_truncated (SeahorseServerSource *source,
+                            const gchar *match,
+                            gpointer user_data)
+{
+	GSimpleAsyncResult *res = G_SIMPLE_ASYNC_RESULT (user_data);
+	search_remote_closure *closure = g_simple_async_result_get_op_res_gpointer (res);
+
+	if (g_strcmp0 (match, closure->search) == 0)
+		closure->truncated = TRUE;
+}
+
+static void
+on_source_search_ready (GObject *source,
+                        GAsyncResult *result,
+                        gpointer user_data);
+
+static void
+search_remote_start (GSimpleAsyncResult *res,
+                     gboolean demoted)
+{
+	search_remote_closure *closure = g_simple_async_result_get_op_res_gpointer (res);
+	search_remote_server *server;
+	guint i;
+
+	for (i = 0; i < closure->servers->len; i++) {
+		server = closure->servers->pdata[i];
+		if (server->started || server->demoted != demoted)
+			continue;
+
+		server->started = g_get_monotonic_time ();
+		server->running = TRUE;
+
+		seahorse_progress_prep_and_begin (closure->cancellable, server, NULL);
+		seahorse_server_source_search_async (server->source, closure->search,
+		                                     server->results, server->cancellable,
+		                                     on_source_search_ready, g_object_ref (res));
+		closure->num_searches++;
+	}
+}
+
+static gboolean
+on_search_hedge_timeout (gpointer user_data)
+{
+	GSimpleAsyncResult *res = G_SIMPLE_ASYNC_RESULT (user_data);
+	search_remote_closure *closure = g_simple_async_result_get_op_res_gpointer (res);
+
+	closure->hedge_id = 0;
+	search_remote_start (res, TRUE);
+	return FALSE;
+}
+
+static gboolean
+on_search_remote_timeout (gpointer user_data)
+{
+	GSimpleAsyncResult *res = G_SIMPLE_ASYNC_RESULT (user_data);
+	search_remote_closure *closure = g_simple_async_result_get_op_res_gpointer (res);
+
+	closure->timeout_id = 0;
+	search_remote_complete (res);
+	return FALSE;
+}
+
 static void
 on_source_search_ready (GObject *source,
                         GAsyncResult *result,
@@ -447,42 +788,112 @@ on_source_search_ready (GObject *source,
 {
 	GSimpleAsyncResult *res = G_SIMPLE_ASYNC_RESULT (user_data);
 	search_remote_closure *closure = g_simple_async_result_get_op_res_gpointer (res);
+	search_remote_server *server = NULL;
 	GError *error = NULL;
+	gint64 elapsed;
+	guint i;
 
 	g_return_if_fail (closure->num_searches > 0);
 
-	if (!seahorse_server_source_search_finish (SEAHORSE_SERVER_SOURCE (source),
-	                                           result, &error))
-		g_simple_async_result_take_error (res, error);
+	for (i = 0; i < closure->servers->len; i++) {
+		server = closure->servers->pdata[i];
+		if (server->source == SEAHORSE_SERVER_SOURCE (source) && server->running)
+			break;
+	}
+	g_return_if_fail (i < closure->servers->len);
+
+	seahorse_server_source_search_finish (SEAHORSE_SERVER_SOURCE (source), result, &error);
+
+	if (!closure->completed) {
+		elapsed = g_get_monotonic_time () - server->started;
+
+		/* A failed server counts as one that never answered */
+		if (error != NULL)
+			elapsed = MAX (elapsed, (gint64)SEARCH_FAILED_LATENCY * 1000);
+		if (!g_cancellable_is_cancelled (closure->cancellable))
+			record_server_latency (closure->backend, server->uri, elapsed / 1000.0, FALSE);
+
+		if (error != NULL && closure->error == NULL)
+			closure->error = g_error_copy (error);
+	}
 
+	g_clear_error (&error);
+	server->running = FALSE;
 	closure->num_searches--;
-	seahorse_progress_end (closure->cancellable, GINT_TO_POINTER (closure->num_searches));
+	seahorse_progress_end (closure->cancellable, server);
+
+	if (closure->num_searches == 0) {
+		/* Don't wait for the hedge when nobody else is left */
+		if (closure->hedge_id && !closure->completed) {
+			g_source_remove (closure->hedge_id);
+			closure->hedge_id = 0;
+			search_remote_start (res, TRUE);
+		}
 
-	if (closure->num_searches == 0)
-		g_simple_async_result_complete (res);
+		if (closure->num_searches == 0)
+			search_remote_complete (res);
+	}
 
 	g_object_unref (user_data);
 }
 
+static void
+on_search_remote_cancelled (GCancellable *cancellable,
+                            gpointer user_data)
+{
+	search_remote_closure *closure = user_data;
+	guint i;
+
+	for (i = 0; i < closure->servers->len; i++)
+		g_cancellable_cancel (((search_remote_server *)closure->servers->pdata[i])->cancellable);
+}
+
+/**
+ * seahorse_pgp_backend_search_remote_full_async:
+ * @self: The backend, or NULL for the default
+ * @search: The text to search for
+ * @results: The collection to add the keys found to
+ * @max_results: Complete once this many keys were found, or zero
+ * @timeout: Complete after this many milliseconds, or zero
+ * @cancellable: Optional cancellation object
+ * @callback: Called when the search is complete
+ * @user_data: Passed to @callback
+ *
+ * Searches the selected key servers at the same time. Keys are added to
+ * @results as each server returns them, and a key returned by several
+ * servers is only added once, with the user ids from all of them.
+ *
+ * Servers that were much slower than the others in the past are only
+ * asked if the faster ones don't come through quickly. Servers still
+ * busy when the search completes are cancelled.
+ */
 void
-seahorse_pgp_backend_search_remote_async (SeahorsePgpBackend *self,
-                                          const gchar *search,
-                                          GcrSimpleCollection *results,
-                                          GCancellable *cancellable,
-                                          GAsyncReadyCallback callback,
-                                          gpointer user_data)
+seahorse_pgp_backend_search_remote_full_async (SeahorsePgpBackend *self,
+                                               const gchar *search,
+                                               GcrSimpleCollection *results,
+                                               guint max_results,
+                                               guint timeout,
+                                               GCancellable *cancellable,
+                                               GAsyncReadyCallback callback,
+                                               gpointer user_data)
 {
 	search_remote_closure *closure;
-	GSimpleAsyncResult *res;
+	search_remote_server *server;
 	SeahorseServerSource *source;
+	GSimpleAsyncResult *res;
 	GHashTable *servers = NULL;
 	GHashTableIter iter;
+	gdouble *latency;
+	gdouble fastest = 0;
+	gboolean demoted = FALSE;
 	gchar **names;
 	gchar *uri;
 	guint i;
 
 	self = self ? self : seahorse_pgp_backend_get ();
 	g_return_if_fail (SEAHORSE_IS_PGP_BACKEND (self));
+	g_return_if_fail (search != NULL);
+	g_return_if_fail (GCR_IS_SIMPLE_COLLECTION (results));
 
 	/* Get a list of all selected key servers */
 	names = g_settings_get_strv (seahorse_app_settings_instance (), "last-search-servers");
@@ -496,6 +907,12 @@ seahorse_pgp_backend_search_remote_async (SeahorsePgpBackend *self,
 	res = g_simple_async_result_new (G_OBJECT (self), callback, user_data,
 	                                 seahorse_pgp_backend_search_remote_async);
 	closure = g_new0 (search_remote_closure, 1);
+	closure->backend = g_object_ref (self);
+	closure->search = g_strdup (search);
+	closure->results = g_object_ref (results);
+	closure->max_results = max_results;
+	closure->servers = g_ptr_array_new_with_free_func (search_remote_server_free);
+	closure->seen = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
 	g_simple_async_result_set_op_res_gpointer (res, closure,
 	                                           search_remote_closure_free);
 	if (cancellable)
@@ -503,30 +920,82 @@ seahorse_pgp_backend_search_remote_async (SeahorsePgpBackend *self,
 
 	g_hash_table_iter_init (&iter, self->remotes);
 	while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&source)) {
-		if (servers) {
-			g_object_get (source, "uri", &uri, NULL);
-			if (!g_hash_table_lookup (servers, uri)) {
-				g_free (uri);
-				continue;
-			}
+		g_object_get (source, "uri", &uri, NULL);
+		if (servers && !g_hash_table_lookup (servers, uri)) {
 			g_free (uri);
+			continue;
 		}
 
-		seahorse_progress_prep_and_begin (closure->cancellable, GINT_TO_POINTER (closure->num_searches), NULL);
-		seahorse_server_source_search_async (source, search, results, closure->cancellable,
-		                                     on_source_search_ready, g_object_ref (res));
-		closure->num_searches++;
+		server = g_new0 (search_remote_server, 1);
+		server->source = g_object_ref (source);
+		server->uri = uri;
+		server->results = gcr_simple_collection_new ();
+		server->cancellable = g_cancellable_new ();
+		server->added_sig = g_signal_connect (server->results, "added",
+		                                      G_CALLBACK (on_server_results_added), res);
+		server->truncated_sig = g_signal_connect (source, "search-truncated",
+		                                          G_CALLBACK (on_server_search_truncated), res);
+
+		latency = g_hash_table_lookup (self->latencies, uri);
+		server->latency = latency ? *latency : 0;
+		g_ptr_array_add (closure->servers, server);
 	}
 
 	if (servers)
 		g_hash_table_unref (servers);
 
-	if (closure->num_searches == 0)
-		g_simple_async_result_complete_in_idle (res);
+	/* Fastest servers first, and hold back the really slow ones */
+	g_ptr_array_sort (closure->servers, compare_server_latency);
+	for (i = 0; i < closure->servers->len; i++) {
+		server = closure->servers->pdata[i];
+		if (i == 0) {
+			fastest = server->latency;
+		} else if (server->latency > SEARCH_HEDGE_DELAY &&
+		           server->latency > fastest * SEARCH_DEMOTE_FACTOR) {
+			server->demoted = TRUE;
+			demoted = TRUE;
+		}
+	}
+
+	if (closure->cancellable)
+		closure->cancelled_sig = g_cancellable_connect (closure->cancellable,
+		                                                G_CALLBACK (on_search_remote_cancelled),
+		                                                closure, NULL);
+
+	search_remote_start (res, FALSE);
+
+	if (closure->num_searches == 0) {
+		search_remote_complete (res);
+	} else {
+		if (demoted)
+			closure->hedge_id = g_timeout_add_full (G_PRIORITY_DEFAULT, SEARCH_HEDGE_DELAY,
+			                                        on_search_hedge_timeout,
+			                                        g_object_ref (res), g_object_unref);
+		if (timeout > 0)
+			closure->timeout_id = g_timeout_add_full (G_PRIORITY_DEFAULT, timeout,
+			                                          on_search_remote_timeout,
+			                                          g_object_ref (res), g_object_unref);
+	}
 
 	g_object_unref (res);
 }
 
+/*
+ * Like seahorse_pgp_backend_search_remote_full_async(), waiting for every
+ * server to answer.
+ */
+void
+seahorse_pgp_backend_search_remote_async (SeahorsePgpBackend *self,
+                                          const gchar *search,
+                                          GcrSimpleCollection *results,
+                                          GCancellable *cancellable,
+                                          GAsyncReadyCallback callback,
+                                          gpointer user_data)
+{
+	seahorse_pgp_backend_search_remote_full_async (self, search, results, 0, 0,
+	                                               cancellable, callback, user_data);
+}
+
 gboolean
 seahorse_pgp_backend_search_remote_finish (SeahorsePgpBackend *self,
                                            GAsyncResult *result,
@@ -547,6 +1016,29 @@ seahorse_pgp_backend_search_remote_finish (SeahorsePgpBackend *self,
 	return TRUE;
 }
 
+/**
+ * seahorse_pgp_backend_search_remote_truncated:
+ * @self: The backend, or NULL for the default
+ * @result: The result of a completed search
+ *
+ * Returns: Whether more keys match the search than were found, because
+ *          a server limited its results or was given up on.
+ */
+gboolean
+seahorse_pgp_backend_search_remote_truncated (SeahorsePgpBackend *self,
+                                              GAsyncResult *result)
+{
+	search_remote_closure *closure;
+
+	self = self ? self : seahorse_pgp_backend_get ();
+	g_return_val_if_fail (SEAHORSE_IS_PGP_BACKEND (self), FALSE);
+	g_return_val_if_fail (g_simple_async_result_is_valid (result, G_OBJECT (self),
+	                      seahorse_pgp_backend_search_remote_async), FALSE);
+
+	closure = g_simple_async_result_get_op_res_gpointer (G_SIMPLE_ASYNC_RESULT (result));
+	return closure->truncated;
+}
+
 typedef struct {
 	GCancellable *cancellable;
 	gint num_transfers;
@@ -666,23 +1158,396 @@ seahorse_pgp_backend_transfer_finish (SeahorsePgpBackend *self,
 	return TRUE;
 }
 
-void
-seahorse_pgp_backend_retrieve_async (SeahorsePgpBackend *self,
-                                     const gchar **keyids,
-                                     SeahorsePlace *to,
-                                     GCancellable *cancellable,
-                                     GAsyncReadyCallback callback,
-                                     gpointer user_data)
+/* A server that hasn't returned the keys by then is joined by the next one */
+#define RETRIEVE_HEDGE_DELAY     2000
+
+typedef struct {
+	SeahorseServerSource *source;
+	gchar *uri;
+	gdouble latency;
+	gint64 started;
+	GPtrArray *asked;               /* Compact keyids asked of this server */
+} retrieve_server;
+
+typedef struct {
+	SeahorsePgpBackend *backend;
+	SeahorsePlace *to;
+	GCancellable *cancellable;
+	gulong cancelled_sig;
+	GCancellable *exports;          /* Cancelled once every key is found */
+	GPtrArray *servers;             /* Fastest first */
+	guint next_server;
+	gint num_exports;
+	guint hedge_id;
+	GHashTable *wanted;             /* Compact keyids not found yet */
+	GHashTable *found;              /* Fingerprints (or key ids) of the keys in data */
+	GHashTable *missing;            /* Compact keyids a server answered it doesn't have */
+	GByteArray *data;
+	GError *error;
+} retrieve_closure;
+
+static void
+retrieve_server_free (gpointer data)
+{
+	retrieve_server *server = data;
+	g_object_unref (server->source);
+	g_free (server->uri);
+	if (server->asked)
+		g_ptr_array_free (server->asked, TRUE);
+	g_free (server);
+}
+
+static void
+retrieve_closure_free (gpointer user_data)
+{
+	retrieve_closure *closure = user_data;
+	g_cancellable_disconnect (closure->cancellable, closure->cancelled_sig);
+	g_clear_object (&closure->cancellable);
+	g_object_unref (closure->exports);
+	g_object_unref (closure->backend);
+	g_object_unref (closure->to);
+	g_ptr_array_free (closure->servers, TRUE);
+	g_hash_table_destroy (closure->wanted);
+	g_hash_table_destroy (closure->found);
+	g_hash_table_destroy (closure->missing);
+	g_byte_array_unref (closure->data);
+	g_clear_error (&closure->error);
+	if (closure->hedge_id)
+		g_source_remove (closure->hedge_id);
+	g_free (closure);
+}
+
+static gint
+compare_retrieve_latency (gconstpointer a,
+                          gconstpointer b)
+{
+	const retrieve_server *sa = *((retrieve_server **)a);
+	const retrieve_server *sb = *((retrieve_server **)b);
+
+	if (sa->latency < sb->latency)
+		return -1;
+	if (sa->latency > sb->latency)
+		return 1;
+	return 0;
+}
+
+static gboolean
+remove_matching_keyid (gpointer key,
+                       gpointer value,
+                       gpointer user_data)
+{
+	return seahorse_pgp_armor_fingerprint_matches (user_data, key);
+}
+
+static gboolean
+on_retrieve_key (const guchar *key,
+                 gsize n_key,
+                 const gchar *fingerprint,
+                 gpointer user_data)
+{
+	retrieve_closure *closure = user_data;
+	gchar *keyid = NULL;
+
+	/* Older keys can still be matched against key ids asked for */
+	if (fingerprint == NULL)
+		fingerprint = keyid = seahorse_pgp_armor_calc_keyid (key, n_key);
+
+	/* Already have this one from a faster server */
+	if (fingerprint != NULL) {
+		if (g_hash_table_contains (closure->found, fingerprint)) {
+			g_free (keyid);
+			return TRUE;
+		}
+		g_hash_table_add (closure->found, g_strdup (fingerprint));
+		g_hash_table_foreach_remove (closure->wanted, remove_matching_keyid,
+		                             (gpointer)fingerprint);
+	}
+
+	g_byte_array_append (closure->data, key, n_key);
+	g_free (keyid);
+	return TRUE;
+}
+
+static void
+retrieve_take_keys (retrieve_closure *closure,
+                    const gchar *text,
+                    gsize n_text)
+{
+	const gchar *end = text + n_text;
+	const gchar *block;
+	guchar *binary;
+	gsize n_binary;
+
+	while ((block = g_strstr_len (text, end - text, SEAHORSE_PGP_KEY_BEGIN)) != NULL) {
+		text = g_strstr_len (block, end - block, SEAHORSE_PGP_KEY_END);
+		if (text == NULL)
+			break;
+		text += strlen (SEAHORSE_PGP_KEY_END);
+
+		binary = seahorse_pgp_armor_decode (block, text - block, &n_binary);
+		if (binary != NULL) {
+			seahorse_pgp_armor_foreach_key (binary, n_binary, on_retrieve_key, closure);
+			g_free (binary);
+		}
+	}
+}
+
+/* Whether some key still wanted is one no server could say anything about */
+static gboolean
+retrieve_has_unanswered (retrieve_closure *closure)
+{
+	GHashTableIter iter;
+	gpointer keyid;
+
+	g_hash_table_iter_init (&iter, closure->wanted);
+	while (g_hash_table_iter_next (&iter, &keyid, NULL)) {
+		if (!g_hash_table_contains (closure->missing, keyid))
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+static void
+retrieve_complete (GSimpleAsyncResult *res)
+{
+	retrieve_closure *closure = g_simple_async_result_get_op_res_gpointer (res);
+
+	seahorse_progress_end (closure->cancellable, closure);
+	g_simple_async_result_complete (res);
+}
+
+static void
+on_retrieve_import_ready (GObject *object,
+                          GAsyncResult *result,
+                          gpointer user_data)
+{
+	GSimpleAsyncResult *res = G_SIMPLE_ASYNC_RESULT (user_data);
+	retrieve_closure *closure = g_simple_async_result_get_op_res_gpointer (res);
+	GError *error = NULL;
+	GList *results;
+
+	if (SEAHORSE_IS_GPGME_KEYRING (closure->to))
+		results = seahorse_gpgme_keyring_import_finish (SEAHORSE_GPGME_KEYRING (object),
+		                                                result, &error);
+	else
+		results = seahorse_server_source_import_finish (SEAHORSE_SERVER_SOURCE (object),
+		                                                result, &error);
+	g_list_free (results);
+
+	if (error != NULL)
+		g_simple_async_result_take_error (res, error);
+
+	retrieve_complete (res);
+	g_object_unref (res);
+}
+
+/* Import the keys found, now that no server is being asked anymore */
+static void
+retrieve_import (GSimpleAsyncResult *res)
+{
+	retrieve_closure *closure = g_simple_async_result_get_op_res_gpointer (res);
+	GInputStream *input;
+	GString *armored;
+	GError *error = NULL;
+	gsize length;
+
+	if (closure->hedge_id) {
+		g_source_remove (closure->hedge_id);
+		closure->hedge_id = 0;
+	}
+
+	if (g_cancellable_set_error_if_cancelled (closure->cancellable, &error)) {
+		g_simple_async_result_take_error (res, error);
+		retrieve_complete (res);
+		return;
+	}
+
+	/* Server errors only matter when they kept us from finding keys */
+	if (closure->error != NULL && retrieve_has_unanswered (closure)) {
+		g_simple_async_result_set_from_error (res, closure->error);
+		if (closure->data->len == 0) {
+			retrieve_complete (res);
+			return;
+		}
+	}
+
+	if (closure->data->len == 0) {
+		retrieve_complete (res);
+		return;
+	}
+
+	g_debug ("retrieved %u keys, importing", g_hash_table_size (closure->found));
+
+	armored = g_string_sized_new ((closure->data->len * 4) / 3 + 256);
+	seahorse_pgp_armor_append (armored, closure->data->data, closure->data->len);
+	length = armored->len;
+	input = g_memory_input_stream_new_from_data (g_string_free (armored, FALSE), length, g_free);
+
+	if (SEAHORSE_IS_GPGME_KEYRING (closure->to))
+		seahorse_gpgme_keyring_import_async (SEAHORSE_GPGME_KEYRING (closure->to), input,
+		                                     closure->cancellable, on_retrieve_import_ready,
+		                                     g_object_ref (res));
+	else
+		seahorse_server_source_import_async (SEAHORSE_SERVER_SOURCE (closure->to), input,
+		                                     closure->cancellable, on_retrieve_import_ready,
+		                                     g_object_ref (res));
+
+	g_object_unref (input);
+}
+
+static gboolean      retrieve_next_server      (GSimpleAsyncResult *res);
+
+static void
+on_retrieve_export_ready (GObject *object,
+                          GAsyncResult *result,
+                          gpointer user_data)
+{
+	GSimpleAsyncResult *res = G_SIMPLE_ASYNC_RESULT (user_data);
+	retrieve_closure *closure = g_simple_async_result_get_op_res_gpointer (res);
+	retrieve_server *server = NULL;
+	GError *error = NULL;
+	gboolean answered;
+	gdouble elapsed;
+	gpointer data;
+	gsize size;
+	guint i;
+
+	data = seahorse_server_source_export_finish (SEAHORSE_SERVER_SOURCE (object),
+	                                             result, &size, &error);
+
+	for (i = 0; i < closure->servers->len; i++) {
+		server = closure->servers->pdata[i];
+		if (server->source == SEAHORSE_SERVER_SOURCE (object))
+			break;
+	}
+
+	/* Not having any of the keys is an answer, unlike failing to ask */
+	answered = error == NULL || g_error_matches (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND);
+
+	/* A server we gave up on only tells us it's at least this slow */
+	elapsed = (g_get_monotonic_time () - server->started) / 1000.0;
+	if (answered)
+		record_server_latency (closure->backend, server->uri, elapsed, FALSE);
+	else if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+		record_server_latency (closure->backend, server->uri, elapsed, TRUE);
+
+	if (data != NULL) {
+		retrieve_take_keys (closure, data, size);
+		g_free (data);
+	}
+
+	/* What it was asked for and didn't return, it doesn't have */
+	if (answered) {
+		for (i = 0; i < server->asked->len; i++) {
+			if (g_hash_table_contains (closure->wanted, server->asked->pdata[i]))
+				g_hash_table_add (closure->missing, g_strdup (server->asked->pdata[i]));
+		}
+	}
+
+	if (error != NULL) {
+		if (!answered && closure->error == NULL &&
+		    !g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+			closure->error = g_error_copy (error);
+		g_clear_error (&error);
+	}
+
+	closure->num_exports--;
+
+	/* Everything found, no need to wait for the others */
+	if (g_hash_table_size (closure->wanted) == 0) {
+		g_cancellable_cancel (closure->exports);
+
+	/* Ask the next server right away, rather than waiting for the hedge */
+	} else if (closure->num_exports == 0) {
+		retrieve_next_server (res);
+	}
+
+	if (closure->num_exports == 0)
+		retrieve_import (res);
+
+	g_object_unref (res);
+}
+
+static gboolean
+on_retrieve_hedge (gpointer user_data)
+{
+	GSimpleAsyncResult *res = G_SIMPLE_ASYNC_RESULT (user_data);
+	retrieve_closure *closure = g_simple_async_result_get_op_res_gpointer (res);
+
+	closure->hedge_id = 0;
+	retrieve_next_server (res);
+	return G_SOURCE_REMOVE;
+}
+
+/* Ask the next fastest server for the keys not found so far */
+static gboolean
+retrieve_next_server (GSimpleAsyncResult *res)
+{
+	retrieve_closure *closure = g_simple_async_result_get_op_res_gpointer (res);
+	retrieve_server *server;
+	GHashTableIter iter;
+	GPtrArray *keyids;
+	gpointer keyid;
+
+	if (closure->hedge_id) {
+		g_source_remove (closure->hedge_id);
+		closure->hedge_id = 0;
+	}
+
+	if (closure->next_server >= closure->servers->len ||
+	    g_cancellable_is_cancelled (closure->exports))
+		return FALSE;
+
+	server = closure->servers->pdata[closure->next_server++];
+
+	keyids = g_ptr_array_new_with_free_func (g_free);
+	g_hash_table_iter_init (&iter, closure->wanted);
+	while (g_hash_table_iter_next (&iter, &keyid, NULL))
+		g_ptr_array_add (keyids, g_strdup (keyid));
+	g_ptr_array_add (keyids, NULL);
+
+	g_debug ("retrieving %u keys from %s", keyids->len - 1, server->uri);
+
+	server->started = g_get_monotonic_time ();
+	closure->num_exports++;
+	seahorse_server_source_export_async (server->source, (const gchar **)keyids->pdata,
+	                                     closure->exports, on_retrieve_export_ready,
+	                                     g_object_ref (res));
+
+	/* Remembered to tell which keys the server said it doesn't have */
+	g_ptr_array_remove_index (keyids, keyids->len - 1);
+	server->asked = keyids;
+
+	if (closure->next_server < closure->servers->len)
+		closure->hedge_id = g_timeout_add_full (G_PRIORITY_DEFAULT, RETRIEVE_HEDGE_DELAY,
+		                                        on_retrieve_hedge, g_object_ref (res),
+		                                        g_object_unref);
+
+	return TRUE;
+}
+
+static void
+on_retrieve_cancelled (GCancellable *cancellable,
+                       gpointer user_data)
+{
+	retrieve_closure *closure = user_data;
+	g_cancellable_cancel (closure->exports);
+}
+
+static void
+retrieve_merge_async (SeahorsePgpBackend *self,
+                      const gchar **keyids,
+                      SeahorsePlace *to,
+                      GCancellable *cancellable,
+                      GAsyncReadyCallback callback,
+                      gpointer user_data)
 {
 	transfer_closure *closure;
 	GSimpleAsyncResult *res;
 	SeahorsePlace *place;
 	GHashTableIter iter;
 
-	self = self ? self : seahorse_pgp_backend_get ();
-	g_return_if_fail (SEAHORSE_IS_PGP_BACKEND (self));
-	g_return_if_fail (SEAHORSE_IS_PLACE (to));
-
 	res = g_simple_async_result_new (G_OBJECT (self), callback, user_data,
 	                                 seahorse_pgp_backend_retrieve_async);
 	closure = g_new0 (transfer_closure, 1);
@@ -706,6 +1571,105 @@ seahorse_pgp_backend_retrieve_async (SeahorsePgpBackend *self,
 	g_object_unref (res);
 }
 
+void
+seahorse_pgp_backend_retrieve_async (SeahorsePgpBackend *self,
+                                     const gchar **keyids,
+                                     SeahorsePlace *to,
+                                     GCancellable *cancellable,
+                                     GAsyncReadyCallback callback,
+                                     gpointer user_data)
+{
+	seahorse_pgp_backend_retrieve_full_async (self, keyids, to, FALSE, cancellable,
+	                                          callback, user_data);
+}
+
+/**
+ * seahorse_pgp_backend_retrieve_full_async:
+ * @self: The backend, or NULL for the default
+ * @keyids: The key ids to retrieve
+ * @to: Where to import the keys
+ * @merge: Whether to merge in the keys from every key server
+ * @cancellable: Allows cancellation
+ * @callback: Called when done
+ * @user_data: Passed to @callback
+ *
+ * Unless @merge is set, servers are asked one after the other, fastest
+ * first, for the keys not yet returned by another. Each key is then
+ * only imported once. With @merge, as when syncing, every server's copy
+ * is imported so signatures from all of them are picked up.
+ */
+void
+seahorse_pgp_backend_retrieve_full_async (SeahorsePgpBackend *self,
+                                          const gchar **keyids,
+                                          SeahorsePlace *to,
+                                          gboolean merge,
+                                          GCancellable *cancellable,
+                                          GAsyncReadyCallback callback,
+                                          gpointer user_data)
+{
+	retrieve_closure *closure;
+	retrieve_server *server;
+	SeahorseServerSource *source;
+	GSimpleAsyncResult *res;
+	GHashTableIter iter;
+	gdouble *latency;
+	gchar *uri;
+	guint i;
+
+	self = self ? self : seahorse_pgp_backend_get ();
+	g_return_if_fail (SEAHORSE_IS_PGP_BACKEND (self));
+	g_return_if_fail (SEAHORSE_IS_PLACE (to));
+
+	if (merge) {
+		retrieve_merge_async (self, keyids, to, cancellable, callback, user_data);
+		return;
+	}
+
+	res = g_simple_async_result_new (G_OBJECT (self), callback, user_data,
+	                                 seahorse_pgp_backend_retrieve_async);
+	closure = g_new0 (retrieve_closure, 1);
+	closure->backend = g_object_ref (self);
+	closure->to = g_object_ref (to);
+	closure->exports = g_cancellable_new ();
+	closure->servers = g_ptr_array_new_with_free_func (retrieve_server_free);
+	closure->wanted = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	closure->found = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	closure->missing = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	closure->data = g_byte_array_new ();
+	g_simple_async_result_set_op_res_gpointer (res, closure, retrieve_closure_free);
+	if (cancellable)
+		closure->cancellable = g_object_ref (cancellable);
+
+	for (i = 0; keyids && keyids[i] != NULL; i++)
+		g_hash_table_add (closure->wanted, seahorse_pgp_armor_compact_keyid (keyids[i]));
+
+	g_hash_table_iter_init (&iter, self->remotes);
+	while (g_hash_table_iter_next (&iter, (gpointer *)&uri, (gpointer *)&source)) {
+		server = g_new0 (retrieve_server, 1);
+		server->source = g_object_ref (source);
+		server->uri = g_strdup (uri);
+		latency = g_hash_table_lookup (self->latencies, uri);
+		server->latency = latency ? *latency : 0;
+		g_ptr_array_add (closure->servers, server);
+	}
+
+	g_ptr_array_sort (closure->servers, compare_retrieve_latency);
+
+	seahorse_progress_prep_and_begin (cancellable, closure, NULL);
+
+	if (closure->cancellable)
+		closure->cancelled_sig = g_cancellable_connect (closure->cancellable,
+		                                                G_CALLBACK (on_retrieve_cancelled),
+		                                                closure, NULL);
+
+	if (g_hash_table_size (closure->wanted) == 0 || !retrieve_next_server (res)) {
+		seahorse_progress_end (cancellable, closure);
+		g_simple_async_result_complete_in_idle (res);
+	}
+
+	g_object_unref (res);
+}
+
 gboolean
 seahorse_pgp_backend_retrieve_finish (SeahorsePgpBackend *self,
                                       GAsyncResult *result,
@@ -726,6 +1690,151 @@ seahorse_pgp_backend_retrieve_finish (SeahorsePgpBackend *self,
 	return TRUE;
 }
 
+/**
+ * seahorse_pgp_backend_retrieve_answered:
+ * @self: The backend, or NULL for the default
+ * @result: The result of a retrieve without merging
+ * @keyid: One of the key ids that was retrieved
+ *
+ * Whether a key server returned the key, or said it doesn't have it.
+ * Neither is the case when no key server could be reached, or none is
+ * configured.
+ *
+ * Returns: Whether some key server answered for the key
+ */
+gboolean
+seahorse_pgp_backend_retrieve_answered (SeahorsePgpBackend *self,
+                                        GAsyncResult *result,
+                                        const gchar *keyid)
+{
+	retrieve_closure *closure;
+	gboolean answered;
+	gchar *compact;
+
+	self = self ? self : seahorse_pgp_backend_get ();
+	g_return_val_if_fail (SEAHORSE_IS_PGP_BACKEND (self), FALSE);
+	g_return_val_if_fail (g_simple_async_result_is_valid (result, G_OBJECT (self),
+	                      seahorse_pgp_backend_retrieve_async), FALSE);
+	g_return_val_if_fail (keyid != NULL, FALSE);
+
+	closure = g_simple_async_result_get_op_res_gpointer (G_SIMPLE_ASYNC_RESULT (result));
+	compact = seahorse_pgp_armor_compact_keyid (keyid);
+	answered = !g_hash_table_contains (closure->wanted, compact) ||
+	           g_hash_table_contains (closure->missing, compact);
+	g_free (compact);
+
+	return answered;
+}
+
+/* Keys not found on any key server aren't looked up again for this long */
+#define DISCOVER_NEGATIVE_TTL    (60 * 60)
+
+/*
+ * Whether a server said it doesn't have @keyid, and none of the others
+ * that answered returned it. Servers that couldn't be reached don't count.
+ */
+static gboolean
+retrieve_confirmed_missing (GAsyncResult *result,
+                            const gchar *keyid)
+{
+	retrieve_closure *closure;
+	gboolean missing;
+	gchar *compact;
+
+	closure = g_simple_async_result_get_op_res_gpointer (G_SIMPLE_ASYNC_RESULT (result));
+	compact = seahorse_pgp_armor_compact_keyid (keyid);
+	missing = g_hash_table_contains (closure->wanted, compact) &&
+	          g_hash_table_contains (closure->missing, compact);
+	g_free (compact);
+
+	return missing;
+}
+
+static void
+on_discover_retrieved (GObject *source,
+                       GAsyncResult *result,
+                       gpointer user_data)
+{
+	SeahorsePgpBackend *self = SEAHORSE_PGP_BACKEND (source);
+	GPtrArray *keyids = user_data;
+	GError *error = NULL;
+	gint64 *when;
+	gint64 now;
+	guint i;
+
+	seahorse_pgp_backend_retrieve_finish (self, result, &error);
+	if (error != NULL)
+		g_debug ("couldn't discover keys: %s", error->message);
+
+	now = g_get_monotonic_time () / G_USEC_PER_SEC;
+	for (i = 0; keyids->pdata[i] != NULL; i++) {
+		g_hash_table_remove (self->discovering, keyids->pdata[i]);
+
+		/* Only remember misses a server confirmed, whatever else failed */
+		if (retrieve_confirmed_missing (result, keyids->pdata[i]) &&
+		    !seahorse_gpgme_keyring_lookup (self->keyring, keyids->pdata[i])) {
+			when = g_new (gint64, 1);
+			*when = now;
+			g_hash_table_replace (self->undiscovered, g_strdup (keyids->pdata[i]), when);
+		}
+	}
+
+	g_clear_error (&error);
+	g_ptr_array_free (keyids, TRUE);
+}
+
+static gboolean
+on_discover_idle (gpointer user_data)
+{
+	SeahorsePgpBackend *self = SEAHORSE_PGP_BACKEND (user_data);
+	GPtrArray *keyids;
+
+	keyids = self->discover_pending;
+	self->discover_pending = NULL;
+	self->discover_idle = 0;
+
+	g_ptr_array_add (keyids, NULL);
+	g_debug ("discovering %u keys", keyids->len - 1);
+
+	/* Shared by all callers, so not cancelled by any one of them */
+	seahorse_pgp_backend_retrieve_async (self, (const gchar **)keyids->pdata,
+	                                     SEAHORSE_PLACE (self->keyring),
+	                                     NULL, on_discover_retrieved, keyids);
+
+	return G_SOURCE_REMOVE;
+}
+
+/*
+ * Look up @keyid on the key servers, unless it already is being looked up,
+ * or wasn't found recently. Requests made during the same main loop
+ * iteration go out together.
+ */
+static void
+discover_key_remote (SeahorsePgpBackend *self,
+                     const gchar *keyid)
+{
+	gint64 *when;
+
+	if (g_hash_table_contains (self->discovering, keyid))
+		return;
+
+	when = g_hash_table_lookup (self->undiscovered, keyid);
+	if (when != NULL) {
+		if (g_get_monotonic_time () / G_USEC_PER_SEC - *when < DISCOVER_NEGATIVE_TTL)
+			return;
+		g_hash_table_remove (self->undiscovered, keyid);
+	}
+
+	g_hash_table_add (self->discovering, g_strdup (keyid));
+
+	if (self->discover_pending == NULL)
+		self->discover_pending = g_ptr_array_new_with_free_func (g_free);
+	g_ptr_array_add (self->discover_pending, g_strdup (keyid));
+
+	if (!self->discover_idle)
+		self->discover_idle = g_idle_add (on_discover_idle, self);
+}
+
 #endif /* WITH_KEYSERVER */
 
 GList *
@@ -768,9 +1877,10 @@ seahorse_pgp_backend_discover_keys (SeahorsePgpBackend *self,
 
 #ifdef WITH_KEYSERVER
 		/* Start a discover process on all todiscover */
-		if (seahorse_app_settings_get_server_auto_retrieve (seahorse_app_settings_instance ()))
-			seahorse_pgp_backend_retrieve_async (self, keyids, SEAHORSE_PLACE (self->keyring),
-			                                     cancellable, NULL, NULL);
+		if (seahorse_app_settings_get_server_auto_retrieve (seahorse_app_settings_instance ())) {
+			for (i = 0; keyids[i] != NULL; i++)
+				discover_key_remote (self, keyids[i]);
+		}
 #endif
 
 		/* Add unknown objects for all these */
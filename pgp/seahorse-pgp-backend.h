@@ -75,10 +75,22 @@ void                   seahorse_pgp_backend_search_remote_async  (SeahorsePgpBac
                                                                   GAsyncReadyCallback callback,
                                                                   gpointer user_data);
 
+void                   seahorse_pgp_backend_search_remote_full_async (SeahorsePgpBackend *self,
+                                                                      const gchar *search,
+                                                                      GcrSimpleCollection *results,
+                                                                      guint max_results,
+                                                                      guint timeout,
+                                                                      GCancellable *cancellable,
+                                                                      GAsyncReadyCallback callback,
+                                                                      gpointer user_data);
+
 gboolean               seahorse_pgp_backend_search_remote_finish (SeahorsePgpBackend *self,
                                                                   GAsyncResult *result,
                                                                   GError **error);
 
+gboolean               seahorse_pgp_backend_search_remote_truncated (SeahorsePgpBackend *self,
+                                                                     GAsyncResult *result);
+
 void                   seahorse_pgp_backend_transfer_async       (SeahorsePgpBackend *self,
                                                                   GList *keys,
                                                                   SeahorsePlace *to,
@@ -97,9 +109,21 @@ void                   seahorse_pgp_backend_retrieve_async       (SeahorsePgpBac
                                                                   GAsyncReadyCallback callback,
                                                                   gpointer user_data);
 
+void                   seahorse_pgp_backend_retrieve_full_async  (SeahorsePgpBackend *self,
+                                                                  const gchar **keyids,
+                                                                  SeahorsePlace *to,
+                                                                  gboolean merge,
+                                                                  GCancellable *cancellable,
+                                                                  GAsyncReadyCallback callback,
+                                                                  gpointer user_data);
+
 gboolean               seahorse_pgp_backend_retrieve_finish      (SeahorsePgpBackend *self,
                                                                   GAsyncResult *result,
                                                                   GError **error);
+
+gboolean               seahorse_pgp_backend_retrieve_answered    (SeahorsePgpBackend *self,
+                                                                  GAsyncResult *result,
+                                                                  const gchar *keyid);
 #endif /* WITH_KEYSERVER */
 
 GList*                 seahorse_pgp_backend_discover_keys        (SeahorsePgpBackend *self,
@@ -0,0 +1,457 @@
+/*
+ * Seahorse
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "seahorse-pgp-refresh.h"
+
+#include "seahorse-pgp-armor.h"
+#include "seahorse-pgp-key.h"
+
+#include "seahorse-common.h"
+
+#include <string.h>
+
+/**
+ * SECTION:seahorse-pgp-refresh
+ * @short_description: Background refresh of keys from key servers
+ * @include:seahorse-pgp-refresh.h
+ **/
+
+#ifdef WITH_KEYSERVER
+
+/* Don't compete with loading and whatever the user opened the app for */
+#define REFRESH_STARTUP_DELAY   (5 * 60)
+
+/* Keys expiring within this many seconds are refreshed first */
+#define REFRESH_EXPIRY_WINDOW   (30 * 24 * 60 * 60)
+
+/* How long to wait before checking again when nothing is due */
+#define REFRESH_MIN_WAIT        60
+
+/* Keys that couldn't be refreshed are tried again after this long */
+#define REFRESH_RETRY_WAIT      (30 * 60)
+
+/* Write out progress after this many refreshed keys */
+#define REFRESH_SAVE_EVERY      10
+
+#define REFRESH_GROUP           "refreshed"
+
+enum {
+	PRIORITY_EXPIRING,
+	PRIORITY_NEVER,
+	PRIORITY_NORMAL,
+	PRIORITY_REVOKED
+};
+
+typedef struct {
+	gchar *fingerprint;
+	gint priority;
+	guint32 shuffle;
+} RefreshKey;
+
+struct _SeahorsePgpRefresh {
+	SeahorsePgpBackend *backend;
+	gchar *path;
+	GKeyFile *state;                /* fingerprint -> when last refreshed */
+	GQueue *queue;                  /* RefreshKey, in the order to refresh */
+	GCancellable *cancellable;
+	guint timeout;
+	guint in_flight;
+	guint unsaved;
+	guint failed;                   /* Keys left due in this run */
+	gboolean running;
+};
+
+typedef struct {
+	SeahorsePgpRefresh *refresh;
+	GCancellable *cancellable;
+	RefreshKey *key;
+} RefreshRequest;
+
+static void        refresh_schedule        (SeahorsePgpRefresh *self,
+                                            guint seconds);
+
+static void
+refresh_key_free (gpointer data)
+{
+	RefreshKey *key = data;
+	g_free (key->fingerprint);
+	g_free (key);
+}
+
+static gint
+compare_refresh_keys (gconstpointer a,
+                      gconstpointer b)
+{
+	const RefreshKey *ka = *((RefreshKey **)a);
+	const RefreshKey *kb = *((RefreshKey **)b);
+
+	if (ka->priority != kb->priority)
+		return ka->priority - kb->priority;
+	if (ka->shuffle != kb->shuffle)
+		return ka->shuffle < kb->shuffle ? -1 : 1;
+	return 0;
+}
+
+static gint64
+refresh_interval (void)
+{
+	gint hours;
+
+	hours = seahorse_app_settings_get_keyserver_refresh_interval (seahorse_app_settings_instance ());
+	return MAX (hours, 0) * (gint64)60 * 60;
+}
+
+static void
+refresh_save (SeahorsePgpRefresh *self)
+{
+	GError *error = NULL;
+	gchar *dir;
+
+	self->unsaved = 0;
+
+	dir = g_path_get_dirname (self->path);
+	g_mkdir_with_parents (dir, 0700);
+	g_free (dir);
+
+	if (!g_key_file_save_to_file (self->state, self->path, &error)) {
+		g_message ("couldn't save key refresh state: %s", error->message);
+		g_clear_error (&error);
+	}
+}
+
+/*
+ * Queue up all the keys that are due, and drop state for keys no longer
+ * in the key ring. Returns how long until the next key falls due.
+ */
+static gint64
+refresh_queue_due (SeahorsePgpRefresh *self,
+                   gint64 now,
+                   gint64 interval)
+{
+	SeahorseGpgmeKeyring *keyring;
+	GHashTable *present;
+	GPtrArray *due;
+	RefreshKey *key;
+	gchar **fingerprints;
+	gint64 next = G_MAXINT64;
+	gint64 last;
+	gulong expires;
+	guint flags;
+	GList *objects, *l;
+	gchar *fingerprint;
+	guint i;
+
+	keyring = seahorse_pgp_backend_get_default_keyring (self->backend);
+	objects = gcr_collection_get_objects (GCR_COLLECTION (keyring));
+	present = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	due = g_ptr_array_new ();
+
+	for (l = objects; l != NULL; l = g_list_next (l)) {
+		if (!SEAHORSE_IS_PGP_KEY (l->data))
+			continue;
+
+		fingerprint = seahorse_pgp_armor_compact_keyid (seahorse_pgp_key_get_fingerprint (l->data));
+		if (!fingerprint[0] || g_hash_table_contains (present, fingerprint)) {
+			g_free (fingerprint);
+			continue;
+		}
+		g_hash_table_add (present, fingerprint);
+
+		last = g_key_file_get_int64 (self->state, REFRESH_GROUP, fingerprint, NULL);
+		if (last > 0 && last + interval > now) {
+			next = MIN (next, last + interval - now);
+			continue;
+		}
+
+		key = g_new0 (RefreshKey, 1);
+		key->fingerprint = g_strdup (fingerprint);
+		key->shuffle = g_random_int ();
+
+		flags = seahorse_object_get_flags (l->data);
+		expires = seahorse_pgp_key_get_expires (l->data);
+		if (flags & SEAHORSE_FLAG_REVOKED)
+			key->priority = PRIORITY_REVOKED;
+		else if (expires != 0 && (gint64)expires < now + REFRESH_EXPIRY_WINDOW)
+			key->priority = PRIORITY_EXPIRING;
+		else if (last <= 0)
+			key->priority = PRIORITY_NEVER;
+		else
+			key->priority = PRIORITY_NORMAL;
+
+		g_ptr_array_add (due, key);
+	}
+
+	g_list_free (objects);
+
+	/* Forget about keys that were deleted */
+	fingerprints = g_key_file_get_keys (self->state, REFRESH_GROUP, NULL, NULL);
+	for (i = 0; fingerprints && fingerprints[i] != NULL; i++) {
+		if (!g_hash_table_contains (present, fingerprints[i]))
+			g_key_file_remove_key (self->state, REFRESH_GROUP, fingerprints[i], NULL);
+	}
+	g_strfreev (fingerprints);
+	g_hash_table_destroy (present);
+
+	g_ptr_array_sort (due, compare_refresh_keys);
+	for (i = 0; i < due->len; i++)
+		g_queue_push_tail (self->queue, due->pdata[i]);
+	g_ptr_array_free (due, TRUE);
+
+	return next;
+}
+
+static void
+refresh_finish_run (SeahorsePgpRefresh *self)
+{
+	gint64 interval;
+	gint64 next;
+
+	self->running = FALSE;
+	refresh_save (self);
+
+	interval = refresh_interval ();
+	if (interval == 0)
+		return;
+
+	next = refresh_queue_due (self, g_get_real_time () / G_USEC_PER_SEC, interval);
+	g_queue_free_full (self->queue, refresh_key_free);
+	self->queue = g_queue_new ();
+
+	/* Don't wait the whole interval for keys we couldn't ask about */
+	if (self->failed > 0)
+		next = MIN (next, REFRESH_RETRY_WAIT);
+	self->failed = 0;
+
+	g_debug ("key refresh done, next in %" G_GINT64_FORMAT " seconds", next);
+	refresh_schedule (self, MAX (REFRESH_MIN_WAIT, MIN (next, interval)));
+}
+
+static void
+on_refresh_retrieved (GObject *source,
+                      GAsyncResult *result,
+                      gpointer user_data)
+{
+	RefreshRequest *request = user_data;
+	SeahorsePgpRefresh *self = request->refresh;
+	GError *error = NULL;
+	gboolean answered;
+
+	seahorse_pgp_backend_retrieve_finish (SEAHORSE_PGP_BACKEND (source), result, &error);
+	answered = seahorse_pgp_backend_retrieve_answered (SEAHORSE_PGP_BACKEND (source), result,
+	                                                   request->key->fingerprint);
+
+	/* We've been freed */
+	if (g_cancellable_is_cancelled (request->cancellable)) {
+		g_clear_error (&error);
+
+	} else {
+		/*
+		 * A key that isn't on any server counts as refreshed too. When
+		 * no server could be asked, the key stays due.
+		 */
+		if (error != NULL || !answered) {
+			g_debug ("couldn't refresh key %s: %s", request->key->fingerprint,
+			         error ? error->message : "no key server answered");
+			g_clear_error (&error);
+			self->failed++;
+
+		} else {
+			g_key_file_set_int64 (self->state, REFRESH_GROUP, request->key->fingerprint,
+			                      g_get_real_time () / G_USEC_PER_SEC);
+			if (++self->unsaved >= REFRESH_SAVE_EVERY)
+				refresh_save (self);
+		}
+
+		self->in_flight--;
+		if (self->in_flight == 0 && g_queue_is_empty (self->queue))
+			refresh_finish_run (self);
+	}
+
+	g_object_unref (request->cancellable);
+	refresh_key_free (request->key);
+	g_free (request);
+}
+
+static gboolean
+on_refresh_tick (gpointer user_data)
+{
+	SeahorsePgpRefresh *self = user_data;
+	RefreshRequest *request;
+	const gchar *keyids[2];
+	gint max_requests;
+
+	/* Turned off while running */
+	if (refresh_interval () == 0) {
+		g_queue_free_full (self->queue, refresh_key_free);
+		self->queue = g_queue_new ();
+	}
+
+	if (g_queue_is_empty (self->queue)) {
+		self->timeout = 0;
+		if (self->in_flight == 0)
+			refresh_finish_run (self);
+		return G_SOURCE_REMOVE;
+	}
+
+	max_requests = seahorse_app_settings_get_keyserver_refresh_requests (seahorse_app_settings_instance ());
+	if (self->in_flight >= (guint)MAX (max_requests, 1))
+		return G_SOURCE_CONTINUE;
+
+	request = g_new0 (RefreshRequest, 1);
+	request->refresh = self;
+	request->cancellable = g_object_ref (self->cancellable);
+	request->key = g_queue_pop_head (self->queue);
+
+	/* By fingerprint, so a colliding key id can't bring in another key */
+	keyids[0] = request->key->fingerprint;
+	keyids[1] = NULL;
+
+	self->in_flight++;
+	seahorse_pgp_backend_retrieve_async (self->backend, keyids,
+	                                     SEAHORSE_PLACE (seahorse_pgp_backend_get_default_keyring (self->backend)),
+	                                     self->cancellable, on_refresh_retrieved, request);
+
+	return G_SOURCE_CONTINUE;
+}
+
+static gboolean
+on_refresh_start (gpointer user_data)
+{
+	SeahorsePgpRefresh *self = user_data;
+	gint64 interval;
+	gint64 next;
+	gint rate;
+
+	self->timeout = 0;
+
+	interval = refresh_interval ();
+	if (interval == 0)
+		return G_SOURCE_REMOVE;
+
+	next = refresh_queue_due (self, g_get_real_time () / G_USEC_PER_SEC, interval);
+	if (g_queue_is_empty (self->queue)) {
+		refresh_schedule (self, MAX (REFRESH_MIN_WAIT, MIN (next, interval)));
+		return G_SOURCE_REMOVE;
+	}
+
+	g_debug ("refreshing %u keys from key servers", g_queue_get_length (self->queue));
+
+	/* Keys per minute */
+	rate = seahorse_app_settings_get_keyserver_refresh_rate (seahorse_app_settings_instance ());
+	rate = CLAMP (rate, 1, 60);
+
+	self->running = TRUE;
+	self->timeout = g_timeout_add_seconds_full (G_PRIORITY_LOW, 60 / rate,
+	                                            on_refresh_tick, self, NULL);
+	return G_SOURCE_REMOVE;
+}
+
+static void
+refresh_schedule (SeahorsePgpRefresh *self,
+                  guint seconds)
+{
+	if (self->timeout)
+		g_source_remove (self->timeout);
+	self->timeout = g_timeout_add_seconds_full (G_PRIORITY_LOW, seconds,
+	                                            on_refresh_start, self, NULL);
+}
+
+static void
+on_settings_refresh_changed (GSettings *settings,
+                             gchar *key,
+                             gpointer user_data)
+{
+	SeahorsePgpRefresh *self = user_data;
+
+	/* A running refresh picks up the change itself */
+	if (!self->running && refresh_interval () > 0)
+		refresh_schedule (self, REFRESH_STARTUP_DELAY);
+}
+
+/**
+ * seahorse_pgp_refresh_new:
+ * @backend: The backend whose key ring to refresh
+ *
+ * Starts refreshing keys in the background, if enabled by the
+ * keyserver-refresh-interval setting.
+ *
+ * Returns: The refresher, free with seahorse_pgp_refresh_free()
+ */
+SeahorsePgpRefresh *
+seahorse_pgp_refresh_new (SeahorsePgpBackend *backend)
+{
+	SeahorsePgpRefresh *self;
+	GError *error = NULL;
+
+	g_return_val_if_fail (SEAHORSE_IS_PGP_BACKEND (backend), NULL);
+
+	self = g_new0 (SeahorsePgpRefresh, 1);
+	self->backend = backend;
+	self->queue = g_queue_new ();
+	self->cancellable = g_cancellable_new ();
+	self->state = g_key_file_new ();
+	self->path = g_build_filename (g_get_user_data_dir (), "seahorse", "refreshed-keys", NULL);
+
+	if (!g_key_file_load_from_file (self->state, self->path, G_KEY_FILE_NONE, &error)) {
+		if (!g_error_matches (error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+			g_message ("couldn't read key refresh state: %s", error->message);
+		g_clear_error (&error);
+	}
+
+	g_signal_connect (seahorse_app_settings_instance (), "changed::keyserver-refresh-interval",
+	                  G_CALLBACK (on_settings_refresh_changed), self);
+
+	if (refresh_interval () > 0)
+		refresh_schedule (self, REFRESH_STARTUP_DELAY);
+
+	return self;
+}
+
+/**
+ * seahorse_pgp_refresh_free:
+ * @refresh: The refresher
+ *
+ * Stops refreshing, saving progress so far.
+ */
+void
+seahorse_pgp_refresh_free (SeahorsePgpRefresh *refresh)
+{
+	if (refresh == NULL)
+		return;
+
+	g_signal_handlers_disconnect_by_func (seahorse_app_settings_instance (),
+	                                      on_settings_refresh_changed, refresh);
+
+	if (refresh->timeout)
+		g_source_remove (refresh->timeout);
+
+	/* Outstanding requests see this and leave us alone */
+	g_cancellable_cancel (refresh->cancellable);
+	g_object_unref (refresh->cancellable);
+
+	if (refresh->unsaved > 0)
+		refresh_save (refresh);
+
+	g_queue_free_full (refresh->queue, refresh_key_free);
+	g_key_file_free (refresh->state);
+	g_free (refresh->path);
+	g_free (refresh);
+}
+
+#endif /* WITH_KEYSERVER */
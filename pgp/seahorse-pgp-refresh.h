@@ -0,0 +1,46 @@
+/*
+ * Seahorse
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * SeahorsePgpRefresh: Refreshes the keys in the key ring from the key
+ * servers in the background.
+ *
+ * - Keys are refreshed a few at a time, limited by the
+ *   keyserver-refresh-rate and keyserver-max-requests settings.
+ * - Keys close to expiry go first, the rest in random order.
+ * - When each key was last refreshed is remembered, so an interrupted
+ *   refresh carries on where it left off.
+ */
+
+#ifndef __SEAHORSE_PGP_REFRESH_H__
+#define __SEAHORSE_PGP_REFRESH_H__
+
+#include "config.h"
+
+#ifdef WITH_KEYSERVER
+
+#include "seahorse-pgp-backend.h"
+
+typedef struct _SeahorsePgpRefresh SeahorsePgpRefresh;
+
+SeahorsePgpRefresh *  seahorse_pgp_refresh_new           (SeahorsePgpBackend *backend);
+
+void                  seahorse_pgp_refresh_free          (SeahorsePgpRefresh *refresh);
+
+#endif /* WITH_KEYSERVER */
+
+#endif /* __SEAHORSE_PGP_REFRESH_H__ */
@@ -52,6 +52,13 @@ enum {
     PROP_ACTIONS
 };
 
+enum {
+    SEARCH_TRUNCATED,
+    LAST_SIGNAL
+};
+
+static guint signals[LAST_SIGNAL] = { 0 };
+
 /* -----------------------------------------------------------------------------
  *  SERVER SOURCE
  */
@@ -114,6 +121,11 @@ seahorse_server_source_class_init (SeahorseServerSourceClass *klass)
             g_param_spec_string ("uri", "Key Server URI",
                                  "Key Server full URI", "",
                                  G_PARAM_READWRITE));
+
+    /* Emitted when the server has more matches than it returned */
+    signals[SEARCH_TRUNCATED] = g_signal_new ("search-truncated", SEAHORSE_TYPE_SERVER_SOURCE,
+                G_SIGNAL_RUN_LAST, G_STRUCT_OFFSET (SeahorseServerSourceClass, search_truncated),
+                NULL, NULL, g_cclosure_marshal_VOID__STRING, G_TYPE_NONE, 1, G_TYPE_STRING);
 }
 
 /**
@@ -93,6 +93,11 @@ struct _SeahorseServerSourceClass {
 	gboolean        (*search_finish)         (SeahorseServerSource *source,
 	                                          GAsyncResult *result,
 	                                          GError **error);
+
+	/* signals --------------------------------------------------------- */
+
+	void            (*search_truncated)      (SeahorseServerSource *source,
+	                                          const gchar *match);
 };
 
 GType                  seahorse_server_source_get_type         (void);
@@ -28,6 +28,7 @@
 #include "seahorse-server-source.h"
 #include "seahorse-gpgme-exporter.h"
 #include "seahorse-gpgme-keyring.h"
+#include "seahorse-pgp-armor.h"
 
 #include "seahorse-common.h"
 
@@ -38,13 +39,34 @@
 #include <glib/gi18n.h>
 
 #include <stdlib.h>
+#include <string.h>
 
+/* Keys exported at a time */
+#define TRANSFER_CHUNK_KEYS 50
+
+/*
+ * Keys are exported in chunks, and each chunk is imported while the
+ * next one is being exported. Exporting pauses while more than the
+ * buffer limit is waiting to be imported.
+ */
 typedef struct {
 	GCancellable *cancellable;
 	SeahorsePlace *from;
 	SeahorsePlace *to;
 	gchar **keyids;
 	GList *keys;
+	guint n_items;
+	guint exported;
+	GQueue *chunks;
+	gsize buffered;
+	gsize max_buffered;
+	gboolean exporting;
+	gboolean importing;
+	gboolean exported_all;
+	gboolean import_begun;
+	gboolean received;              /* Some chunk had keys in it */
+	GError *not_found;              /* From a chunk none of whose keys were found */
+	GError *error;
 } TransferClosure;
 
 static void
@@ -56,9 +78,49 @@ transfer_closure_free (gpointer user_data)
 	g_clear_object (&closure->cancellable);
 	g_strfreev (closure->keyids);
 	seahorse_object_list_free (closure->keys);
+	g_queue_free_full (closure->chunks, (GDestroyNotify)g_bytes_unref);
+	g_clear_error (&closure->not_found);
+	g_clear_error (&closure->error);
 	g_free (closure);
 }
 
+static void
+transfer_closure_init (TransferClosure *closure)
+{
+	gint limit;
+
+	closure->chunks = g_queue_new ();
+	limit = seahorse_app_settings_get_transfer_buffer_size (seahorse_app_settings_instance ());
+	closure->max_buffered = (gsize)MAX (limit, 1) * 1024 * 1024;
+}
+
+/*
+ * Prefer the full fingerprint, so that remote sources retrieve exactly
+ * this key, rather than every key sharing its key id.
+ */
+static gchar *
+calc_transfer_keyid (SeahorsePgpKey *key)
+{
+	const gchar *keyid;
+	const gchar *value;
+	gchar *fingerprint;
+
+	keyid = seahorse_pgp_key_get_keyid (key);
+	value = seahorse_pgp_key_get_fingerprint (key);
+	if (value == NULL)
+		return g_strdup (keyid);
+
+	fingerprint = seahorse_pgp_armor_compact_keyid (value);
+	if (keyid != NULL && strlen (fingerprint) < strlen (keyid)) {
+		g_free (fingerprint);
+		return g_strdup (keyid);
+	}
+
+	return fingerprint;
+}
+
+static void      transfer_next        (GSimpleAsyncResult *res);
+
 static void
 on_source_import_ready (GObject *object,
                         GAsyncResult *result,
@@ -67,10 +129,10 @@ on_source_import_ready (GObject *object,
 	GSimpleAsyncResult *res = G_SIMPLE_ASYNC_RESULT (user_data);
 	TransferClosure *closure = g_simple_async_result_get_op_res_gpointer (res);
 	GError *error = NULL;
+	GBytes *chunk;
 	GList *results;
 
 	g_debug ("[transfer] import done");
-	seahorse_progress_end (closure->cancellable, &closure->to);
 
 	if (SEAHORSE_IS_GPGME_KEYRING (closure->to)) {
 		results = seahorse_gpgme_keyring_import_finish (SEAHORSE_GPGME_KEYRING (closure->to),
@@ -85,10 +147,18 @@ on_source_import_ready (GObject *object,
 
 	g_list_free (results);
 
-	if (error != NULL)
-		g_simple_async_result_take_error (res, error);
+	if (error != NULL && closure->error == NULL)
+		closure->error = error;
+	else
+		g_clear_error (&error);
 
-	g_simple_async_result_complete (res);
+	/* The chunk just imported */
+	chunk = g_queue_pop_head (closure->chunks);
+	closure->buffered -= g_bytes_get_size (chunk);
+	g_bytes_unref (chunk);
+	closure->importing = FALSE;
+
+	transfer_next (res);
 	g_object_unref (user_data);
 }
 
@@ -101,11 +171,9 @@ on_source_export_ready (GObject *object,
 	TransferClosure *closure = g_simple_async_result_get_op_res_gpointer (res);
 	GError *error = NULL;
 	gpointer stream_data = NULL;
-	gsize stream_size;
-	GInputStream *input;
+	gsize stream_size = 0;
 
 	g_debug ("[transfer] export done");
-	seahorse_progress_end (closure->cancellable, &closure->from);
 
 	if (SEAHORSE_IS_SERVER_SOURCE (closure->from)) {
 		stream_data = seahorse_server_source_export_finish (SEAHORSE_SERVER_SOURCE (object),
@@ -122,72 +190,176 @@ on_source_export_ready (GObject *object,
 	if (error == NULL)
 		g_cancellable_set_error_if_cancelled (closure->cancellable, &error);
 
-	if (error == NULL) {
-		seahorse_progress_begin (closure->cancellable, &closure->to);
+	/* The other chunks may still be there */
+	if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND)) {
+		g_debug ("[transfer] no keys found in chunk");
+		if (closure->not_found == NULL)
+			closure->not_found = error;
+		else
+			g_clear_error (&error);
+		g_free (stream_data);
 
-		if (!stream_size) {
-			g_debug ("[transfer] nothing to import");
-			seahorse_progress_end (closure->cancellable, &closure->to);
-			g_simple_async_result_complete (res);
-
-		} else {
-			input = g_memory_input_stream_new_from_data (stream_data, stream_size, g_free);
-			stream_data = NULL;
-			stream_size = 0;
-
-			g_debug ("[transfer] starting import");
-			if (SEAHORSE_IS_GPGME_KEYRING (closure->to)) {
-				seahorse_gpgme_keyring_import_async (SEAHORSE_GPGME_KEYRING (closure->to),
-				                                     input, closure->cancellable,
-				                                     on_source_import_ready,
-				                                     g_object_ref (res));
-			} else {
-				seahorse_server_source_import_async (SEAHORSE_SERVER_SOURCE (closure->to),
-				                                     input, closure->cancellable,
-				                                     on_source_import_ready,
-				                                     g_object_ref (res));
-			}
-			g_object_unref (input);
-		}
+	} else if (error != NULL) {
+		g_debug ("[transfer] stopped after export");
+		if (closure->error == NULL)
+			closure->error = error;
+		else
+			g_clear_error (&error);
+		g_free (stream_data);
+
+	} else if (!stream_size) {
+		g_debug ("[transfer] nothing to import");
+		g_free (stream_data);
 
 	} else {
-		g_debug ("[transfer] stopped after export");
-		g_simple_async_result_take_error (res, error);
-		g_simple_async_result_complete (res);
+		g_queue_push_tail (closure->chunks, g_bytes_new_take (stream_data, stream_size));
+		closure->buffered += stream_size;
+		closure->received = TRUE;
 	}
 
-	g_free (stream_data);
+	closure->exporting = FALSE;
+	transfer_next (res);
 	g_object_unref (user_data);
 }
 
-static gboolean
-on_timeout_start_transfer (gpointer user_data)
+static void
+transfer_start_export (GSimpleAsyncResult *res)
 {
-	GSimpleAsyncResult *res = G_SIMPLE_ASYNC_RESULT (user_data);
 	TransferClosure *closure = g_simple_async_result_get_op_res_gpointer (res);
 	SeahorseExporter *exporter;
+	GList *keys = NULL;
+	gchar **keyids;
+	guint count, i;
+	GList *l;
 
-	g_assert (SEAHORSE_IS_PLACE (closure->from));
+	count = MIN (TRANSFER_CHUNK_KEYS, closure->n_items - closure->exported);
+	g_debug ("[transfer] exporting %u keys", count);
 
-	seahorse_progress_begin (closure->cancellable, &closure->from);
+	closure->exporting = TRUE;
 	if (SEAHORSE_IS_SERVER_SOURCE (closure->from)) {
 		g_assert (closure->keyids != NULL);
+		keyids = g_new0 (gchar *, count + 1);
+		for (i = 0; i < count; i++)
+			keyids[i] = closure->keyids[closure->exported + i];
 		seahorse_server_source_export_async (SEAHORSE_SERVER_SOURCE (closure->from),
-		                                     (const gchar **)closure->keyids,
+		                                     (const gchar **)keyids,
 		                                     closure->cancellable, on_source_export_ready,
 		                                     g_object_ref (res));
+		g_free (keyids);
 
 	} else if (SEAHORSE_IS_GPGME_KEYRING (closure->from)) {
 		g_assert (closure->keys != NULL);
-		exporter = seahorse_gpgme_exporter_new_multiple (closure->keys, TRUE);
+		l = g_list_nth (closure->keys, closure->exported);
+		for (i = 0; l != NULL && i < count; l = g_list_next (l), i++)
+			keys = g_list_prepend (keys, l->data);
+		keys = g_list_reverse (keys);
+		exporter = seahorse_gpgme_exporter_new_multiple (keys, TRUE);
 		seahorse_exporter_export (exporter, closure->cancellable,
 		                          on_source_export_ready, g_object_ref (res));
 		g_object_unref (exporter);
+		g_list_free (keys);
 
 	} else {
 		g_warning ("unsupported source for transfer: %s", G_OBJECT_TYPE_NAME (closure->from));
+		closure->exporting = FALSE;
+		count = closure->n_items - closure->exported;
+	}
+
+	closure->exported += count;
+}
+
+static void
+transfer_start_import (GSimpleAsyncResult *res)
+{
+	TransferClosure *closure = g_simple_async_result_get_op_res_gpointer (res);
+	GInputStream *input;
+
+	if (!closure->import_begun) {
+		seahorse_progress_begin (closure->cancellable, &closure->to);
+		closure->import_begun = TRUE;
+	}
+
+	/* Stays queued until the import is done, to count towards the buffer */
+	input = g_memory_input_stream_new_from_bytes (g_queue_peek_head (closure->chunks));
+	closure->importing = TRUE;
+
+	g_debug ("[transfer] starting import");
+	if (SEAHORSE_IS_GPGME_KEYRING (closure->to)) {
+		seahorse_gpgme_keyring_import_async (SEAHORSE_GPGME_KEYRING (closure->to),
+		                                     input, closure->cancellable,
+		                                     on_source_import_ready,
+		                                     g_object_ref (res));
+	} else {
+		seahorse_server_source_import_async (SEAHORSE_SERVER_SOURCE (closure->to),
+		                                     input, closure->cancellable,
+		                                     on_source_import_ready,
+		                                     g_object_ref (res));
+	}
+	g_object_unref (input);
+}
+
+static void
+transfer_next (GSimpleAsyncResult *res)
+{
+	TransferClosure *closure = g_simple_async_result_get_op_res_gpointer (res);
+	GBytes *chunk;
+
+	/* Stop exporting after an error, and drop what wasn't imported */
+	if (closure->error != NULL) {
+		while (g_queue_get_length (closure->chunks) > (closure->importing ? 1U : 0U)) {
+			chunk = g_queue_pop_tail (closure->chunks);
+			closure->buffered -= g_bytes_get_size (chunk);
+			g_bytes_unref (chunk);
+		}
+		closure->exported = closure->n_items;
+	}
+
+	if (!closure->importing && !g_queue_is_empty (closure->chunks))
+		transfer_start_import (res);
+
+	if (!closure->exporting && closure->exported < closure->n_items &&
+	    closure->buffered < closure->max_buffered)
+		transfer_start_export (res);
+
+	if (!closure->exporting && !closure->exported_all &&
+	    closure->exported == closure->n_items) {
+		seahorse_progress_end (closure->cancellable, &closure->from);
+		closure->exported_all = TRUE;
+	}
+
+	if (closure->exporting || closure->importing)
+		return;
+
+	/* All done */
+	if (!closure->import_begun)
+		seahorse_progress_begin (closure->cancellable, &closure->to);
+	seahorse_progress_end (closure->cancellable, &closure->to);
+
+	/* Only a failure when none of the keys were found */
+	if (closure->error == NULL && !closure->received) {
+		closure->error = closure->not_found;
+		closure->not_found = NULL;
 	}
 
+	if (closure->error) {
+		g_simple_async_result_take_error (res, closure->error);
+		closure->error = NULL;
+	}
+
+	g_simple_async_result_complete (res);
+}
+
+static gboolean
+on_timeout_start_transfer (gpointer user_data)
+{
+	GSimpleAsyncResult *res = G_SIMPLE_ASYNC_RESULT (user_data);
+	TransferClosure *closure = g_simple_async_result_get_op_res_gpointer (res);
+
+	g_assert (SEAHORSE_IS_PLACE (closure->from));
+
+	seahorse_progress_begin (closure->cancellable, &closure->from);
+	transfer_next (res);
+
 	return FALSE; /* Don't run again */
 }
 
@@ -220,6 +392,7 @@ seahorse_transfer_keys_async (SeahorsePlace *from,
 	closure->cancellable = cancellable ? g_object_ref (cancellable) : cancellable;
 	closure->from = g_object_ref (from);
 	closure->to = g_object_ref (to);
+	transfer_closure_init (closure);
 	g_simple_async_result_set_op_res_gpointer (res, closure, transfer_closure_free);
 
 	if (SEAHORSE_IS_GPGME_KEYRING (from)) {
@@ -228,11 +401,13 @@ seahorse_transfer_keys_async (SeahorsePlace *from,
 	} else {
 		keyids = g_ptr_array_new ();
 		for (l = keys; l != NULL; l = g_list_next (l))
-			g_ptr_array_add (keyids, g_strdup (seahorse_pgp_key_get_keyid (l->data)));
+			g_ptr_array_add (keyids, calc_transfer_keyid (l->data));
 		g_ptr_array_add (keyids, NULL);
 		closure->keyids = (gchar **)g_ptr_array_free (keyids, FALSE);
 	}
 
+	closure->n_items = g_list_length (keys);
+
 	seahorse_progress_prep (cancellable, &closure->from,
 	                        SEAHORSE_IS_GPGME_KEYRING (closure->from) ?
 	                        _("Exporting data") : _("Retrieving data"));
@@ -278,6 +453,8 @@ seahorse_transfer_keyids_async (SeahorseServerSource *from,
 	closure->from = g_object_ref (from);
 	closure->to = g_object_ref (to);
 	closure->keyids = g_strdupv ((gchar **)keyids);
+	closure->n_items = g_strv_length (closure->keyids);
+	transfer_closure_init (closure);
 	g_simple_async_result_set_op_res_gpointer (res, closure, transfer_closure_free);
 
 	seahorse_progress_prep (cancellable, &closure->from,
@@ -25,7 +25,8 @@ namespace Seahorse {
 namespace Pkcs11 {
 
 public class Certificate : Gck.Object, Gcr.Comparable, Gcr.Certificate,
-                           Gck.ObjectCache, Deletable, Exportable, Viewable {
+                           Gck.ObjectCache, Deletable, Exportable, Viewable,
+                           Matchable {
 	public Token? place {
 		owned get { return (Token?)this._token.get(); }
 		set { this._token.set(value); }
@@ -161,6 +162,15 @@ public class Certificate : Gck.Object, Gcr.Comparable, Gcr.Certificate,
 		return viewer;
 	}
 
+	// No usage property
+	public Usage get_match_usage() {
+		return Usage.NONE;
+	}
+
+	public Flags get_match_flags() {
+		return this.object_flags;
+	}
+
 	public Seahorse.Deleter create_deleter() {
 		Seahorse.Deleter deleter;
 
@@ -25,7 +25,8 @@ namespace Seahorse {
 namespace Pkcs11 {
 
 public class PrivateKey : Gck.Object, Gck.ObjectCache,
-                          Deletable, Exportable, Viewable {
+                          Deletable, Exportable, Viewable,
+                          Matchable {
 	public Token? place {
 		owned get { return (Token?)this._token.get(); }
 		set { this._token.set(value); }
@@ -126,6 +127,15 @@ public class PrivateKey : Gck.Object, Gck.ObjectCache,
 		viewer.show();
 		return viewer;
 	}
+
+	// No usage property
+	public Usage get_match_usage() {
+		return Usage.NONE;
+	}
+
+	public Flags get_match_flags() {
+		return this.object_flags;
+	}
 }
 
 }
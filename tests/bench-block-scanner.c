@@ -0,0 +1,222 @@
+/*
+ * Seahorse
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Measures splitting a large dump of armored keys into blocks, with
+ * SeahorseBlockScanner and with the byte at a time reader it replaced.
+ */
+
+#include "config.h"
+
+#include "libseahorse/seahorse-util.h"
+
+#include <gio/gio.h>
+
+#include <string.h>
+
+#define KEY_BEGIN "-----BEGIN PGP PUBLIC KEY BLOCK-----"
+#define KEY_END   "-----END PGP PUBLIC KEY BLOCK-----"
+
+static gint dump_size = 32;
+static gint iterations = 3;
+
+static const GOptionEntry options[] = {
+	{ "size", 0, 0, G_OPTION_ARG_INT, &dump_size, "Size of the key dump", "MB" },
+	{ "iterations", 0, 0, G_OPTION_ARG_INT, &iterations, "Times to split the dump", "N" },
+	{ NULL }
+};
+
+/* The reader as it was before SeahorseBlockScanner, for comparison */
+static guint
+legacy_read_data_block (GString *buf,
+                        GInputStream *input,
+                        const gchar *start,
+                        const gchar *end)
+{
+	const gchar *t;
+	guint copied = 0;
+	gchar ch;
+	gsize read;
+
+	t = start;
+	while (g_input_stream_read_all (input, &ch, 1, &read, NULL, NULL) && read == 1) {
+		if (*t == ch)
+			t++;
+		if (!*t) {
+			buf = g_string_append (buf, start);
+			copied += strlen (start);
+			break;
+		}
+	}
+
+	t = end;
+	while (g_input_stream_read_all (input, &ch, 1, &read, NULL, NULL) && read == 1) {
+		if (*t == ch)
+			t++;
+		buf = g_string_append_c (buf, ch);
+		copied++;
+		if (!*t)
+			break;
+	}
+
+	return copied;
+}
+
+/* Armored blocks of random base64 with some text between them, like an export */
+static GBytes *
+generate_dump (gsize size,
+               guint *n_blocks)
+{
+	static const gchar base64[] =
+		"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	GString *dump;
+	GRand *rand;
+	guint lines, i, j;
+
+	rand = g_rand_new_with_seed (0);
+	dump = g_string_sized_new (size + 8192);
+	*n_blocks = 0;
+
+	while (dump->len < size) {
+		g_string_append_printf (dump, "Key %u exported for the benchmark\n", *n_blocks);
+		g_string_append (dump, KEY_BEGIN "\n\n");
+		lines = g_rand_int_range (rand, 10, 60);
+		for (i = 0; i < lines; i++) {
+			for (j = 0; j < 64; j++)
+				g_string_append_c (dump, base64[g_rand_int_range (rand, 0, 64)]);
+			g_string_append_c (dump, '\n');
+		}
+		g_string_append (dump, "=AbCd\n" KEY_END "\n\n");
+		(*n_blocks)++;
+	}
+
+	g_rand_free (rand);
+	return g_string_free_to_bytes (dump);
+}
+
+static gdouble
+run_legacy (GBytes *dump,
+            guint *n_blocks,
+            gsize *n_copied)
+{
+	GInputStream *input;
+	GString *buf;
+	gint64 started;
+	guint copied;
+
+	input = g_memory_input_stream_new_from_bytes (dump);
+	buf = g_string_new (NULL);
+	*n_blocks = 0;
+	*n_copied = 0;
+
+	started = g_get_monotonic_time ();
+	for (;;) {
+		g_string_truncate (buf, 0);
+		copied = legacy_read_data_block (buf, input, KEY_BEGIN, KEY_END);
+		if (copied == 0)
+			break;
+		(*n_blocks)++;
+		*n_copied += copied;
+	}
+
+	g_string_free (buf, TRUE);
+	g_object_unref (input);
+	return (g_get_monotonic_time () - started) / (gdouble)G_USEC_PER_SEC;
+}
+
+static gdouble
+run_scanner (GBytes *dump,
+             guint *n_blocks,
+             gsize *n_copied)
+{
+	SeahorseBlockScanner *scanner;
+	GInputStream *input;
+	GError *error = NULL;
+	const gchar *block;
+	gsize n_block;
+	gint64 started;
+
+	input = g_memory_input_stream_new_from_bytes (dump);
+	*n_blocks = 0;
+	*n_copied = 0;
+
+	started = g_get_monotonic_time ();
+	scanner = seahorse_block_scanner_new (input, KEY_BEGIN, KEY_END);
+	while (seahorse_block_scanner_next (scanner, &block, &n_block, NULL, &error)) {
+		(*n_blocks)++;
+		*n_copied += n_block;
+	}
+	seahorse_block_scanner_free (scanner);
+
+	if (error != NULL) {
+		g_printerr ("scanner failed: %s\n", error->message);
+		g_error_free (error);
+	}
+
+	g_object_unref (input);
+	return (g_get_monotonic_time () - started) / (gdouble)G_USEC_PER_SEC;
+}
+
+int
+main (int argc,
+      char **argv)
+{
+	GOptionContext *context;
+	GError *error = NULL;
+	gdouble legacy = G_MAXDOUBLE;
+	gdouble scanner = G_MAXDOUBLE;
+	guint n_blocks, n_legacy, n_scanner;
+	gsize n_copied_legacy, n_copied_scanner;
+	gdouble megabytes;
+	GBytes *dump;
+	gint i;
+
+	context = g_option_context_new ("- benchmark splitting a key dump into blocks");
+	g_option_context_add_main_entries (context, options, NULL);
+	if (!g_option_context_parse (context, &argc, &argv, &error)) {
+		g_printerr ("%s\n", error->message);
+		return 2;
+	}
+	g_option_context_free (context);
+
+	dump = generate_dump ((gsize)MAX (dump_size, 1) * 1024 * 1024, &n_blocks);
+	megabytes = g_bytes_get_size (dump) / (1024.0 * 1024.0);
+
+	/* Best of several runs */
+	for (i = 0; i < MAX (iterations, 1); i++) {
+		legacy = MIN (legacy, run_legacy (dump, &n_legacy, &n_copied_legacy));
+		scanner = MIN (scanner, run_scanner (dump, &n_scanner, &n_copied_scanner));
+	}
+
+	g_print ("dump: %.1f MB, %u blocks\n", megabytes, n_blocks);
+	g_print ("byte at a time: %u blocks, %.3f s, %.1f MB/s\n",
+	         n_legacy, legacy, megabytes / legacy);
+	g_print ("block scanner: %u blocks, %.3f s, %.1f MB/s (%.1fx)\n",
+	         n_scanner, scanner, megabytes / scanner, legacy / scanner);
+
+	g_bytes_unref (dump);
+
+	if (n_legacy != n_blocks || n_scanner != n_blocks ||
+	    n_copied_legacy != n_copied_scanner) {
+		g_printerr ("readers disagree: %u and %u blocks, %" G_GSIZE_FORMAT
+		            " and %" G_GSIZE_FORMAT " bytes\n", n_legacy, n_scanner,
+		            n_copied_legacy, n_copied_scanner);
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,157 @@
+/*
+ * Seahorse
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Measures hiding and showing half of a large collection at once, in a
+ * sorted tree view set up like the key manager's, with the view following
+ * every row and with the view detached for the lot as KeyManagerStore does.
+ */
+
+static int n_objects = 20000;
+static int iterations = 3;
+
+const OptionEntry[] options = {
+    { "objects", 0, 0, OptionArg.INT, ref n_objects, "Objects in the collection", "N" },
+    { "iterations", 0, 0, OptionArg.INT, ref iterations, "Times to hide and show", "N" },
+    { null }
+};
+
+// Whether the predicate lets the hidden half through
+static bool show_all = true;
+
+static bool on_match(GLib.Object obj, void* custom_target) {
+    return show_all || !((Seahorse.Object) obj).label.has_prefix("Hidden");
+}
+
+private class BenchStore : Gcr.CollectionModel {
+    private const uint BULK_CHANGE_ROWS = 100;
+
+    private static Gcr.Column[] _columns = {
+        Gcr.Column() { property_name = "label", property_type = typeof(string), column_type = typeof(string) },
+        Gcr.Column()
+    };
+
+    private Gtk.TreeView? view;
+    private Gtk.TreeModel? detached_model;
+
+    construct {
+        set("columns", _columns,
+            "mode", Gcr.CollectionModelMode.LIST,
+            null);
+    }
+
+    public BenchStore(Seahorse.Collection collection) {
+        GLib.Object(collection: collection);
+    }
+
+    // As KeyManagerStore.detach_view() and reattach_view()
+    public void detach_during_changes(Gtk.TreeView view) {
+        this.view = view;
+        Seahorse.Collection collection = (Seahorse.Collection) get_collection();
+        collection.changes_started.connect((n_added, n_removed) => {
+            if (this.detached_model != null || n_added + n_removed < BULK_CHANGE_ROWS)
+                return;
+            this.detached_model = this.view.model;
+            this.view.model = null;
+        });
+        collection.changes_finished.connect(() => {
+            if (this.detached_model == null)
+                return;
+            this.view.model = this.detached_model;
+            this.detached_model = null;
+        });
+    }
+}
+
+static void drain_events() {
+    while (Gtk.events_pending())
+        Gtk.main_iteration();
+}
+
+// Best time in milliseconds to hide and then show the hidden half again
+static double run(Gcr.Collection objects, bool detach, out int n_rows) {
+    show_all = true;
+
+    Seahorse.Predicate pred = Seahorse.Predicate();
+    pred.custom = on_match;
+    Seahorse.Collection filtered = new Seahorse.Collection.for_predicate(objects, pred, null);
+
+    BenchStore store = new BenchStore(filtered);
+    Seahorse.SortKeys sort_keys = new Seahorse.SortKeys(objects);
+    Gtk.TreeModelSort sorted = new Gtk.TreeModelSort.with_model(store);
+    sorted.set_sort_func(0, sort_keys.compare_rows);
+    sorted.set_sort_column_id(0, Gtk.SortType.ASCENDING);
+
+    Gtk.TreeView view = new Gtk.TreeView.with_model(sorted);
+    view.insert_column_with_attributes(-1, "", new Gtk.CellRendererText(), "text", 0, null);
+    Gtk.ScrolledWindow scrolled = new Gtk.ScrolledWindow(null, null);
+    scrolled.add(view);
+    Gtk.OffscreenWindow window = new Gtk.OffscreenWindow();
+    window.set_default_size(600, 800);
+    window.add(scrolled);
+    window.show_all();
+    drain_events();
+
+    if (detach)
+        store.detach_during_changes(view);
+
+    double best = double.MAX;
+    for (int i = 0; i < int.max(iterations, 1); i++) {
+        int64 started = get_monotonic_time();
+        show_all = false;
+        filtered.refresh();
+        drain_events();
+        show_all = true;
+        filtered.refresh();
+        drain_events();
+        best = double.min(best, (get_monotonic_time() - started) / 1000.0);
+    }
+
+    n_rows = view.model.iter_n_children(null);
+    window.destroy();
+    return best;
+}
+
+public int main(string[] args) {
+    if (!Bench.parse_options("- benchmark many rows changing at once", options, ref args))
+        return 2;
+
+    if (!Gtk.init_check(ref args)) {
+        printerr("no display, skipping\n");
+        return 77;
+    }
+
+    Gcr.SimpleCollection objects = new Gcr.SimpleCollection();
+    for (int i = 0; i < n_objects; i++) {
+        Seahorse.Object obj = new Seahorse.Object();
+        obj.label = "%s User %d <mock%d@example.org>".printf(i % 2 == 0? "Mock" : "Hidden", i, i);
+        objects.add(obj);
+    }
+
+    int attached_rows, detached_rows;
+    double attached = run(objects, false, out attached_rows);
+    double detached = run(objects, true, out detached_rows);
+
+    print("hide and show %d of %d rows: view attached %.1f ms, view detached %.1f ms %s\n",
+          n_objects / 2, n_objects, attached, detached, Bench.speedup(attached, detached));
+
+    // Both views end up showing everything again
+    if (attached_rows != n_objects || detached_rows != n_objects)
+        return Bench.disagree("views disagree: %d and %d rows of %d", attached_rows, detached_rows, n_objects);
+
+    return 0;
+}
@@ -0,0 +1,113 @@
+/*
+ * Seahorse
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Measures filtering a large collection as the filter text is typed, one
+ * keystroke at a time, with FilterIndex and with lowercasing the label of
+ * every object on each keystroke as the key manager used to.
+ */
+
+static int n_objects = 60000;
+static int n_changes = 100;
+static string? typed = null;
+
+const OptionEntry[] options = {
+    { "objects", 0, 0, OptionArg.INT, ref n_objects, "Objects in the collection", "N" },
+    { "changes", 0, 0, OptionArg.INT, ref n_changes, "Labels changed between searches", "N" },
+    { "text", 0, 0, OptionArg.STRING, ref typed, "Filter text to type", "TEXT" },
+    { null }
+};
+
+// Matching as the key manager did before FilterIndex
+static int naive_search(Gcr.Collection collection, string text) {
+    int count = 0;
+    foreach (weak GLib.Object obj in collection.get_objects()) {
+        string? name = null;
+        obj.get("label", out name, null);
+        if (name != null && (text in name.down()))
+            count++;
+    }
+    return count;
+}
+
+static Seahorse.Object make_object(int i) {
+    Seahorse.Object obj = new Seahorse.Object();
+    obj.label = "Mock User %d <mock%d@example.org>".printf(i, i);
+    return obj;
+}
+
+// Milliseconds per keystroke, typing the text one character at a time
+static double type_text(string text, bool indexed, Seahorse.FilterIndex index,
+                        Gcr.Collection collection, out int last_count) {
+    int keystrokes = 0;
+    int64 started = get_monotonic_time();
+    last_count = 0;
+
+    int offset = 0;
+    unichar c;
+    while (text.get_next_char(ref offset, out c)) {
+        string prefix = text.substring(0, offset);
+        if (indexed)
+            last_count = (int) index.search(Seahorse.FilterIndex.fold(prefix)).length;
+        else
+            last_count = naive_search(collection, prefix.down());
+        keystrokes++;
+    }
+
+    return (get_monotonic_time() - started) / 1000.0 / int.max(keystrokes, 1);
+}
+
+public int main(string[] args) {
+    if (!Bench.parse_options("- benchmark filtering a large collection", options, ref args))
+        return 2;
+
+    if (typed == null)
+        typed = "mock user %d".printf(n_objects / 2);
+
+    Gcr.SimpleCollection collection = new Gcr.SimpleCollection();
+    Seahorse.Object[] objects = {};
+    for (int i = 0; i < n_objects; i++) {
+        objects += make_object(i);
+        collection.add(objects[i]);
+    }
+
+    int64 started = get_monotonic_time();
+    Seahorse.FilterIndex index = new Seahorse.FilterIndex(collection);
+    print("index: %d objects in %.1f ms\n", n_objects, (get_monotonic_time() - started) / 1000.0);
+
+    int naive_count, indexed_count;
+    double naive = type_text(typed, false, index, collection, out naive_count);
+    double indexed = type_text(typed, true, index, collection, out indexed_count);
+    print("typing \"%s\": lowercase every label %.2f ms per keystroke, index %.2f ms per keystroke %s\n",
+          typed, naive, indexed, Bench.speedup(naive, indexed));
+
+    // Relabelled objects are reindexed by the next search
+    Rand rand = new Rand.with_seed(0);
+    started = get_monotonic_time();
+    for (int i = 0; i < n_changes && n_objects > 0; i++) {
+        int at = rand.int_range(0, n_objects);
+        objects[at].label = "Changed User %d <changed%d@example.org>".printf(at, i);
+    }
+    index.search(Seahorse.FilterIndex.fold("changed user"));
+    print("refresh: %d changed labels and a search in %.2f ms\n",
+          n_changes, (get_monotonic_time() - started) / 1000.0);
+
+    if (naive_count != indexed_count)
+        return Bench.disagree("searches disagree: %d and %d matches", naive_count, indexed_count);
+
+    return 0;
+}
@@ -0,0 +1,267 @@
+/*
+ * Seahorse
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Measures the HKP source against the mock key server: the latency of
+ * searches, and the throughput of bulk exports and uploads.
+ */
+
+#include "config.h"
+
+#include "mock-hkp-server.h"
+
+#include "seahorse-hkp-source.h"
+#include "seahorse-pgp-armor.h"
+
+#include "seahorse-common.h"
+
+#include <gio/gio.h>
+
+#include <stdlib.h>
+
+static gint n_keys = 5000;
+static gint key_bits = 2048;
+static gint n_uids = 2;
+static gint latency = 0;
+static gdouble error_rate = 0.0;
+static gint max_results = 0;
+static gint n_searches = 100;
+static gint n_exports = 1000;
+static gint n_uploads = 1000;
+
+static const GOptionEntry options[] = {
+	{ "keys", 0, 0, G_OPTION_ARG_INT, &n_keys, "Keys on the server", "N" },
+	{ "bits", 0, 0, G_OPTION_ARG_INT, &key_bits, "Size of the generated keys", "BITS" },
+	{ "uids", 0, 0, G_OPTION_ARG_INT, &n_uids, "User ids per generated key", "N" },
+	{ "latency", 0, 0, G_OPTION_ARG_INT, &latency, "Server latency per request", "MS" },
+	{ "error-rate", 0, 0, G_OPTION_ARG_DOUBLE, &error_rate, "Fraction of requests that fail", "RATE" },
+	{ "max-results", 0, 0, G_OPTION_ARG_INT, &max_results, "Most keys a search may return", "N" },
+	{ "searches", 0, 0, G_OPTION_ARG_INT, &n_searches, "Searches to time", "N" },
+	{ "exports", 0, 0, G_OPTION_ARG_INT, &n_exports, "Keys to export in bulk", "N" },
+	{ "uploads", 0, 0, G_OPTION_ARG_INT, &n_uploads, "Keys to upload in bulk", "N" },
+	{ NULL }
+};
+
+static void
+on_async_ready (GObject *source,
+                GAsyncResult *result,
+                gpointer user_data)
+{
+	GAsyncResult **ret = user_data;
+	*ret = g_object_ref (result);
+}
+
+static GAsyncResult *
+wait_for_result (GAsyncResult **result)
+{
+	while (*result == NULL)
+		g_main_context_iteration (NULL, TRUE);
+	return *result;
+}
+
+static int
+compare_times (gconstpointer a,
+               gconstpointer b)
+{
+	gint64 ta = *(const gint64 *)a;
+	gint64 tb = *(const gint64 *)b;
+	return (ta > tb) - (ta < tb);
+}
+
+static void
+bench_search (SeahorseServerSource *source,
+              GRand *rand)
+{
+	GcrSimpleCollection *results;
+	GAsyncResult *result;
+	GError *error = NULL;
+	gint64 *times;
+	gint64 started, total = 0;
+	guint failed = 0;
+	gchar *match;
+	gint i;
+
+	if (n_searches <= 0)
+		return;
+
+	times = g_new0 (gint64, n_searches);
+	for (i = 0; i < n_searches; i++) {
+		match = g_strdup_printf ("mock%u@example.org",
+		                         g_rand_int_range (rand, 0, MAX (n_keys, 1)));
+		results = GCR_SIMPLE_COLLECTION (gcr_simple_collection_new ());
+		result = NULL;
+
+		started = g_get_monotonic_time ();
+		seahorse_server_source_search_async (source, match, results, NULL,
+		                                     on_async_ready, &result);
+		if (!seahorse_server_source_search_finish (source, wait_for_result (&result), &error)) {
+			g_clear_error (&error);
+			failed++;
+		}
+		times[i] = g_get_monotonic_time () - started;
+		total += times[i];
+
+		g_object_unref (result);
+		g_object_unref (results);
+		g_free (match);
+	}
+
+	qsort (times, n_searches, sizeof (gint64), compare_times);
+	g_print ("search: %d searches, %u failed, mean %.2f ms, median %.2f ms, "
+	         "p95 %.2f ms, max %.2f ms\n", n_searches, failed,
+	         total / 1000.0 / n_searches, times[n_searches / 2] / 1000.0,
+	         times[(n_searches * 95) / 100] / 1000.0, times[n_searches - 1] / 1000.0);
+	g_free (times);
+}
+
+static void
+bench_export (SeahorseServerSource *source,
+              MockHkpServer *server)
+{
+	const gchar **keyids;
+	GAsyncResult *result = NULL;
+	GError *error = NULL;
+	gpointer data;
+	gsize n_data = 0;
+	gdouble seconds;
+	gint64 started;
+	gint count, i;
+
+	count = MIN (n_exports, (gint)mock_hkp_server_get_n_keys (server));
+	if (count <= 0)
+		return;
+
+	keyids = g_new0 (const gchar *, count + 1);
+	for (i = 0; i < count; i++)
+		keyids[i] = mock_hkp_server_get_fingerprint (server, i);
+
+	started = g_get_monotonic_time ();
+	seahorse_server_source_export_async (source, keyids, NULL, on_async_ready, &result);
+	data = seahorse_server_source_export_finish (source, wait_for_result (&result),
+	                                             &n_data, &error);
+	seconds = (g_get_monotonic_time () - started) / (gdouble)G_USEC_PER_SEC;
+
+	g_print ("export: %d keys, %" G_GSIZE_FORMAT " bytes in %.3f s, "
+	         "%.1f keys/s, %.2f MB/s%s%s\n", count, n_data, seconds,
+	         count / seconds, n_data / seconds / (1024 * 1024),
+	         error ? ", failed: " : "", error ? error->message : "");
+
+	g_clear_error (&error);
+	g_object_unref (result);
+	g_free (keyids);
+	g_free (data);
+}
+
+static void
+bench_upload (SeahorseServerSource *source)
+{
+	GAsyncResult *result = NULL;
+	GError *error = NULL;
+	GInputStream *input;
+	GString *armored;
+	gconstpointer data;
+	gdouble seconds;
+	gint64 started;
+	gsize n_data;
+	GBytes *key;
+	gint i;
+
+	if (n_uploads <= 0)
+		return;
+
+	/* Keys from another seed, so the server doesn't already have them */
+	armored = g_string_new (NULL);
+	for (i = 0; i < n_uploads; i++) {
+		key = mock_hkp_corpus_generate_key (1, i, key_bits, n_uids);
+		data = g_bytes_get_data (key, &n_data);
+		seahorse_pgp_armor_append (armored, data, n_data);
+		g_bytes_unref (key);
+	}
+
+	input = g_memory_input_stream_new_from_data (armored->str, armored->len, NULL);
+
+	started = g_get_monotonic_time ();
+	seahorse_server_source_import_async (source, input, NULL, on_async_ready, &result);
+	seahorse_server_source_import_finish (source, wait_for_result (&result), &error);
+	seconds = (g_get_monotonic_time () - started) / (gdouble)G_USEC_PER_SEC;
+
+	g_print ("upload: %d keys, %" G_GSIZE_FORMAT " bytes in %.3f s, "
+	         "%.1f keys/s, %.2f MB/s%s%s\n", n_uploads, armored->len, seconds,
+	         n_uploads / seconds, armored->len / seconds / (1024 * 1024),
+	         error ? ", failed: " : "", error ? error->message : "");
+
+	g_clear_error (&error);
+	g_object_unref (result);
+	g_object_unref (input);
+	g_string_free (armored, TRUE);
+}
+
+int
+main (int argc,
+      char **argv)
+{
+	SeahorseServerSource *source;
+	GOptionContext *context;
+	MockHkpServer *server;
+	GError *error = NULL;
+	GRand *rand;
+	gchar *uri;
+
+	context = g_option_context_new ("- benchmark the HKP key server source");
+	g_option_context_add_main_entries (context, options, NULL);
+	if (!g_option_context_parse (context, &argc, &argv, &error)) {
+		g_printerr ("%s\n", error->message);
+		return 2;
+	}
+	g_option_context_free (context);
+
+	/* Every request should reach the mock server */
+	seahorse_app_settings_set_keyserver_cache_size (seahorse_app_settings_instance (), 0);
+
+	server = mock_hkp_server_new (&error);
+	if (server == NULL) {
+		g_printerr ("couldn't start the mock key server: %s\n", error->message);
+		return 1;
+	}
+
+	mock_hkp_server_generate (server, MAX (n_keys, 0), key_bits, n_uids);
+	mock_hkp_server_set_latency (server, MAX (latency, 0));
+	mock_hkp_server_set_error_rate (server, error_rate);
+	mock_hkp_server_set_max_results (server, MAX (max_results, 0));
+
+	uri = g_strdup_printf ("hkp://%s", mock_hkp_server_get_host (server));
+	source = SEAHORSE_SERVER_SOURCE (seahorse_hkp_source_new (uri, mock_hkp_server_get_host (server)));
+	g_free (uri);
+
+	g_print ("server: %d keys of %d bits, %d ms latency, %.0f%% errors\n",
+	         n_keys, key_bits, latency, error_rate * 100);
+
+	rand = g_rand_new_with_seed (0);
+	bench_search (source, rand);
+	bench_export (source, server);
+	bench_upload (source);
+	g_rand_free (rand);
+
+	g_print ("totals: %u requests, %u failed, %" G_GUINT64_FORMAT " bytes sent, %"
+	         G_GUINT64_FORMAT " bytes received\n",
+	         mock_hkp_server_get_n_requests (server), mock_hkp_server_get_n_errors (server),
+	         mock_hkp_server_get_bytes_sent (server), mock_hkp_server_get_bytes_received (server));
+
+	g_object_unref (source);
+	mock_hkp_server_free (server);
+	return 0;
+}
@@ -0,0 +1,999 @@
+/*
+ * Seahorse
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Measures the LDAP source against a slapd started just for the run: the
+ * round trip latency of searches, and the throughput of bulk exports and
+ * uploads. The keys come from the mock key server's corpus. Without a
+ * slapd to run, the benchmark is skipped.
+ *
+ * It also counts the allocations made while pulling the attributes out
+ * of search entries, the way the source does it and the way it did with
+ * ldap_get_values_len(), on the same search result.
+ */
+
+#include "config.h"
+
+#include "mock-hkp-server.h"
+
+#include "seahorse-ldap-source.h"
+#include "seahorse-pgp-armor.h"
+
+#include "seahorse-common.h"
+
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+
+#include <ldap.h>
+
+#include <errno.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* The exit status meson takes as a skipped test */
+#define EXIT_SKIPPED 77
+
+#define KEYSPACE_DN "cn=PGPServerInfo"
+#define ROOT_DN     "cn=admin," KEYSPACE_DN
+#define ROOT_PW     "bench"
+
+static gchar *slapd_path = NULL;
+static gint n_keys = 1000;
+static gint key_bits = 2048;
+static gint n_uids = 2;
+static gint n_searches = 100;
+static gint n_exports = 500;
+static gint n_uploads = 1000;
+static gint n_parses = 20;
+
+static const GOptionEntry options[] = {
+	{ "slapd", 0, 0, G_OPTION_ARG_FILENAME, &slapd_path, "The slapd to run", "PATH" },
+	{ "keys", 0, 0, G_OPTION_ARG_INT, &n_keys, "Keys on the server", "N" },
+	{ "bits", 0, 0, G_OPTION_ARG_INT, &key_bits, "Size of the generated keys", "BITS" },
+	{ "uids", 0, 0, G_OPTION_ARG_INT, &n_uids, "User ids per generated key", "N" },
+	{ "searches", 0, 0, G_OPTION_ARG_INT, &n_searches, "Searches to time", "N" },
+	{ "exports", 0, 0, G_OPTION_ARG_INT, &n_exports, "Keys to export in bulk", "N" },
+	{ "uploads", 0, 0, G_OPTION_ARG_INT, &n_uploads, "Keys to upload in bulk", "N" },
+	{ "parses", 0, 0, G_OPTION_ARG_INT, &n_parses, "Times to parse the search result", "N" },
+	{ NULL }
+};
+
+/*
+ * Only the parts of the PGP key server schema the source uses. The server
+ * info entry is also the base of the key space, so no other schema is needed.
+ */
+static const gchar SLAPD_SCHEMA[] =
+	"attributetype ( 2.5.4.3 NAME ( 'cn' 'commonName' )\n"
+	"  EQUALITY caseIgnoreMatch SUBSTR caseIgnoreSubstringsMatch\n"
+	"  SYNTAX 1.3.6.1.4.1.1466.115.121.1.15 )\n"
+	"attributetype ( 1.3.6.1.4.1.3401.8.2.8 NAME 'pgpBaseKeySpaceDN'\n"
+	"  EQUALITY distinguishedNameMatch SYNTAX 1.3.6.1.4.1.1466.115.121.1.12 SINGLE-VALUE )\n"
+	"attributetype ( 1.3.6.1.4.1.3401.8.2.9 NAME 'pgpSoftware'\n"
+	"  EQUALITY caseIgnoreMatch SYNTAX 1.3.6.1.4.1.1466.115.121.1.15 SINGLE-VALUE )\n"
+	"attributetype ( 1.3.6.1.4.1.3401.8.2.10 NAME 'pgpVersion'\n"
+	"  EQUALITY caseIgnoreMatch SYNTAX 1.3.6.1.4.1.1466.115.121.1.15 SINGLE-VALUE )\n"
+	"attributetype ( 1.3.6.1.4.1.3401.8.2.11 NAME 'pgpKey'\n"
+	"  SYNTAX 1.3.6.1.4.1.1466.115.121.1.26 SINGLE-VALUE )\n"
+	"attributetype ( 1.3.6.1.4.1.3401.8.2.12 NAME 'pgpCertID'\n"
+	"  EQUALITY caseIgnoreMatch SYNTAX 1.3.6.1.4.1.1466.115.121.1.15 SINGLE-VALUE )\n"
+	"attributetype ( 1.3.6.1.4.1.3401.8.2.13 NAME 'pgpDisabled'\n"
+	"  EQUALITY caseIgnoreMatch SYNTAX 1.3.6.1.4.1.1466.115.121.1.15 SINGLE-VALUE )\n"
+	"attributetype ( 1.3.6.1.4.1.3401.8.2.14 NAME 'pgpKeyID'\n"
+	"  EQUALITY caseIgnoreMatch SYNTAX 1.3.6.1.4.1.1466.115.121.1.15 SINGLE-VALUE )\n"
+	"attributetype ( 1.3.6.1.4.1.3401.8.2.15 NAME 'pgpKeyType'\n"
+	"  EQUALITY caseIgnoreMatch SYNTAX 1.3.6.1.4.1.1466.115.121.1.15 SINGLE-VALUE )\n"
+	"attributetype ( 1.3.6.1.4.1.3401.8.2.16 NAME 'pgpUserID'\n"
+	"  EQUALITY caseIgnoreMatch SUBSTR caseIgnoreSubstringsMatch\n"
+	"  SYNTAX 1.3.6.1.4.1.1466.115.121.1.15 )\n"
+	"attributetype ( 1.3.6.1.4.1.3401.8.2.17 NAME 'pgpKeyCreateTime'\n"
+	"  EQUALITY caseIgnoreMatch SYNTAX 1.3.6.1.4.1.1466.115.121.1.15 SINGLE-VALUE )\n"
+	"attributetype ( 1.3.6.1.4.1.3401.8.2.19 NAME 'pgpRevoked'\n"
+	"  EQUALITY caseIgnoreMatch SYNTAX 1.3.6.1.4.1.1466.115.121.1.15 SINGLE-VALUE )\n"
+	"attributetype ( 1.3.6.1.4.1.3401.8.2.21 NAME 'pgpKeySize'\n"
+	"  EQUALITY caseIgnoreMatch SYNTAX 1.3.6.1.4.1.1466.115.121.1.15 SINGLE-VALUE )\n"
+	"attributetype ( 1.3.6.1.4.1.3401.8.2.22 NAME 'pgpKeyExpireTime'\n"
+	"  EQUALITY caseIgnoreMatch SYNTAX 1.3.6.1.4.1.1466.115.121.1.15 SINGLE-VALUE )\n"
+	"objectclass ( 1.3.6.1.4.1.3401.8.2.23 NAME 'pgpServerInfo' SUP top STRUCTURAL\n"
+	"  MUST ( cn $ pgpBaseKeySpaceDN ) MAY ( pgpSoftware $ pgpVersion ) )\n"
+	"objectclass ( 1.3.6.1.4.1.3401.8.2.24 NAME 'pgpKeyInfo' SUP top STRUCTURAL\n"
+	"  MUST ( pgpCertID $ pgpKey )\n"
+	"  MAY ( pgpDisabled $ pgpKeyID $ pgpKeyType $ pgpUserID $ pgpKeyCreateTime $\n"
+	"        pgpRevoked $ pgpKeySize $ pgpKeyExpireTime ) )\n";
+
+#ifdef __GLIBC__
+
+/* Counts allocations while counting is on, and leaves them to glibc */
+extern void *__libc_malloc (size_t size);
+extern void *__libc_calloc (size_t n_members, size_t size);
+extern void *__libc_realloc (void *ptr, size_t size);
+
+static volatile gint counting = 0;
+static gint n_allocations = 0;
+
+void *
+malloc (size_t size)
+{
+	if (counting)
+		g_atomic_int_inc (&n_allocations);
+	return __libc_malloc (size);
+}
+
+void *
+calloc (size_t n_members,
+        size_t size)
+{
+	if (counting)
+		g_atomic_int_inc (&n_allocations);
+	return __libc_calloc (n_members, size);
+}
+
+void *
+realloc (void *ptr,
+         size_t size)
+{
+	if (counting)
+		g_atomic_int_inc (&n_allocations);
+	return __libc_realloc (ptr, size);
+}
+
+#define HAVE_ALLOCATION_COUNTS 1
+
+static void
+allocations_begin (void)
+{
+	n_allocations = 0;
+	counting = 1;
+}
+
+static guint
+allocations_end (void)
+{
+	counting = 0;
+	return n_allocations;
+}
+
+#endif /* __GLIBC__ */
+
+typedef struct {
+	GSubprocess *process;
+	gchar *directory;
+	gchar *host;
+	GPtrArray *keyids;
+} Slapd;
+
+static gchar *
+find_slapd (void)
+{
+	static const gchar *places[] = {
+		"/usr/sbin/slapd",
+		"/usr/libexec/slapd",
+		"/usr/local/libexec/slapd",
+		NULL
+	};
+	gchar *path;
+	guint i;
+
+	if (slapd_path)
+		return g_strdup (slapd_path);
+
+	path = g_find_program_in_path ("slapd");
+	for (i = 0; path == NULL && places[i] != NULL; i++) {
+		if (g_file_test (places[i], G_FILE_TEST_IS_EXECUTABLE))
+			path = g_strdup (places[i]);
+	}
+
+	return path;
+}
+
+static guint
+find_free_port (GError **error)
+{
+	GSocketListener *listener;
+	guint16 port;
+
+	listener = g_socket_listener_new ();
+	port = g_socket_listener_add_any_inet_port (listener, NULL, error);
+	g_socket_listener_close (listener);
+	g_object_unref (listener);
+
+	return port;
+}
+
+/* Where a slapd built with modules keeps the null backend, if it does */
+static gchar *
+find_null_backend (void)
+{
+	static const gchar *places[] = {
+		"/usr/lib/ldap",
+		"/usr/lib64/openldap",
+		"/usr/lib/openldap",
+		"/usr/libexec/openldap",
+		"/usr/local/libexec/openldap",
+		NULL
+	};
+	gchar *path;
+	guint i;
+
+	for (i = 0; places[i] != NULL; i++) {
+		path = g_build_filename (places[i], "back_null.la", NULL);
+		if (!g_file_test (path, G_FILE_TEST_EXISTS)) {
+			g_free (path);
+			path = g_build_filename (places[i], "back_null.so", NULL);
+		}
+		if (g_file_test (path, G_FILE_TEST_EXISTS)) {
+			g_free (path);
+			return g_strdup (places[i]);
+		}
+		g_free (path);
+	}
+
+	return NULL;
+}
+
+static void
+remove_directory (const gchar *directory)
+{
+	const gchar *name;
+	gchar *path;
+	GDir *dir;
+
+	dir = g_dir_open (directory, 0, NULL);
+	if (dir != NULL) {
+		while ((name = g_dir_read_name (dir)) != NULL) {
+			path = g_build_filename (directory, name, NULL);
+			if (g_file_test (path, G_FILE_TEST_IS_DIR))
+				remove_directory (path);
+			else
+				g_unlink (path);
+			g_free (path);
+		}
+		g_dir_close (dir);
+	}
+
+	g_rmdir (directory);
+}
+
+static gchar *
+write_slapd_config (const gchar *directory,
+                    GError **error)
+{
+	GString *config;
+	gchar *modules;
+	gchar *data;
+	gchar *path;
+
+	data = g_build_filename (directory, "data", NULL);
+	if (g_mkdir (data, 0700) < 0) {
+		g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+		             "couldn't create %s: %s", data, g_strerror (errno));
+		g_free (data);
+		return NULL;
+	}
+
+	config = g_string_new (SLAPD_SCHEMA);
+	g_string_append (config, "\naccess to * by * write\n");
+
+	modules = find_null_backend ();
+	if (modules != NULL)
+		g_string_append_printf (config, "\nmodulepath \"%s\"\n"
+		                        "moduleload back_null\n", modules);
+	g_free (modules);
+
+	/*
+	 * A real key server takes uploads to this virtual entry and files the
+	 * key under its own cert id. Here they're accepted and dropped, so
+	 * the upload measures the round trips and not slapd's storage.
+	 */
+	g_string_append (config, "\ndatabase null\n"
+	                 "suffix \"pgpCertID=virtual," KEYSPACE_DN "\"\n");
+
+	g_string_append_printf (config, "\ndatabase ldif\n"
+	                        "suffix \"" KEYSPACE_DN "\"\n"
+	                        "directory \"%s\"\n"
+	                        "rootdn \"" ROOT_DN "\"\n"
+	                        "rootpw " ROOT_PW "\n", data);
+
+	path = g_build_filename (directory, "slapd.conf", NULL);
+	if (!g_file_set_contents (path, config->str, config->len, error)) {
+		g_free (path);
+		path = NULL;
+	}
+
+	g_string_free (config, TRUE);
+	g_free (data);
+	return path;
+}
+
+/* Waits until slapd takes a bind from its root dn, and returns the connection */
+static LDAP *
+connect_slapd (Slapd *slapd,
+               GError **error)
+{
+	struct berval cred;
+	LDAP *ldap = NULL;
+	gchar *url;
+	gint version = LDAP_VERSION3;
+	gint tries;
+	int rc = LDAP_SERVER_DOWN;
+
+	url = g_strdup_printf ("ldap://%s", slapd->host);
+	cred.bv_val = ROOT_PW;
+	cred.bv_len = strlen (ROOT_PW);
+
+	for (tries = 0; tries < 100; tries++) {
+		if (g_subprocess_get_identifier (slapd->process) == NULL)
+			break;
+
+		rc = ldap_initialize (&ldap, url);
+		if (rc == LDAP_SUCCESS) {
+			ldap_set_option (ldap, LDAP_OPT_PROTOCOL_VERSION, &version);
+			rc = ldap_sasl_bind_s (ldap, ROOT_DN, LDAP_SASL_SIMPLE, &cred,
+			                       NULL, NULL, NULL);
+			if (rc == LDAP_SUCCESS)
+				break;
+			ldap_unbind_ext_s (ldap, NULL, NULL);
+			ldap = NULL;
+		}
+
+		g_usleep (G_USEC_PER_SEC / 10);
+	}
+
+	if (ldap == NULL)
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+		             "slapd didn't start: %s", ldap_err2string (rc));
+
+	g_free (url);
+	return ldap;
+}
+
+static gboolean
+add_entry (LDAP *ldap,
+           const gchar *dn,
+           LDAPMod **mods,
+           GError **error)
+{
+	int rc;
+
+	rc = ldap_add_ext_s (ldap, dn, mods, NULL, NULL);
+	if (rc != LDAP_SUCCESS) {
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+		             "couldn't add %s: %s", dn, ldap_err2string (rc));
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static gboolean
+add_server_info (LDAP *ldap,
+                 GError **error)
+{
+	char *object_class[] = { "pgpServerInfo", NULL };
+	char *cn[] = { "PGPServerInfo", NULL };
+	char *base[] = { KEYSPACE_DN, NULL };
+	LDAPMod mods[3] = {
+		{ LDAP_MOD_ADD, "objectClass", { object_class } },
+		{ LDAP_MOD_ADD, "cn", { cn } },
+		{ LDAP_MOD_ADD, "pgpBaseKeySpaceDN", { base } },
+	};
+	LDAPMod *attrs[] = { &mods[0], &mods[1], &mods[2], NULL };
+
+	return add_entry (ldap, KEYSPACE_DN, attrs, error);
+}
+
+/* Adds a corpus key the way a PGP key server lists it, and returns its key id */
+static gchar *
+add_key (LDAP *ldap,
+         guint index,
+         GError **error)
+{
+	char *object_class[] = { "pgpKeyInfo", NULL };
+	char *certid[] = { NULL, NULL };
+	char *keyid[] = { NULL, NULL };
+	char *keydata[] = { NULL, NULL };
+	char *type[] = { "RSA", NULL };
+	char *size[] = { NULL, NULL };
+	char *created[] = { "20200101000000Z", NULL };
+	char *flag[] = { "0", NULL };
+	char **uids;
+	LDAPMod mods[10] = {
+		{ LDAP_MOD_ADD, "objectClass", { object_class } },
+		{ LDAP_MOD_ADD, "pgpCertID", { certid } },
+		{ LDAP_MOD_ADD, "pgpKeyID", { keyid } },
+		{ LDAP_MOD_ADD, "pgpKey", { keydata } },
+		{ LDAP_MOD_ADD, "pgpKeyType", { type } },
+		{ LDAP_MOD_ADD, "pgpKeySize", { size } },
+		{ LDAP_MOD_ADD, "pgpKeyCreateTime", { created } },
+		{ LDAP_MOD_ADD, "pgpRevoked", { flag } },
+		{ LDAP_MOD_ADD, "pgpDisabled", { flag } },
+		{ LDAP_MOD_ADD, "pgpUserID", { NULL } },
+	};
+	LDAPMod *attrs[11];
+	gconstpointer data;
+	gchar *fingerprint;
+	GString *armored;
+	gchar *result = NULL;
+	gsize n_data;
+	GBytes *key;
+	gchar *dn;
+	guint i;
+
+	key = mock_hkp_corpus_generate_key (0, index, key_bits, n_uids);
+	fingerprint = mock_hkp_corpus_fingerprint (key);
+	data = g_bytes_get_data (key, &n_data);
+	armored = g_string_new (NULL);
+	seahorse_pgp_armor_append (armored, data, n_data);
+
+	/* The same user ids as the corpus puts in the key */
+	uids = g_new0 (char *, MAX (n_uids, 1) + 1);
+	uids[0] = g_strdup_printf ("Mock User %u <mock%u@example.org>", index, index);
+	for (i = 1; i < (guint)n_uids; i++)
+		uids[i] = g_strdup_printf ("Mock User %u (%u) <mock%u.%u@example.org>",
+		                           index, i, index, i);
+
+	certid[0] = fingerprint + strlen (fingerprint) - 16;
+	keyid[0] = fingerprint + strlen (fingerprint) - 8;
+	keydata[0] = armored->str;
+	size[0] = g_strdup_printf ("%05d", key_bits);
+	mods[9].mod_values = uids;
+
+	for (i = 0; i < G_N_ELEMENTS (mods); i++)
+		attrs[i] = &mods[i];
+	attrs[i] = NULL;
+
+	dn = g_strdup_printf ("pgpCertID=%s," KEYSPACE_DN, certid[0]);
+	if (add_entry (ldap, dn, attrs, error))
+		result = g_strdup (certid[0]);
+
+	g_free (dn);
+	g_free (size[0]);
+	g_strfreev (uids);
+	g_string_free (armored, TRUE);
+	g_free (fingerprint);
+	g_bytes_unref (key);
+
+	return result;
+}
+
+static void
+slapd_stop (Slapd *slapd)
+{
+	if (slapd->process) {
+		g_subprocess_send_signal (slapd->process, SIGTERM);
+		g_subprocess_wait (slapd->process, NULL, NULL);
+		g_object_unref (slapd->process);
+	}
+
+	if (slapd->directory) {
+		remove_directory (slapd->directory);
+		g_free (slapd->directory);
+	}
+
+	if (slapd->keyids)
+		g_ptr_array_free (slapd->keyids, TRUE);
+	g_free (slapd->host);
+	g_free (slapd);
+}
+
+static Slapd *
+slapd_start (const gchar *program,
+             GError **error)
+{
+	Slapd *slapd;
+	gchar *config;
+	gchar *listen;
+	gchar *keyid;
+	LDAP *ldap;
+	guint port;
+	gint i;
+
+	slapd = g_new0 (Slapd, 1);
+	slapd->keyids = g_ptr_array_new_with_free_func (g_free);
+
+	port = find_free_port (error);
+	if (port == 0) {
+		slapd_stop (slapd);
+		return NULL;
+	}
+
+	slapd->host = g_strdup_printf ("127.0.0.1:%u", port);
+	slapd->directory = g_dir_make_tmp ("seahorse-slapd-XXXXXX", error);
+	if (slapd->directory == NULL) {
+		slapd_stop (slapd);
+		return NULL;
+	}
+
+	config = write_slapd_config (slapd->directory, error);
+	if (config == NULL) {
+		slapd_stop (slapd);
+		return NULL;
+	}
+
+	/* In the foreground, with errors going to our stderr */
+	listen = g_strdup_printf ("ldap://%s/", slapd->host);
+	slapd->process = g_subprocess_new (G_SUBPROCESS_FLAGS_STDOUT_SILENCE, error,
+	                                   program, "-f", config, "-h", listen, "-d", "0", NULL);
+	g_free (listen);
+	g_free (config);
+
+	if (slapd->process == NULL) {
+		slapd_stop (slapd);
+		return NULL;
+	}
+
+	ldap = connect_slapd (slapd, error);
+	if (ldap == NULL) {
+		slapd_stop (slapd);
+		return NULL;
+	}
+
+	if (!add_server_info (ldap, error)) {
+		ldap_unbind_ext_s (ldap, NULL, NULL);
+		slapd_stop (slapd);
+		return NULL;
+	}
+
+	for (i = 0; i < n_keys; i++) {
+		keyid = add_key (ldap, i, error);
+		if (keyid == NULL) {
+			ldap_unbind_ext_s (ldap, NULL, NULL);
+			slapd_stop (slapd);
+			return NULL;
+		}
+		g_ptr_array_add (slapd->keyids, keyid);
+	}
+
+	ldap_unbind_ext_s (ldap, NULL, NULL);
+	return slapd;
+}
+
+static void
+on_async_ready (GObject *source,
+                GAsyncResult *result,
+                gpointer user_data)
+{
+	GAsyncResult **ret = user_data;
+	*ret = g_object_ref (result);
+}
+
+static GAsyncResult *
+wait_for_result (GAsyncResult **result)
+{
+	while (*result == NULL)
+		g_main_context_iteration (NULL, TRUE);
+	return *result;
+}
+
+static int
+compare_times (gconstpointer a,
+               gconstpointer b)
+{
+	gint64 ta = *(const gint64 *)a;
+	gint64 tb = *(const gint64 *)b;
+	return (ta > tb) - (ta < tb);
+}
+
+static void
+bench_search (SeahorseServerSource *source,
+              GRand *rand)
+{
+	GcrSimpleCollection *results;
+	GAsyncResult *result;
+	GError *error = NULL;
+	gint64 *times;
+	gint64 started, total = 0;
+	guint failed = 0;
+	guint found = 0;
+	gchar *match;
+	gint i;
+
+	if (n_searches <= 0)
+		return;
+
+	times = g_new0 (gint64, n_searches);
+	for (i = 0; i < n_searches; i++) {
+		match = g_strdup_printf ("mock%u@example.org",
+		                         g_rand_int_range (rand, 0, MAX (n_keys, 1)));
+		results = GCR_SIMPLE_COLLECTION (gcr_simple_collection_new ());
+		result = NULL;
+
+		started = g_get_monotonic_time ();
+		seahorse_server_source_search_async (source, match, results, NULL,
+		                                     on_async_ready, &result);
+		if (!seahorse_server_source_search_finish (source, wait_for_result (&result), &error)) {
+			g_clear_error (&error);
+			failed++;
+		}
+		times[i] = g_get_monotonic_time () - started;
+		total += times[i];
+		found += gcr_collection_get_length (GCR_COLLECTION (results));
+
+		g_object_unref (result);
+		g_object_unref (results);
+		g_free (match);
+	}
+
+	qsort (times, n_searches, sizeof (gint64), compare_times);
+	g_print ("search: %d searches, %u failed, %u keys found, mean %.2f ms, "
+	         "median %.2f ms, p95 %.2f ms, max %.2f ms\n", n_searches, failed, found,
+	         total / 1000.0 / n_searches, times[n_searches / 2] / 1000.0,
+	         times[(n_searches * 95) / 100] / 1000.0, times[n_searches - 1] / 1000.0);
+	g_free (times);
+}
+
+static void
+bench_export (SeahorseServerSource *source,
+              Slapd *slapd)
+{
+	const gchar **keyids;
+	GAsyncResult *result = NULL;
+	GError *error = NULL;
+	gchar **missing;
+	gpointer data;
+	gsize n_data = 0;
+	gdouble seconds;
+	gint64 started;
+	gint count, i;
+
+	count = MIN (n_exports, (gint)slapd->keyids->len);
+	if (count <= 0)
+		return;
+
+	keyids = g_new0 (const gchar *, count + 1);
+	for (i = 0; i < count; i++)
+		keyids[i] = slapd->keyids->pdata[i];
+
+	started = g_get_monotonic_time ();
+	seahorse_server_source_export_async (source, keyids, NULL, on_async_ready, &result);
+	data = seahorse_server_source_export_finish (source, wait_for_result (&result),
+	                                             &n_data, &error);
+	seconds = (g_get_monotonic_time () - started) / (gdouble)G_USEC_PER_SEC;
+	missing = seahorse_ldap_source_export_get_missing (SEAHORSE_LDAP_SOURCE (source), result);
+
+	g_print ("export: %d keys, %u missing, %" G_GSIZE_FORMAT " bytes in %.3f s, "
+	         "%.1f keys/s, %.2f MB/s%s%s\n", count, missing ? g_strv_length (missing) : 0,
+	         n_data, seconds, count / seconds, n_data / seconds / (1024 * 1024),
+	         error ? ", failed: " : "", error ? error->message : "");
+
+	g_clear_error (&error);
+	g_strfreev (missing);
+	g_object_unref (result);
+	g_free (keyids);
+	g_free (data);
+}
+
+static void
+bench_upload (SeahorseServerSource *source)
+{
+	GAsyncResult *result = NULL;
+	GError *error = NULL;
+	GInputStream *input;
+	GString *armored;
+	gconstpointer data;
+	gdouble seconds;
+	gint64 started;
+	gsize n_data;
+	GBytes *key;
+	gint i;
+
+	if (n_uploads <= 0)
+		return;
+
+	/* Keys from another seed than the ones on the server */
+	armored = g_string_new (NULL);
+	for (i = 0; i < n_uploads; i++) {
+		key = mock_hkp_corpus_generate_key (1, i, key_bits, n_uids);
+		data = g_bytes_get_data (key, &n_data);
+		seahorse_pgp_armor_append (armored, data, n_data);
+		g_bytes_unref (key);
+	}
+
+	input = g_memory_input_stream_new_from_data (armored->str, armored->len, NULL);
+
+	started = g_get_monotonic_time ();
+	seahorse_server_source_import_async (source, input, NULL, on_async_ready, &result);
+	seahorse_server_source_import_finish (source, wait_for_result (&result), &error);
+	seconds = (g_get_monotonic_time () - started) / (gdouble)G_USEC_PER_SEC;
+
+	g_print ("upload: %d keys, %" G_GSIZE_FORMAT " bytes in %.3f s, window %d, "
+	         "%.1f keys/s, %.2f MB/s%s%s\n", n_uploads, armored->len, seconds,
+	         seahorse_app_settings_get_keyserver_max_requests (seahorse_app_settings_instance ()),
+	         n_uploads / seconds, armored->len / seconds / (1024 * 1024),
+	         error ? ", failed: " : "", error ? error->message : "");
+
+	g_clear_error (&error);
+	g_object_unref (result);
+	g_object_unref (input);
+	g_string_free (armored, TRUE);
+}
+
+/* The attributes the source asks for in a search */
+static char *PGP_ATTRIBUTES[] = {
+	"pgpcertid",
+	"pgpuserid",
+	"pgprevoked",
+	"pgpdisabled",
+	"pgpkeycreatetime",
+	"pgpkeyexpiretime",
+	"pgpkeysize",
+	"pgpkeytype",
+	NULL
+};
+
+/*
+ * What the source pulled out of an entry before it walked the attributes
+ * with the BER functions: a lookup per attribute, with each value copied.
+ * Building the key from the values is the same either way, and left out.
+ */
+static gchar **
+legacy_get_values (LDAP *ld,
+                   LDAPMessage *entry,
+                   const char *attribute)
+{
+	GArray *array;
+	struct berval **bv;
+	gchar *value;
+	int num, i;
+
+	bv = ldap_get_values_len (ld, entry, attribute);
+	if (!bv)
+		return NULL;
+
+	array = g_array_new (TRUE, TRUE, sizeof (gchar*));
+	num = ldap_count_values_len (bv);
+	for (i = 0; i < num; i++) {
+		value = g_strndup (bv[i]->bv_val, bv[i]->bv_len);
+		g_array_append_val (array, value);
+	}
+
+	/* The old helper leaked these, freed so repeated parses don't grow */
+	ldap_value_free_len (bv);
+	return (gchar**)g_array_free (array, FALSE);
+}
+
+static guint
+legacy_parse_entry (LDAP *ldap,
+                    LDAPMessage *entry)
+{
+	gchar *fpr = NULL;
+	gchar *uidstr = NULL;
+	gchar **values;
+	guint found = 0;
+	guint i;
+
+	for (i = 0; PGP_ATTRIBUTES[i] != NULL; i++) {
+		values = legacy_get_values (ldap, entry, PGP_ATTRIBUTES[i]);
+		if (values && values[0]) {
+			if (i == 0)
+				fpr = g_strdup (values[0]);
+			else if (i == 1)
+				uidstr = g_strdup (values[0]);
+			found++;
+		}
+		g_strfreev (values);
+	}
+
+	g_free (fpr);
+	g_free (uidstr);
+	return found;
+}
+
+/* As search_parse_key_from_ldap_entry() does it now */
+static guint
+parse_entry (LDAP *ldap,
+             LDAPMessage *entry)
+{
+	gchar *fpr = NULL;
+	gchar *uidstr = NULL;
+	BerElement *ber = NULL;
+	struct berval dn, attr;
+	BerVarray values;
+	guint found = 0;
+	int rc;
+
+	rc = ldap_get_dn_ber (ldap, entry, &ber, &dn);
+	if (rc != LDAP_SUCCESS)
+		return 0;
+
+	for (rc = ldap_get_attribute_ber (ldap, entry, ber, &attr, &values);
+	     rc == LDAP_SUCCESS && attr.bv_val != NULL;
+	     rc = ldap_get_attribute_ber (ldap, entry, ber, &attr, &values)) {
+		if (values == NULL)
+			continue;
+		if (values[0].bv_val != NULL) {
+			if (fpr == NULL && attr.bv_len == 9 &&
+			    g_ascii_strncasecmp (attr.bv_val, "pgpcertid", 9) == 0)
+				fpr = g_strndup (values[0].bv_val, values[0].bv_len);
+			else if (uidstr == NULL && attr.bv_len == 9 &&
+			         g_ascii_strncasecmp (attr.bv_val, "pgpuserid", 9) == 0)
+				uidstr = g_strndup (values[0].bv_val, values[0].bv_len);
+			found++;
+		}
+		ber_memfree (values);
+	}
+
+	ber_free (ber, 0);
+	g_free (fpr);
+	g_free (uidstr);
+	return found;
+}
+
+typedef guint (* ParseFunc) (LDAP *ldap, LDAPMessage *entry);
+
+/* Returns the seconds taken per entry, and the values found in one pass */
+static gdouble
+time_parse (LDAP *ldap,
+            LDAPMessage *result,
+            ParseFunc parse,
+            guint *n_entries,
+            guint *n_values)
+{
+	LDAPMessage *entry;
+	gint64 started;
+	gint i;
+
+	*n_entries = *n_values = 0;
+	for (entry = ldap_first_entry (ldap, result); entry != NULL;
+	     entry = ldap_next_entry (ldap, entry)) {
+		*n_values += parse (ldap, entry);
+		(*n_entries)++;
+	}
+
+	started = g_get_monotonic_time ();
+	for (i = 0; i < n_parses; i++) {
+		for (entry = ldap_first_entry (ldap, result); entry != NULL;
+		     entry = ldap_next_entry (ldap, entry))
+			parse (ldap, entry);
+	}
+
+	return (g_get_monotonic_time () - started) / (gdouble)G_USEC_PER_SEC /
+	       MAX (*n_entries, 1) / MAX (n_parses, 1);
+}
+
+#ifdef HAVE_ALLOCATION_COUNTS
+
+static gdouble
+count_parse_allocations (LDAP *ldap,
+                         LDAPMessage *result,
+                         ParseFunc parse)
+{
+	LDAPMessage *entry;
+	guint n_entries = 0;
+	guint count;
+
+	allocations_begin ();
+	for (entry = ldap_first_entry (ldap, result); entry != NULL;
+	     entry = ldap_next_entry (ldap, entry)) {
+		parse (ldap, entry);
+		n_entries++;
+	}
+	count = allocations_end ();
+
+	return count / (gdouble)MAX (n_entries, 1);
+}
+
+#endif /* HAVE_ALLOCATION_COUNTS */
+
+static gboolean
+bench_parse (Slapd *slapd)
+{
+	LDAPMessage *result = NULL;
+	GError *error = NULL;
+	guint n_entries, n_legacy_values, n_values;
+	gdouble legacy, current;
+	LDAP *ldap;
+	int rc;
+
+	if (n_parses <= 0)
+		return TRUE;
+
+	ldap = connect_slapd (slapd, &error);
+	if (ldap == NULL) {
+		g_printerr ("%s\n", error->message);
+		g_error_free (error);
+		return FALSE;
+	}
+
+	rc = ldap_search_ext_s (ldap, KEYSPACE_DN, LDAP_SCOPE_SUBTREE, "(objectClass=pgpKeyInfo)",
+	                        PGP_ATTRIBUTES, 0, NULL, NULL, NULL, LDAP_NO_LIMIT, &result);
+	if (rc != LDAP_SUCCESS) {
+		g_printerr ("couldn't search for the keys: %s\n", ldap_err2string (rc));
+		ldap_msgfree (result);
+		ldap_unbind_ext_s (ldap, NULL, NULL);
+		return FALSE;
+	}
+
+	legacy = time_parse (ldap, result, legacy_parse_entry, &n_entries, &n_legacy_values);
+	current = time_parse (ldap, result, parse_entry, &n_entries, &n_values);
+
+	g_print ("parse: %u entries, get values %.2f us, attribute walk %.2f us per entry (%.1fx)\n",
+	         n_entries, legacy * G_USEC_PER_SEC, current * G_USEC_PER_SEC,
+	         legacy / current);
+
+#ifdef HAVE_ALLOCATION_COUNTS
+	g_print ("allocations: get values %.1f, attribute walk %.1f per entry\n",
+	         count_parse_allocations (ldap, result, legacy_parse_entry),
+	         count_parse_allocations (ldap, result, parse_entry));
+#else
+	g_print ("allocations: not counted, this needs glibc\n");
+#endif
+
+	ldap_msgfree (result);
+	ldap_unbind_ext_s (ldap, NULL, NULL);
+
+	if (n_legacy_values != n_values) {
+		g_printerr ("parsers disagree: %u and %u values\n", n_legacy_values, n_values);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+int
+main (int argc,
+      char **argv)
+{
+	SeahorseServerSource *source;
+	GOptionContext *context;
+	GError *error = NULL;
+	Slapd *slapd;
+	gchar *program;
+	GRand *rand;
+	gchar *uri;
+	int ret;
+
+	context = g_option_context_new ("- benchmark the LDAP key server source");
+	g_option_context_add_main_entries (context, options, NULL);
+	if (!g_option_context_parse (context, &argc, &argv, &error)) {
+		g_printerr ("%s\n", error->message);
+		return 2;
+	}
+	g_option_context_free (context);
+
+	program = find_slapd ();
+	if (program == NULL) {
+		g_print ("slapd wasn't found, skipping\n");
+		return EXIT_SKIPPED;
+	}
+
+	slapd = slapd_start (program, &error);
+	g_free (program);
+	if (slapd == NULL) {
+		g_printerr ("couldn't start slapd: %s\n", error->message);
+		g_error_free (error);
+		return 1;
+	}
+
+	uri = g_strdup_printf ("ldap://%s", slapd->host);
+	source = SEAHORSE_SERVER_SOURCE (seahorse_ldap_source_new (uri, slapd->host));
+	g_free (uri);
+
+	g_print ("server: %d keys of %d bits, %d user ids each\n", n_keys, key_bits, n_uids);
+
+	rand = g_rand_new_with_seed (0);
+	bench_search (source, rand);
+	bench_export (source, slapd);
+	bench_upload (source);
+	g_rand_free (rand);
+	g_object_unref (source);
+
+	ret = bench_parse (slapd) ? 0 : 1;
+
+	slapd_stop (slapd);
+	return ret;
+}
@@ -0,0 +1,113 @@
+/*
+ * Seahorse
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Measures matching many objects against a predicate, with PredicatePlan
+ * and with Predicate.match(), for objects that implement Matchable and for
+ * objects that only have "usage" and "object-flags" properties.
+ */
+
+static int n_objects = 100000;
+static int rounds = 10;
+
+const OptionEntry[] options = {
+    { "objects", 0, 0, OptionArg.INT, ref n_objects, "Objects to match", "N" },
+    { "rounds", 0, 0, OptionArg.INT, ref rounds, "Times to match every object", "N" },
+    { null }
+};
+
+// An object that is matched through its properties
+private class PlainObject : GLib.Object {
+    public Seahorse.Usage usage { get; set; default = Seahorse.Usage.NONE; }
+    public Seahorse.Flags object_flags { get; set; default = Seahorse.Flags.NONE; }
+}
+
+// Like the key manager's filter, which looks at other properties
+static bool on_custom(GLib.Object obj, void* custom_target) {
+    return true;
+}
+
+static void make_objects(GLib.Object[] objects, Rand rand) {
+    for (int i = 0; i < objects.length; i++) {
+        Seahorse.Usage usage = (rand.int_range(0, 2) == 0)? Seahorse.Usage.PUBLIC_KEY : Seahorse.Usage.PRIVATE_KEY;
+        Seahorse.Flags flags = Seahorse.Flags.IS_VALID;
+        if (rand.int_range(0, 10) == 0)
+            flags |= Seahorse.Flags.DISABLED;
+        objects[i].set("usage", usage, "object-flags", flags, null);
+    }
+}
+
+// Nanoseconds per match, the best of all rounds
+static double time_matches(GLib.Object[] objects, Seahorse.Predicate pred, bool planned, out int n_matched) {
+    Seahorse.PredicatePlan plan = new Seahorse.PredicatePlan(pred);
+    double best = double.MAX;
+    n_matched = 0;
+
+    for (int r = 0; r < int.max(rounds, 1); r++) {
+        int matched = 0;
+        int64 started = get_monotonic_time();
+        foreach (GLib.Object obj in objects) {
+            if (planned? plan.match(obj) : pred.match(obj))
+                matched++;
+        }
+        best = double.min(best, (get_monotonic_time() - started) * 1000.0 / int.max(objects.length, 1));
+        n_matched = matched;
+    }
+
+    return best;
+}
+
+static bool compare(string name, GLib.Object[] objects, Type type) {
+    Seahorse.Predicate pred = Seahorse.Predicate();
+    pred.type = type;
+    pred.usage = Seahorse.Usage.PRIVATE_KEY;
+    pred.nflags = Seahorse.Flags.DISABLED;
+    pred.custom = on_custom;
+
+    int unplanned_count, planned_count;
+    double unplanned = time_matches(objects, pred, false, out unplanned_count);
+    double planned = time_matches(objects, pred, true, out planned_count);
+    print("%s: %d objects, %d matched, Predicate.match %.1f ns, PredicatePlan %.1f ns per match %s\n",
+          name, objects.length, planned_count, unplanned, planned, Bench.speedup(unplanned, planned));
+
+    if (unplanned_count != planned_count) {
+        Bench.disagree("%s: matches disagree: %d and %d", name, unplanned_count, planned_count);
+        return false;
+    }
+
+    return true;
+}
+
+public int main(string[] args) {
+    if (!Bench.parse_options("- benchmark matching objects against a predicate", options, ref args))
+        return 2;
+
+    GLib.Object[] matchable = new GLib.Object[int.max(n_objects, 0)];
+    GLib.Object[] plain = new GLib.Object[int.max(n_objects, 0)];
+    for (int i = 0; i < matchable.length; i++) {
+        matchable[i] = new Seahorse.Object();
+        plain[i] = new PlainObject();
+    }
+
+    make_objects(matchable, new Rand.with_seed(0));
+    make_objects(plain, new Rand.with_seed(0));
+
+    bool agreed = compare("matchable", matchable, typeof(Seahorse.Object));
+    agreed = compare("properties", plain, typeof(PlainObject)) && agreed;
+
+    return agreed? 0 : 1;
+}
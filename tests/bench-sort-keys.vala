@@ -0,0 +1,128 @@
+/*
+ * Seahorse
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Measures sorting a large collection by label in a Gtk.TreeModelSort,
+ * with SortKeys and with collating the casefolded labels on every
+ * comparison as the key manager used to.
+ */
+
+static int n_objects = 100000;
+
+const OptionEntry[] options = {
+    { "objects", 0, 0, OptionArg.INT, ref n_objects, "Objects in the collection", "N" },
+    { null }
+};
+
+private class BenchModel : Gcr.CollectionModel {
+    private static Gcr.Column[] _columns = {
+        Gcr.Column() { property_name = "label", property_type = typeof(string), column_type = typeof(string) },
+        Gcr.Column()
+    };
+
+    construct {
+        set("columns", _columns,
+            "mode", Gcr.CollectionModelMode.LIST,
+            null);
+    }
+
+    public BenchModel(Gcr.Collection collection) {
+        GLib.Object(collection: collection);
+    }
+}
+
+// Sorting as the key manager did before SortKeys
+static int collate_rows(Gtk.TreeModel model, Gtk.TreeIter a, Gtk.TreeIter b) {
+    string? label_a = null, label_b = null;
+    model.get(a, 0, out label_a, -1);
+    model.get(b, 0, out label_b, -1);
+
+    int result = (label_a ?? "").casefold().collate((label_b ?? "").casefold());
+    if (result != 0)
+        return result;
+
+    GLib.Object? obj_a = ((Gcr.CollectionModel) model).object_for_iter(a);
+    GLib.Object? obj_b = ((Gcr.CollectionModel) model).object_for_iter(b);
+    return ((void*) obj_a > (void*) obj_b)? 1 : ((void*) obj_a < (void*) obj_b)? -1 : 0;
+}
+
+// The objects in the order of the sorted model
+static GLib.Object[] sorted_objects(Gtk.TreeModelSort sorted, Gcr.CollectionModel model) {
+    GLib.Object[] objects = {};
+    Gtk.TreeIter iter;
+    for (bool valid = sorted.get_iter_first(out iter); valid; valid = sorted.iter_next(ref iter)) {
+        Gtk.TreeIter child;
+        sorted.convert_iter_to_child_iter(out child, iter);
+        objects += model.object_for_iter(child);
+    }
+    return objects;
+}
+
+// Milliseconds to sort, and then to sort again in the other direction
+static void time_sort(Gcr.CollectionModel model, Gtk.TreeIterCompareFunc func,
+                      out double first, out double again, out GLib.Object[] order) {
+    Gtk.TreeModelSort sorted = new Gtk.TreeModelSort.with_model(model);
+    sorted.set_sort_func(0, func);
+
+    int64 started = get_monotonic_time();
+    sorted.set_sort_column_id(0, Gtk.SortType.ASCENDING);
+    Gtk.TreeIter iter;
+    sorted.get_iter_first(out iter);
+    first = (get_monotonic_time() - started) / 1000.0;
+
+    order = sorted_objects(sorted, model);
+
+    started = get_monotonic_time();
+    sorted.set_sort_column_id(0, Gtk.SortType.DESCENDING);
+    again = (get_monotonic_time() - started) / 1000.0;
+}
+
+public int main(string[] args) {
+    if (!Bench.parse_options("- benchmark sorting a large collection by label", options, ref args))
+        return 2;
+
+    // Labels in no particular order, with accents and mixed case
+    Rand rand = new Rand.with_seed(0);
+    string[] names = { "Mock", "mock", "Émile", "emile", "Zoë", "zoe", "Ångström" };
+    Gcr.SimpleCollection collection = new Gcr.SimpleCollection();
+    for (int i = 0; i < n_objects; i++) {
+        Seahorse.Object obj = new Seahorse.Object();
+        obj.label = "%s User %u".printf(names[rand.int_range(0, names.length)], rand.next_int());
+        collection.add(obj);
+    }
+
+    BenchModel model = new BenchModel(collection);
+    Seahorse.SortKeys sort_keys = new Seahorse.SortKeys(collection);
+
+    double collate_first, collate_again, keys_first, keys_again;
+    GLib.Object[] collate_order, keys_order;
+    time_sort(model, collate_rows, out collate_first, out collate_again, out collate_order);
+    time_sort(model, sort_keys.compare_rows, out keys_first, out keys_again, out keys_order);
+
+    print("sort %d rows: collate every comparison %.1f ms, sort keys %.1f ms %s\n",
+          n_objects, collate_first, keys_first, Bench.speedup(collate_first, keys_first));
+    print("sort again: collate every comparison %.1f ms, sort keys %.1f ms %s\n",
+          collate_again, keys_again, Bench.speedup(collate_again, keys_again));
+
+    bool same = (collate_order.length == keys_order.length);
+    for (int i = 0; same && i < keys_order.length; i++)
+        same = (collate_order[i] == keys_order[i]);
+    if (!same)
+        return Bench.disagree("sort orders disagree");
+
+    return 0;
+}
@@ -0,0 +1,52 @@
+/*
+ * Seahorse
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * What the Vala benchmarks share. Each one times an old and a new way of
+ * doing the same work, and fails if the two get different results, since
+ * then the timings aren't comparing the same thing.
+ */
+namespace Bench {
+
+// Parses the command line, or says why not
+public bool parse_options(string summary, OptionEntry[] entries, ref unowned string[] args) {
+    try {
+        OptionContext context = new OptionContext(summary);
+        context.add_main_entries(entries, null);
+        context.parse(ref args);
+    } catch (OptionError e) {
+        printerr("%s\n", e.message);
+        return false;
+    }
+
+    return true;
+}
+
+// How many times faster the new way was
+public string speedup(double old_time, double new_time) {
+    return "(%.1fx)".printf(old_time / new_time);
+}
+
+// Reports that the old and new ways got different results, returns the exit status
+[PrintfFormat]
+public int disagree(string format, ...) {
+    va_list args = va_list();
+    printerr("%s\n", format.vprintf(args));
+    return 1;
+}
+
+}
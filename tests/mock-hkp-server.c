@@ -0,0 +1,876 @@
+/*
+ * Seahorse
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "mock-hkp-server.h"
+
+#include "seahorse-pgp-armor.h"
+
+#include <libsoup/soup.h>
+
+#include <string.h>
+
+#define PGP_PACKET_PUBLIC_KEY   6
+#define PGP_PACKET_USER_ID      13
+
+/* 2010-01-01, so the keys have plausible creation dates */
+#define CORPUS_EPOCH            1262304000
+
+typedef struct {
+	gchar *fingerprint;
+	gint64 created;
+	guint bits;
+	GPtrArray *uids;
+	GPtrArray *folded;
+	GBytes *data;
+} MockHkpKey;
+
+struct _MockHkpServer {
+	SoupServer *server;
+	gchar *host;
+	GRand *rand;
+
+	GPtrArray *keys;
+	GHashTable *by_fingerprint;
+
+	guint latency;
+	gdouble error_rate;
+	guint max_results;
+	gchar *rejected;
+	gint64 modified;        /* When keys were last uploaded, in seconds */
+
+	guint n_requests;
+	guint n_errors;
+	guint n_uploaded;
+	guint n_not_modified;
+	guint64 bytes_sent;
+	guint64 bytes_received;
+};
+
+static void
+append_packet (GByteArray *output,
+               guint tag,
+               const guchar *body,
+               gsize n_body)
+{
+	guchar header[6];
+	gsize n_header = 0;
+
+	/* Always the new packet format */
+	header[n_header++] = 0xC0 | tag;
+	if (n_body < 192) {
+		header[n_header++] = n_body;
+	} else if (n_body < 8384) {
+		header[n_header++] = ((n_body - 192) >> 8) + 192;
+		header[n_header++] = (n_body - 192) & 0xFF;
+	} else {
+		header[n_header++] = 0xFF;
+		header[n_header++] = (n_body >> 24) & 0xFF;
+		header[n_header++] = (n_body >> 16) & 0xFF;
+		header[n_header++] = (n_body >> 8) & 0xFF;
+		header[n_header++] = n_body & 0xFF;
+	}
+
+	g_byte_array_append (output, header, n_header);
+	g_byte_array_append (output, body, n_body);
+}
+
+static gboolean
+read_packet (const guchar *data,
+             gsize n_data,
+             guint *tag,
+             const guchar **body,
+             gsize *n_body)
+{
+	gsize n_header;
+	guchar ctb;
+
+	if (n_data < 2 || !(data[0] & 0x80))
+		return FALSE;
+
+	ctb = data[0];
+	if (ctb & 0x40) {
+		*tag = ctb & 0x3F;
+		if (data[1] < 192) {
+			n_header = 2;
+			*n_body = data[1];
+		} else if (data[1] < 224 && n_data >= 3) {
+			n_header = 3;
+			*n_body = ((data[1] - 192) << 8) + data[2] + 192;
+		} else if (data[1] == 255 && n_data >= 6) {
+			n_header = 6;
+			*n_body = ((gsize)data[2] << 24) | (data[3] << 16) |
+			          (data[4] << 8) | data[5];
+		} else {
+			return FALSE;
+		}
+	} else {
+		*tag = (ctb >> 2) & 0x0F;
+		switch (ctb & 0x03) {
+		case 0:
+			n_header = 2;
+			*n_body = data[1];
+			break;
+		case 1:
+			if (n_data < 3)
+				return FALSE;
+			n_header = 3;
+			*n_body = (data[1] << 8) | data[2];
+			break;
+		case 2:
+			if (n_data < 5)
+				return FALSE;
+			n_header = 5;
+			*n_body = ((gsize)data[1] << 24) | (data[2] << 16) |
+			          (data[3] << 8) | data[4];
+			break;
+		default:
+			n_header = 1;
+			*n_body = n_data - 1;
+			break;
+		}
+	}
+
+	if (n_header + *n_body > n_data)
+		return FALSE;
+
+	*body = data + n_header;
+	return TRUE;
+}
+
+GBytes *
+mock_hkp_corpus_generate_key (guint32 seed,
+                              guint index,
+                              guint bits,
+                              guint n_uids)
+{
+	guint32 seeds[2] = { seed, index };
+	GByteArray *output;
+	GByteArray *body;
+	guchar header[8];
+	GRand *rand;
+	guint32 created;
+	gchar *uid;
+	guint n_bytes;
+	guint i;
+
+	g_return_val_if_fail (bits >= 512 && bits % 8 == 0, NULL);
+
+	rand = g_rand_new_with_seed_array (seeds, G_N_ELEMENTS (seeds));
+	output = g_byte_array_new ();
+	body = g_byte_array_new ();
+
+	/* A v4 RSA public key: version, creation time, algorithm, n, e */
+	created = CORPUS_EPOCH + index * 3600;
+	header[0] = 4;
+	header[1] = (created >> 24) & 0xFF;
+	header[2] = (created >> 16) & 0xFF;
+	header[3] = (created >> 8) & 0xFF;
+	header[4] = created & 0xFF;
+	header[5] = 1;
+	header[6] = (bits >> 8) & 0xFF;
+	header[7] = bits & 0xFF;
+	g_byte_array_append (body, header, sizeof (header));
+	n_bytes = bits / 8;
+	for (i = 0; i < n_bytes; i++) {
+		guchar byte = g_rand_int_range (rand, 0, 256);
+		if (i == 0)
+			byte |= 0x80;
+		g_byte_array_append (body, &byte, 1);
+	}
+	g_byte_array_append (body, (const guchar *)"\x00\x11\x01\x00\x01", 5);
+	append_packet (output, PGP_PACKET_PUBLIC_KEY, body->data, body->len);
+
+	for (i = 0; i < MAX (n_uids, 1); i++) {
+		if (i == 0)
+			uid = g_strdup_printf ("Mock User %u <mock%u@example.org>", index, index);
+		else
+			uid = g_strdup_printf ("Mock User %u (%u) <mock%u.%u@example.org>",
+			                       index, i, index, i);
+		append_packet (output, PGP_PACKET_USER_ID, (const guchar *)uid, strlen (uid));
+		g_free (uid);
+	}
+
+	g_byte_array_unref (body);
+	g_rand_free (rand);
+	return g_byte_array_free_to_bytes (output);
+}
+
+static gboolean
+on_first_fingerprint (const guchar *key,
+                      gsize n_key,
+                      const gchar *fingerprint,
+                      gpointer user_data)
+{
+	gchar **result = user_data;
+	*result = g_strdup (fingerprint);
+	return FALSE;
+}
+
+gchar *
+mock_hkp_corpus_fingerprint (GBytes *key)
+{
+	gchar *fingerprint = NULL;
+	gconstpointer data;
+	gsize n_data;
+
+	g_return_val_if_fail (key != NULL, NULL);
+
+	data = g_bytes_get_data (key, &n_data);
+	seahorse_pgp_armor_foreach_key (data, n_data, on_first_fingerprint, &fingerprint);
+	return fingerprint;
+}
+
+static void
+mock_hkp_key_free (gpointer data)
+{
+	MockHkpKey *key = data;
+	g_free (key->fingerprint);
+	g_ptr_array_unref (key->uids);
+	g_ptr_array_unref (key->folded);
+	g_bytes_unref (key->data);
+	g_free (key);
+}
+
+static gboolean
+add_key (MockHkpServer *self,
+         const guchar *data,
+         gsize n_data,
+         const gchar *fingerprint)
+{
+	MockHkpKey *previous;
+	const guchar *body;
+	MockHkpKey *key;
+	gsize n_body;
+	gsize at = 0;
+	guint tag;
+	gchar *uid;
+
+	if (fingerprint == NULL)
+		return FALSE;
+
+	key = g_new0 (MockHkpKey, 1);
+	key->fingerprint = g_strdup (fingerprint);
+	key->uids = g_ptr_array_new_with_free_func (g_free);
+	key->folded = g_ptr_array_new_with_free_func (g_free);
+	key->data = g_bytes_new (data, n_data);
+
+	while (at < n_data && read_packet (data + at, n_data - at, &tag, &body, &n_body)) {
+		if (tag == PGP_PACKET_PUBLIC_KEY && n_body >= 8 && body[0] == 4) {
+			key->created = ((guint32)body[1] << 24) | (body[2] << 16) |
+			               (body[3] << 8) | body[4];
+			key->bits = (body[6] << 8) | body[7];
+		} else if (tag == PGP_PACKET_USER_ID) {
+			uid = g_strndup ((const gchar *)body, n_body);
+			g_ptr_array_add (key->folded, g_utf8_casefold (uid, -1));
+			g_ptr_array_add (key->uids, uid);
+		}
+		at = (body + n_body) - data;
+	}
+
+	/* Uploads replace the stored copy of a key */
+	previous = g_hash_table_lookup (self->by_fingerprint, key->fingerprint);
+	g_hash_table_replace (self->by_fingerprint, key->fingerprint, key);
+	if (previous != NULL)
+		g_ptr_array_remove (self->keys, previous);
+	g_ptr_array_add (self->keys, key);
+	return TRUE;
+}
+
+typedef struct {
+	MockHkpServer *server;
+	guint added;
+} AddClosure;
+
+static gboolean
+on_add_key (const guchar *data,
+            gsize n_data,
+            const gchar *fingerprint,
+            gpointer user_data)
+{
+	AddClosure *closure = user_data;
+	if (add_key (closure->server, data, n_data, fingerprint))
+		closure->added++;
+	return TRUE;
+}
+
+guint
+mock_hkp_server_add_keys (MockHkpServer *self,
+                          const guchar *data,
+                          gsize n_data)
+{
+	AddClosure closure = { self, 0 };
+
+	g_return_val_if_fail (self != NULL, 0);
+
+	seahorse_pgp_armor_foreach_key (data, n_data, on_add_key, &closure);
+	return closure.added;
+}
+
+void
+mock_hkp_server_generate (MockHkpServer *self,
+                          guint n_keys,
+                          guint bits,
+                          guint n_uids)
+{
+	gconstpointer data;
+	gsize n_data;
+	GBytes *key;
+	guint first;
+	guint i;
+
+	g_return_if_fail (self != NULL);
+
+	first = self->keys->len;
+	for (i = first; i < first + n_keys; i++) {
+		key = mock_hkp_corpus_generate_key (0, i, bits, n_uids);
+		data = g_bytes_get_data (key, &n_data);
+		mock_hkp_server_add_keys (self, data, n_data);
+		g_bytes_unref (key);
+	}
+}
+
+/* Keys whose fingerprint ends in the hex id, or with a user id containing the text */
+static GPtrArray *
+find_keys (MockHkpServer *self,
+           const gchar *search)
+{
+	GPtrArray *found;
+	MockHkpKey *key;
+	gchar *match;
+	gboolean keyid;
+	guint i, j;
+
+	found = g_ptr_array_new ();
+	keyid = g_ascii_strncasecmp (search, "0x", 2) == 0;
+	if (keyid)
+		match = g_ascii_strup (search + 2, -1);
+	else
+		match = g_utf8_casefold (search, -1);
+
+	for (i = 0; i < self->keys->len; i++) {
+		key = self->keys->pdata[i];
+		if (keyid) {
+			if (match[0] && g_str_has_suffix (key->fingerprint, match))
+				g_ptr_array_add (found, key);
+		} else {
+			for (j = 0; j < key->folded->len; j++) {
+				if (strstr (key->folded->pdata[j], match)) {
+					g_ptr_array_add (found, key);
+					break;
+				}
+			}
+		}
+	}
+
+	g_free (match);
+	return found;
+}
+
+static void
+append_escaped (GString *output,
+                const gchar *text)
+{
+	for (; *text; text++) {
+		switch (*text) {
+		case '<':
+			g_string_append (output, "&lt;");
+			break;
+		case '>':
+			g_string_append (output, "&gt;");
+			break;
+		case '&':
+			g_string_append (output, "&amp;");
+			break;
+		default:
+			g_string_append_c (output, *text);
+			break;
+		}
+	}
+}
+
+/* The human readable index, in the form SKS servers send it */
+static gchar *
+format_index (GPtrArray *keys)
+{
+	GDateTime *date;
+	MockHkpKey *key;
+	GString *output;
+	gchar *created;
+	guint i, j;
+
+	output = g_string_new ("<html><body><pre>\n");
+	for (i = 0; i < keys->len; i++) {
+		key = keys->pdata[i];
+		date = g_date_time_new_from_unix_utc (key->created);
+		created = g_date_time_format (date, "%Y/%m/%d");
+		g_date_time_unref (date);
+
+		g_string_append_printf (output, "pub  %uR/%s %s ", key->bits,
+		                        key->fingerprint + strlen (key->fingerprint) - 16,
+		                        created);
+		if (key->uids->len > 0)
+			append_escaped (output, key->uids->pdata[0]);
+		g_string_append_c (output, '\n');
+		g_free (created);
+
+		for (j = 1; j < key->uids->len; j++) {
+			g_string_append (output, "                               ");
+			append_escaped (output, key->uids->pdata[j]);
+			g_string_append_c (output, '\n');
+		}
+
+		g_string_append (output, "\t Fingerprint=");
+		for (j = 0; key->fingerprint[j]; j += 4)
+			g_string_append_printf (output, "%s%.4s", j ? " " : "", key->fingerprint + j);
+		g_string_append (output, "\n\n");
+	}
+
+	g_string_append (output, "</pre></body></html>\n");
+	return g_string_free (output, FALSE);
+}
+
+static gchar *
+format_keys (GPtrArray *keys)
+{
+	GByteArray *packets;
+	GString *output;
+	gconstpointer data;
+	gsize n_data;
+	guint i;
+
+	packets = g_byte_array_new ();
+	for (i = 0; i < keys->len; i++) {
+		data = g_bytes_get_data (((MockHkpKey *)keys->pdata[i])->data, &n_data);
+		g_byte_array_append (packets, data, n_data);
+	}
+
+	output = g_string_new (NULL);
+	seahorse_pgp_armor_append (output, packets->data, packets->len);
+	g_byte_array_unref (packets);
+	return g_string_free (output, FALSE);
+}
+
+static void
+set_response (SoupMessage *message,
+              guint status,
+              const gchar *content_type,
+              gchar *body)
+{
+	soup_message_set_status (message, status);
+	soup_message_set_response (message, content_type, SOUP_MEMORY_TAKE,
+	                           body, strlen (body));
+}
+
+/*
+ * Lookup responses carry an ETag of their body, and the time keys were
+ * last uploaded. Requests whose copy is still current get a 304.
+ */
+static void
+handle_validators (MockHkpServer *self,
+                   SoupMessage *message)
+{
+	const gchar *if_none_match;
+	const gchar *if_modified_since;
+	gboolean current = FALSE;
+	SoupBuffer *buffer;
+	SoupDate *date;
+	gchar *digest;
+	gchar *etag;
+	gchar *modified;
+
+	buffer = soup_message_body_flatten (message->response_body);
+	digest = g_compute_checksum_for_data (G_CHECKSUM_SHA1, (const guchar *)buffer->data,
+	                                      buffer->length);
+	soup_buffer_free (buffer);
+	etag = g_strdup_printf ("\"%s\"", digest);
+	g_free (digest);
+
+	date = soup_date_new_from_time_t (self->modified);
+	modified = soup_date_to_string (date, SOUP_DATE_HTTP);
+	soup_date_free (date);
+
+	soup_message_headers_replace (message->response_headers, "ETag", etag);
+	soup_message_headers_replace (message->response_headers, "Last-Modified", modified);
+
+	/* If-None-Match wins when both are sent */
+	if_none_match = soup_message_headers_get_one (message->request_headers, "If-None-Match");
+	if_modified_since = soup_message_headers_get_one (message->request_headers, "If-Modified-Since");
+	if (if_none_match != NULL) {
+		current = g_str_equal (if_none_match, etag);
+	} else if (if_modified_since != NULL) {
+		date = soup_date_new_from_string (if_modified_since);
+		current = date != NULL && soup_date_to_time_t (date) >= self->modified;
+		if (date != NULL)
+			soup_date_free (date);
+	}
+
+	if (current) {
+		soup_message_set_status (message, SOUP_STATUS_NOT_MODIFIED);
+		soup_message_body_truncate (message->response_body);
+		self->n_not_modified++;
+	}
+
+	g_free (etag);
+	g_free (modified);
+}
+
+static void
+handle_lookup (MockHkpServer *self,
+               SoupMessage *message,
+               GHashTable *query)
+{
+	const gchar *op = NULL;
+	const gchar *search = NULL;
+	GPtrArray *found;
+
+	if (query != NULL) {
+		op = g_hash_table_lookup (query, "op");
+		search = g_hash_table_lookup (query, "search");
+	}
+
+	if (op == NULL || search == NULL) {
+		set_response (message, SOUP_STATUS_BAD_REQUEST, "text/plain",
+		              g_strdup ("Missing op or search"));
+		return;
+	}
+
+	found = find_keys (self, search);
+
+	if (found->len == 0) {
+		set_response (message, SOUP_STATUS_NOT_FOUND, "text/plain",
+		              g_strdup ("No keys found"));
+	} else if (g_str_equal (op, "index")) {
+		if (self->max_results > 0 && found->len > self->max_results)
+			set_response (message, SOUP_STATUS_INTERNAL_SERVER_ERROR, "text/plain",
+			              g_strdup ("Too many keys found"));
+		else
+			set_response (message, SOUP_STATUS_OK, "text/html", format_index (found));
+	} else if (g_str_equal (op, "get")) {
+		set_response (message, SOUP_STATUS_OK, "application/pgp-keys", format_keys (found));
+	} else {
+		set_response (message, SOUP_STATUS_NOT_IMPLEMENTED, "text/plain",
+		              g_strdup ("Unsupported operation"));
+	}
+
+	if (message->status_code == SOUP_STATUS_OK)
+		handle_validators (self, message);
+
+	g_ptr_array_unref (found);
+}
+
+typedef struct {
+	const gchar *fingerprint;
+	gboolean found;
+} FindClosure;
+
+static gboolean
+on_find_key (const guchar *data,
+             gsize n_data,
+             const gchar *fingerprint,
+             gpointer user_data)
+{
+	FindClosure *closure = user_data;
+	if (g_strcmp0 (fingerprint, closure->fingerprint) == 0)
+		closure->found = TRUE;
+	return !closure->found;
+}
+
+static void
+handle_add (MockHkpServer *self,
+            SoupMessage *message)
+{
+	const gchar *keytext = NULL;
+	const gchar *at, *end, *block;
+	GHashTable *form = NULL;
+	FindClosure find = { NULL, FALSE };
+	SoupBuffer *buffer;
+	gconstpointer packets;
+	GPtrArray *blocks;
+	guchar *data;
+	gsize n_data;
+	guint added = 0;
+	guint i;
+
+	if (message->method == SOUP_METHOD_POST) {
+		buffer = soup_message_body_flatten (message->request_body);
+		form = soup_form_decode (buffer->data);
+		soup_buffer_free (buffer);
+		keytext = g_hash_table_lookup (form, "keytext");
+	}
+
+	if (keytext == NULL) {
+		set_response (message, SOUP_STATUS_BAD_REQUEST, "text/plain",
+		              g_strdup ("Missing keytext"));
+		if (form)
+			g_hash_table_destroy (form);
+		return;
+	}
+
+	/* Each armored block in the text */
+	blocks = g_ptr_array_new_with_free_func ((GDestroyNotify)g_bytes_unref);
+	end = keytext + strlen (keytext);
+	for (at = keytext; (block = strstr (at, "-----BEGIN ")) != NULL; ) {
+		data = seahorse_pgp_armor_decode (block, end - block, &n_data);
+		if (data != NULL)
+			g_ptr_array_add (blocks, g_bytes_new_take (data, n_data));
+
+		at = strstr (block, "-----END ");
+		if (at == NULL)
+			break;
+		at += 9;
+	}
+
+	g_hash_table_destroy (form);
+
+	/* One refused key fails the whole upload, as with real servers */
+	find.fingerprint = self->rejected;
+	for (i = 0; self->rejected != NULL && !find.found && i < blocks->len; i++) {
+		packets = g_bytes_get_data (blocks->pdata[i], &n_data);
+		seahorse_pgp_armor_foreach_key (packets, n_data, on_find_key, &find);
+	}
+
+	if (find.found) {
+		set_response (message, SOUP_STATUS_BAD_REQUEST, "text/plain",
+		              g_strdup_printf ("Key %s was refused", self->rejected));
+		g_ptr_array_unref (blocks);
+		return;
+	}
+
+	for (i = 0; i < blocks->len; i++) {
+		packets = g_bytes_get_data (blocks->pdata[i], &n_data);
+		added += mock_hkp_server_add_keys (self, packets, n_data);
+	}
+
+	g_ptr_array_unref (blocks);
+	self->n_uploaded += added;
+	if (added > 0)
+		self->modified = g_get_real_time () / G_USEC_PER_SEC;
+
+	if (added == 0)
+		set_response (message, SOUP_STATUS_BAD_REQUEST, "text/plain",
+		              g_strdup ("No keys in keytext"));
+	else
+		set_response (message, SOUP_STATUS_OK, "text/plain",
+		              g_strdup_printf ("Added %u keys", added));
+}
+
+typedef struct {
+	SoupServer *server;
+	SoupMessage *message;
+} DelayedResponse;
+
+static gboolean
+on_latency_elapsed (gpointer user_data)
+{
+	DelayedResponse *delayed = user_data;
+	soup_server_unpause_message (delayed->server, delayed->message);
+	g_object_unref (delayed->message);
+	g_object_unref (delayed->server);
+	g_free (delayed);
+	return G_SOURCE_REMOVE;
+}
+
+static void
+on_server_request (SoupServer *server,
+                   SoupMessage *message,
+                   const gchar *path,
+                   GHashTable *query,
+                   SoupClientContext *client,
+                   gpointer user_data)
+{
+	MockHkpServer *self = user_data;
+	DelayedResponse *delayed;
+
+	self->n_requests++;
+	self->bytes_received += message->request_body->length;
+
+	if (self->error_rate > 0 && g_rand_double (self->rand) < self->error_rate) {
+		self->n_errors++;
+		set_response (message, SOUP_STATUS_INTERNAL_SERVER_ERROR, "text/plain",
+		              g_strdup ("Mock server error"));
+	} else if (g_str_equal (path, "/pks/lookup")) {
+		handle_lookup (self, message, query);
+	} else if (g_str_equal (path, "/pks/add")) {
+		handle_add (self, message);
+	} else {
+		set_response (message, SOUP_STATUS_NOT_FOUND, "text/plain",
+		              g_strdup ("Not found"));
+	}
+
+	self->bytes_sent += message->response_body->length;
+
+	if (self->latency > 0) {
+		delayed = g_new0 (DelayedResponse, 1);
+		delayed->server = g_object_ref (server);
+		delayed->message = g_object_ref (message);
+		soup_server_pause_message (server, message);
+		g_timeout_add (self->latency, on_latency_elapsed, delayed);
+	}
+}
+
+MockHkpServer *
+mock_hkp_server_new (GError **error)
+{
+	MockHkpServer *self;
+	GSList *uris;
+	guint port;
+
+	self = g_new0 (MockHkpServer, 1);
+	self->rand = g_rand_new_with_seed (0);
+	self->modified = CORPUS_EPOCH;
+	self->keys = g_ptr_array_new_with_free_func (mock_hkp_key_free);
+	self->by_fingerprint = g_hash_table_new (g_str_hash, g_str_equal);
+
+	self->server = soup_server_new (SOUP_SERVER_SERVER_HEADER, "mock-hkp ", NULL);
+	soup_server_add_handler (self->server, "/pks", on_server_request, self, NULL);
+
+	if (!soup_server_listen_local (self->server, 0, SOUP_SERVER_LISTEN_IPV4_ONLY, error)) {
+		mock_hkp_server_free (self);
+		return NULL;
+	}
+
+	uris = soup_server_get_uris (self->server);
+	g_return_val_if_fail (uris != NULL, NULL);
+	port = soup_uri_get_port (uris->data);
+	g_slist_free_full (uris, (GDestroyNotify)soup_uri_free);
+
+	self->host = g_strdup_printf ("127.0.0.1:%u", port);
+	return self;
+}
+
+void
+mock_hkp_server_free (MockHkpServer *self)
+{
+	if (self == NULL)
+		return;
+
+	soup_server_disconnect (self->server);
+	g_object_unref (self->server);
+	g_hash_table_destroy (self->by_fingerprint);
+	g_ptr_array_unref (self->keys);
+	g_rand_free (self->rand);
+	g_free (self->rejected);
+	g_free (self->host);
+	g_free (self);
+}
+
+void
+mock_hkp_server_stop (MockHkpServer *self)
+{
+	g_return_if_fail (self != NULL);
+	soup_server_disconnect (self->server);
+}
+
+const gchar *
+mock_hkp_server_get_host (MockHkpServer *self)
+{
+	g_return_val_if_fail (self != NULL, NULL);
+	return self->host;
+}
+
+guint
+mock_hkp_server_get_n_keys (MockHkpServer *self)
+{
+	g_return_val_if_fail (self != NULL, 0);
+	return self->keys->len;
+}
+
+const gchar *
+mock_hkp_server_get_fingerprint (MockHkpServer *self,
+                                 guint index)
+{
+	g_return_val_if_fail (self != NULL, NULL);
+	g_return_val_if_fail (index < self->keys->len, NULL);
+	return ((MockHkpKey *)self->keys->pdata[index])->fingerprint;
+}
+
+void
+mock_hkp_server_set_latency (MockHkpServer *self,
+                             guint milliseconds)
+{
+	g_return_if_fail (self != NULL);
+	self->latency = milliseconds;
+}
+
+void
+mock_hkp_server_set_error_rate (MockHkpServer *self,
+                                gdouble error_rate)
+{
+	g_return_if_fail (self != NULL);
+	self->error_rate = CLAMP (error_rate, 0.0, 1.0);
+}
+
+void
+mock_hkp_server_set_max_results (MockHkpServer *self,
+                                 guint max_results)
+{
+	g_return_if_fail (self != NULL);
+	self->max_results = max_results;
+}
+
+void
+mock_hkp_server_set_rejected (MockHkpServer *self,
+                              const gchar *fingerprint)
+{
+	g_return_if_fail (self != NULL);
+	g_free (self->rejected);
+	self->rejected = g_strdup (fingerprint);
+}
+
+guint
+mock_hkp_server_get_n_requests (MockHkpServer *self)
+{
+	g_return_val_if_fail (self != NULL, 0);
+	return self->n_requests;
+}
+
+guint
+mock_hkp_server_get_n_not_modified (MockHkpServer *self)
+{
+	g_return_val_if_fail (self != NULL, 0);
+	return self->n_not_modified;
+}
+
+guint
+mock_hkp_server_get_n_errors (MockHkpServer *self)
+{
+	g_return_val_if_fail (self != NULL, 0);
+	return self->n_errors;
+}
+
+guint
+mock_hkp_server_get_n_uploaded (MockHkpServer *self)
+{
+	g_return_val_if_fail (self != NULL, 0);
+	return self->n_uploaded;
+}
+
+guint64
+mock_hkp_server_get_bytes_sent (MockHkpServer *self)
+{
+	g_return_val_if_fail (self != NULL, 0);
+	return self->bytes_sent;
+}
+
+guint64
+mock_hkp_server_get_bytes_received (MockHkpServer *self)
+{
+	g_return_val_if_fail (self != NULL, 0);
+	return self->bytes_received;
+}
@@ -0,0 +1,104 @@
+/*
+ * Seahorse
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * An in-process HKP key server for tests and benchmarks. It answers
+ * op=index and op=get lookups and /pks/add uploads from a corpus of
+ * synthetic keys, on a loopback port served from the default main context.
+ * Lookups carry ETag and Last-Modified headers, and conditional lookups
+ * are answered with 304 Not Modified when nothing changed.
+ */
+
+#ifndef __MOCK_HKP_SERVER_H__
+#define __MOCK_HKP_SERVER_H__
+
+#include <glib.h>
+
+typedef struct _MockHkpServer MockHkpServer;
+
+/*
+ * Builds the public key packet and user id packets of a synthetic v4 RSA
+ * key. The same @seed and @index always give the same key. The user ids
+ * are "Mock User <index> <mock<index>@example.org>" and, for @n_uids
+ * above one, "Mock User <index> (<n>) <mock<index>.<n>@example.org>".
+ */
+GBytes *           mock_hkp_corpus_generate_key      (guint32 seed,
+                                                      guint index,
+                                                      guint bits,
+                                                      guint n_uids);
+
+/* The upper case hex fingerprint of the first key in @key */
+gchar *            mock_hkp_corpus_fingerprint       (GBytes *key);
+
+MockHkpServer *    mock_hkp_server_new               (GError **error);
+
+void               mock_hkp_server_free              (MockHkpServer *self);
+
+/* Stops listening and closes connections, so the server can't be reached */
+void               mock_hkp_server_stop              (MockHkpServer *self);
+
+/* The "host:port" the server listens on */
+const gchar *      mock_hkp_server_get_host          (MockHkpServer *self);
+
+/* Adds @n_keys synthetic keys, continuing the index after existing keys */
+void               mock_hkp_server_generate          (MockHkpServer *self,
+                                                      guint n_keys,
+                                                      guint bits,
+                                                      guint n_uids);
+
+/* Adds the keys in the @data packet stream, as an upload would */
+guint              mock_hkp_server_add_keys          (MockHkpServer *self,
+                                                      const guchar *data,
+                                                      gsize n_data);
+
+guint              mock_hkp_server_get_n_keys        (MockHkpServer *self);
+
+const gchar *      mock_hkp_server_get_fingerprint   (MockHkpServer *self,
+                                                      guint index);
+
+/* Delay every response by @milliseconds */
+void               mock_hkp_server_set_latency       (MockHkpServer *self,
+                                                      guint milliseconds);
+
+/* Fail this fraction of requests, between 0.0 and 1.0, with a 500 */
+void               mock_hkp_server_set_error_rate    (MockHkpServer *self,
+                                                      gdouble error_rate);
+
+/* Answer index lookups matching more keys than this with "too many" */
+void               mock_hkp_server_set_max_results   (MockHkpServer *self,
+                                                      guint max_results);
+
+/* Refuse uploads containing the key with @fingerprint with a 400, or NULL */
+void               mock_hkp_server_set_rejected      (MockHkpServer *self,
+                                                      const gchar *fingerprint);
+
+/* Counters since the server was created */
+guint              mock_hkp_server_get_n_requests    (MockHkpServer *self);
+
+guint              mock_hkp_server_get_n_errors      (MockHkpServer *self);
+
+/* Conditional lookups answered with 304 Not Modified */
+guint              mock_hkp_server_get_n_not_modified (MockHkpServer *self);
+
+/* Keys received in uploads, including ones the server already had */
+guint              mock_hkp_server_get_n_uploaded    (MockHkpServer *self);
+
+guint64            mock_hkp_server_get_bytes_sent    (MockHkpServer *self);
+
+guint64            mock_hkp_server_get_bytes_received (MockHkpServer *self);
+
+#endif /* __MOCK_HKP_SERVER_H__ */
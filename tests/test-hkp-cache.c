@@ -0,0 +1,333 @@
+/*
+ * Seahorse
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "mock-hkp-server.h"
+
+#include "seahorse-hkp-cache.h"
+
+#include <glib/gstdio.h>
+#include <libsoup/soup.h>
+
+#include <string.h>
+
+/* Older than the cache uses without asking the server */
+#define STALE_SECONDS (10 * 60)
+
+typedef struct {
+	MockHkpServer *server;
+	SoupSession *session;
+	SeahorseHkpCache *cache;
+	gchar *directory;
+	gsize max_size;
+} Test;
+
+static void
+setup (Test *test,
+       gconstpointer unused)
+{
+	GError *error = NULL;
+
+	test->server = mock_hkp_server_new (&error);
+	g_assert_no_error (error);
+	mock_hkp_server_generate (test->server, 20, 1024, 2);
+
+	test->session = soup_session_new ();
+	test->directory = g_dir_make_tmp ("seahorse-hkp-cache-XXXXXX", &error);
+	g_assert_no_error (error);
+	test->max_size = 1024 * 1024;
+	test->cache = seahorse_hkp_cache_new (test->directory, test->max_size);
+}
+
+/* Removes the body files, and the index if @index */
+static void
+remove_cache_files (Test *test,
+                    gboolean index)
+{
+	const gchar *name;
+	gchar *path;
+	GDir *dir;
+
+	dir = g_dir_open (test->directory, 0, NULL);
+	g_assert (dir != NULL);
+
+	while ((name = g_dir_read_name (dir)) != NULL) {
+		if (!index && g_str_equal (name, "index"))
+			continue;
+		path = g_build_filename (test->directory, name, NULL);
+		g_unlink (path);
+		g_free (path);
+	}
+
+	g_dir_close (dir);
+}
+
+static void
+teardown (Test *test,
+          gconstpointer unused)
+{
+	seahorse_hkp_cache_free (test->cache);
+	remove_cache_files (test, TRUE);
+	g_rmdir (test->directory);
+	g_free (test->directory);
+	g_object_unref (test->session);
+	mock_hkp_server_free (test->server);
+}
+
+static void
+reopen_cache (Test *test)
+{
+	seahorse_hkp_cache_free (test->cache);
+	test->cache = seahorse_hkp_cache_new (test->directory, test->max_size);
+}
+
+/*
+ * Makes entries look as if they were stored and used that many seconds
+ * earlier, by rewriting the index while the cache is closed. Only the
+ * entry for the key with @fingerprint, or all of them when NULL.
+ */
+static void
+age_entries (Test *test,
+             const gchar *fingerprint,
+             gint64 stored,
+             gint64 accessed)
+{
+	GError *error = NULL;
+	GKeyFile *index;
+	gchar **groups;
+	gchar *path;
+	gchar *uri;
+	guint i;
+
+	seahorse_hkp_cache_free (test->cache);
+	test->cache = NULL;
+
+	path = g_build_filename (test->directory, "index", NULL);
+	index = g_key_file_new ();
+	g_key_file_load_from_file (index, path, G_KEY_FILE_NONE, &error);
+	g_assert_no_error (error);
+
+	groups = g_key_file_get_groups (index, NULL);
+	for (i = 0; groups[i] != NULL; i++) {
+		uri = g_key_file_get_string (index, groups[i], "uri", NULL);
+		if (fingerprint == NULL || strstr (uri, fingerprint) != NULL) {
+			g_key_file_set_int64 (index, groups[i], "stored",
+			                      g_key_file_get_int64 (index, groups[i], "stored", NULL) - stored);
+			g_key_file_set_int64 (index, groups[i], "accessed",
+			                      g_key_file_get_int64 (index, groups[i], "accessed", NULL) - accessed);
+		}
+		g_free (uri);
+	}
+
+	g_key_file_save_to_file (index, path, &error);
+	g_assert_no_error (error);
+
+	g_strfreev (groups);
+	g_key_file_free (index);
+	g_free (path);
+
+	reopen_cache (test);
+}
+
+static void
+on_message_complete (SoupSession *session,
+                     SoupMessage *message,
+                     gpointer user_data)
+{
+	gboolean *done = user_data;
+	g_assert (*done == FALSE);
+	*done = TRUE;
+}
+
+/* Looks up a key through the cache, and returns the response body */
+static gchar *
+fetch (Test *test,
+       guint index)
+{
+	SoupMessage *message;
+	gboolean done = FALSE;
+	SoupBuffer *buffer;
+	gchar *body;
+	gchar *uri;
+
+	uri = g_strdup_printf ("http://%s/pks/lookup?op=get&search=0x%s&options=mr",
+	                       mock_hkp_server_get_host (test->server),
+	                       mock_hkp_server_get_fingerprint (test->server, index));
+	message = soup_message_new ("GET", uri);
+	g_free (uri);
+
+	g_object_ref (message);
+	seahorse_hkp_cache_queue_message (test->cache, test->session, message,
+	                                  on_message_complete, &done);
+	while (!done)
+		g_main_context_iteration (NULL, TRUE);
+
+	g_assert_cmpuint (message->status_code, ==, SOUP_STATUS_OK);
+	buffer = soup_message_body_flatten (message->response_body);
+	body = g_strndup (buffer->data, buffer->length);
+	soup_buffer_free (buffer);
+	g_object_unref (message);
+
+	g_assert (strstr (body, "-----BEGIN PGP PUBLIC KEY BLOCK-----") != NULL);
+	return body;
+}
+
+static void
+test_fresh_hit (Test *test,
+                gconstpointer unused)
+{
+	gchar *first;
+	gchar *again;
+
+	first = fetch (test, 3);
+	g_assert_cmpuint (mock_hkp_server_get_n_requests (test->server), ==, 1);
+
+	/* Answered without asking the server */
+	again = fetch (test, 3);
+	g_assert_cmpstr (again, ==, first);
+	g_assert_cmpuint (mock_hkp_server_get_n_requests (test->server), ==, 1);
+
+	g_free (first);
+	g_free (again);
+}
+
+static void
+test_revalidate (Test *test,
+                 gconstpointer unused)
+{
+	gchar *first;
+	gchar *again;
+
+	first = fetch (test, 3);
+	age_entries (test, NULL, STALE_SECONDS, 0);
+
+	/* The server says the copy is current, and the body comes from disk */
+	again = fetch (test, 3);
+	g_assert_cmpstr (again, ==, first);
+	g_assert_cmpuint (mock_hkp_server_get_n_requests (test->server), ==, 2);
+	g_assert_cmpuint (mock_hkp_server_get_n_not_modified (test->server), ==, 1);
+	g_free (again);
+
+	/* Revalidating made the entry fresh again */
+	again = fetch (test, 3);
+	g_assert_cmpstr (again, ==, first);
+	g_assert_cmpuint (mock_hkp_server_get_n_requests (test->server), ==, 2);
+
+	g_free (first);
+	g_free (again);
+}
+
+static void
+test_refetch_evicted (Test *test,
+                      gconstpointer unused)
+{
+	gchar *first;
+	gchar *again;
+
+	first = fetch (test, 3);
+	age_entries (test, NULL, STALE_SECONDS, 0);
+
+	/* The body is gone by the time the 304 comes back */
+	remove_cache_files (test, FALSE);
+
+	again = fetch (test, 3);
+	g_assert_cmpstr (again, ==, first);
+	g_assert_cmpuint (mock_hkp_server_get_n_not_modified (test->server), ==, 1);
+	g_assert_cmpuint (mock_hkp_server_get_n_requests (test->server), ==, 3);
+	g_free (again);
+
+	/* And it was stored again */
+	again = fetch (test, 3);
+	g_assert_cmpstr (again, ==, first);
+	g_assert_cmpuint (mock_hkp_server_get_n_requests (test->server), ==, 3);
+
+	g_free (first);
+	g_free (again);
+}
+
+static void
+test_stale_offline (Test *test,
+                    gconstpointer unused)
+{
+	gchar *first;
+	gchar *again;
+
+	first = fetch (test, 3);
+	age_entries (test, NULL, STALE_SECONDS, 0);
+	g_assert_cmpuint (mock_hkp_server_get_n_requests (test->server), ==, 1);
+
+	/* Nothing listening on the port any more, and no open connections */
+	mock_hkp_server_stop (test->server);
+	g_object_unref (test->session);
+	test->session = soup_session_new ();
+
+	again = fetch (test, 3);
+	g_assert_cmpstr (again, ==, first);
+
+	g_free (first);
+	g_free (again);
+}
+
+static void
+test_lru_eviction (Test *test,
+                   gconstpointer unused)
+{
+	const gchar *fingerprint;
+	gchar *body;
+	gsize size;
+
+	/* Room for two responses, which are all the same size */
+	body = fetch (test, 10);
+	size = strlen (body);
+	g_free (body);
+	test->max_size = size * 2 + size / 2;
+	reopen_cache (test);
+
+	g_free (fetch (test, 11));
+	g_assert_cmpuint (mock_hkp_server_get_n_requests (test->server), ==, 2);
+
+	/* The second key was used longest ago */
+	fingerprint = mock_hkp_server_get_fingerprint (test->server, 11);
+	age_entries (test, fingerprint, 0, 100);
+
+	g_free (fetch (test, 12));
+	g_assert_cmpuint (mock_hkp_server_get_n_requests (test->server), ==, 3);
+
+	/* So it's the one that was evicted */
+	g_free (fetch (test, 10));
+	g_assert_cmpuint (mock_hkp_server_get_n_requests (test->server), ==, 3);
+	g_free (fetch (test, 12));
+	g_assert_cmpuint (mock_hkp_server_get_n_requests (test->server), ==, 3);
+	g_free (fetch (test, 11));
+	g_assert_cmpuint (mock_hkp_server_get_n_requests (test->server), ==, 4);
+}
+
+int
+main (int argc,
+      char **argv)
+{
+	g_test_init (&argc, &argv, NULL);
+
+	g_test_add ("/hkp-cache/fresh-hit", Test, NULL, setup, test_fresh_hit, teardown);
+	g_test_add ("/hkp-cache/revalidate", Test, NULL, setup, test_revalidate, teardown);
+	g_test_add ("/hkp-cache/refetch-evicted", Test, NULL, setup, test_refetch_evicted, teardown);
+	g_test_add ("/hkp-cache/stale-offline", Test, NULL, setup, test_stale_offline, teardown);
+	g_test_add ("/hkp-cache/lru-eviction", Test, NULL, setup, test_lru_eviction, teardown);
+
+	return g_test_run ();
+}
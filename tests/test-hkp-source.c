@@ -0,0 +1,372 @@
+/*
+ * Seahorse
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "mock-hkp-server.h"
+
+#include "seahorse-hkp-source.h"
+#include "seahorse-pgp-armor.h"
+#include "seahorse-pgp-key.h"
+
+#include "seahorse-common.h"
+
+#include <gio/gio.h>
+
+#include <string.h>
+
+typedef struct {
+	MockHkpServer *server;
+	SeahorseServerSource *source;
+	GAsyncResult *result;
+} Test;
+
+static void
+setup (Test *test,
+       gconstpointer unused)
+{
+	GError *error = NULL;
+	gchar *uri;
+
+	test->server = mock_hkp_server_new (&error);
+	g_assert_no_error (error);
+	mock_hkp_server_generate (test->server, 200, 1024, 2);
+
+	uri = g_strdup_printf ("hkp://%s", mock_hkp_server_get_host (test->server));
+	test->source = SEAHORSE_SERVER_SOURCE (seahorse_hkp_source_new (uri, mock_hkp_server_get_host (test->server)));
+	g_free (uri);
+}
+
+static void
+teardown (Test *test,
+          gconstpointer unused)
+{
+	g_clear_object (&test->result);
+	g_object_unref (test->source);
+	mock_hkp_server_free (test->server);
+}
+
+static void
+on_async_ready (GObject *source,
+                GAsyncResult *result,
+                gpointer user_data)
+{
+	Test *test = user_data;
+	g_assert (test->result == NULL);
+	test->result = g_object_ref (result);
+}
+
+static GAsyncResult *
+wait_for_result (Test *test)
+{
+	while (test->result == NULL)
+		g_main_context_iteration (NULL, TRUE);
+	return test->result;
+}
+
+static GList *
+search (Test *test,
+        const gchar *match,
+        GError **error)
+{
+	GcrSimpleCollection *results;
+	GList *objects = NULL;
+
+	results = GCR_SIMPLE_COLLECTION (gcr_simple_collection_new ());
+	g_clear_object (&test->result);
+	seahorse_server_source_search_async (test->source, match, results, NULL,
+	                                     on_async_ready, test);
+	if (seahorse_server_source_search_finish (test->source, wait_for_result (test), error))
+		objects = gcr_collection_get_objects (GCR_COLLECTION (results));
+
+	g_object_unref (results);
+	return objects;
+}
+
+static gboolean
+on_count_key (const guchar *key,
+              gsize n_key,
+              const gchar *fingerprint,
+              gpointer user_data)
+{
+	GPtrArray *fingerprints = user_data;
+	g_ptr_array_add (fingerprints, g_strdup (fingerprint));
+	return TRUE;
+}
+
+/* The fingerprints of the keys in the armored @data */
+static GPtrArray *
+armored_fingerprints (const gchar *data,
+                      gsize n_data)
+{
+	GPtrArray *fingerprints;
+	const gchar *at, *end;
+	guchar *decoded;
+	gsize n_decoded;
+
+	fingerprints = g_ptr_array_new_with_free_func (g_free);
+	end = data + n_data;
+	for (at = data; at && (at = g_strstr_len (at, end - at, "-----BEGIN ")); at++) {
+		decoded = seahorse_pgp_armor_decode (at, end - at, &n_decoded);
+		g_assert (decoded != NULL);
+		seahorse_pgp_armor_foreach_key (decoded, n_decoded, on_count_key, fingerprints);
+		g_free (decoded);
+	}
+
+	return fingerprints;
+}
+
+static gboolean
+has_fingerprint (GPtrArray *fingerprints,
+                 const gchar *fingerprint)
+{
+	guint i;
+
+	for (i = 0; i < fingerprints->len; i++) {
+		if (g_strcmp0 (fingerprints->pdata[i], fingerprint) == 0)
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+static void
+test_search_name (Test *test,
+                  gconstpointer unused)
+{
+	GError *error = NULL;
+	gchar *fingerprint;
+	GList *keys;
+
+	keys = search (test, "mock17@example.org", &error);
+	g_assert_no_error (error);
+	g_assert_cmpuint (g_list_length (keys), ==, 1);
+
+	fingerprint = seahorse_pgp_armor_compact_keyid (seahorse_pgp_key_get_fingerprint (keys->data));
+	g_assert_cmpstr (fingerprint, ==, mock_hkp_server_get_fingerprint (test->server, 17));
+	g_assert_cmpuint (g_list_length (seahorse_pgp_key_get_uids (keys->data)), ==, 2);
+	g_free (fingerprint);
+	g_list_free (keys);
+}
+
+static void
+test_search_keyid (Test *test,
+                   gconstpointer unused)
+{
+	const gchar *fingerprint;
+	GError *error = NULL;
+	GList *keys;
+
+	/* An eight digit key id is searched for as 0x... */
+	fingerprint = mock_hkp_server_get_fingerprint (test->server, 42);
+	keys = search (test, fingerprint + strlen (fingerprint) - 8, &error);
+	g_assert_no_error (error);
+	g_assert_cmpuint (g_list_length (keys), ==, 1);
+	g_list_free (keys);
+}
+
+static void
+test_search_not_found (Test *test,
+                       gconstpointer unused)
+{
+	GError *error = NULL;
+	GList *keys;
+
+	keys = search (test, "nobody@example.org", &error);
+	g_assert_no_error (error);
+	g_assert (keys == NULL);
+}
+
+static void
+test_search_too_many (Test *test,
+                      gconstpointer unused)
+{
+	GError *error = NULL;
+	GList *keys;
+
+	mock_hkp_server_set_max_results (test->server, 10);
+	keys = search (test, "mock user", &error);
+	g_assert (error != NULL);
+	g_assert (keys == NULL);
+	g_error_free (error);
+}
+
+static void
+test_search_error (Test *test,
+                   gconstpointer unused)
+{
+	GError *error = NULL;
+	GList *keys;
+
+	mock_hkp_server_set_error_rate (test->server, 1.0);
+	keys = search (test, "mock17@example.org", &error);
+	g_assert (error != NULL);
+	g_assert (keys == NULL);
+	g_error_free (error);
+}
+
+static void
+test_search_latency (Test *test,
+                     gconstpointer unused)
+{
+	GError *error = NULL;
+	gint64 started;
+	GList *keys;
+
+	mock_hkp_server_set_latency (test->server, 200);
+	started = g_get_monotonic_time ();
+	keys = search (test, "mock17@example.org", &error);
+	g_assert_no_error (error);
+	g_assert_cmpint (g_get_monotonic_time () - started, >=, 200 * 1000);
+	g_assert_cmpuint (g_list_length (keys), ==, 1);
+	g_list_free (keys);
+}
+
+static void
+test_export (Test *test,
+             gconstpointer unused)
+{
+	const gchar *keyids[4];
+	GPtrArray *fingerprints;
+	GError *error = NULL;
+	gpointer data;
+	gsize n_data;
+
+	keyids[0] = mock_hkp_server_get_fingerprint (test->server, 3);
+	keyids[1] = mock_hkp_server_get_fingerprint (test->server, 99);
+	keyids[2] = "0000000000000000000000000000000000000000";
+	keyids[3] = NULL;
+
+	seahorse_server_source_export_async (test->source, keyids, NULL, on_async_ready, test);
+	data = seahorse_server_source_export_finish (test->source, wait_for_result (test),
+	                                             &n_data, &error);
+	g_assert_no_error (error);
+	g_assert (data != NULL);
+
+	fingerprints = armored_fingerprints (data, n_data);
+	g_assert_cmpuint (fingerprints->len, ==, 2);
+	g_assert (has_fingerprint (fingerprints, keyids[0]));
+	g_assert (has_fingerprint (fingerprints, keyids[1]));
+
+	g_ptr_array_unref (fingerprints);
+	g_free (data);
+}
+
+/* Fifty keys the server doesn't have yet, each armored on its own */
+static GString *
+upload_keys (void)
+{
+	GString *armored;
+	gconstpointer data;
+	gsize n_data;
+	GBytes *key;
+	guint i;
+
+	armored = g_string_new (NULL);
+	for (i = 0; i < 50; i++) {
+		key = mock_hkp_corpus_generate_key (1, i, 1024, 1);
+		data = g_bytes_get_data (key, &n_data);
+		seahorse_pgp_armor_append (armored, data, n_data);
+		g_bytes_unref (key);
+	}
+
+	return armored;
+}
+
+static void
+upload (Test *test,
+        GString *armored,
+        GError **error)
+{
+	GInputStream *input;
+
+	g_clear_object (&test->result);
+	input = g_memory_input_stream_new_from_data (armored->str, armored->len, NULL);
+	seahorse_server_source_import_async (test->source, input, NULL, on_async_ready, test);
+	seahorse_server_source_import_finish (test->source, wait_for_result (test), error);
+	g_object_unref (input);
+}
+
+static void
+test_upload (Test *test,
+             gconstpointer unused)
+{
+	GError *error = NULL;
+	GString *armored;
+
+	armored = upload_keys ();
+	upload (test, armored, &error);
+	g_assert_no_error (error);
+	g_assert_cmpuint (mock_hkp_server_get_n_keys (test->server), ==, 250);
+
+	/* All of them in one batch */
+	g_assert_cmpuint (mock_hkp_server_get_n_requests (test->server), ==, 1);
+	g_assert_cmpuint (mock_hkp_server_get_n_uploaded (test->server), ==, 50);
+
+	g_string_free (armored, TRUE);
+}
+
+static void
+test_upload_rejected (Test *test,
+                      gconstpointer unused)
+{
+	GError *error = NULL;
+	GString *armored;
+	gchar *fingerprint;
+	GBytes *key;
+
+	key = mock_hkp_corpus_generate_key (1, 17, 1024, 1);
+	fingerprint = mock_hkp_corpus_fingerprint (key);
+	mock_hkp_server_set_rejected (test->server, fingerprint);
+
+	armored = upload_keys ();
+	upload (test, armored, &error);
+	g_assert (error != NULL);
+	g_assert (strstr (error->message, "1 of 50") != NULL);
+	g_clear_error (&error);
+
+	/* The batch was refused, then each key sent on its own */
+	g_assert_cmpuint (mock_hkp_server_get_n_requests (test->server), ==, 1 + 50);
+	g_assert_cmpuint (mock_hkp_server_get_n_uploaded (test->server), ==, 49);
+	g_assert_cmpuint (mock_hkp_server_get_n_keys (test->server), ==, 249);
+
+	g_string_free (armored, TRUE);
+	g_bytes_unref (key);
+	g_free (fingerprint);
+}
+
+int
+main (int argc,
+      char **argv)
+{
+	g_test_init (&argc, &argv, NULL);
+
+	/* Every request should reach the mock server */
+	seahorse_app_settings_set_keyserver_cache_size (seahorse_app_settings_instance (), 0);
+
+	g_test_add ("/hkp-source/search-name", Test, NULL, setup, test_search_name, teardown);
+	g_test_add ("/hkp-source/search-keyid", Test, NULL, setup, test_search_keyid, teardown);
+	g_test_add ("/hkp-source/search-not-found", Test, NULL, setup, test_search_not_found, teardown);
+	g_test_add ("/hkp-source/search-too-many", Test, NULL, setup, test_search_too_many, teardown);
+	g_test_add ("/hkp-source/search-error", Test, NULL, setup, test_search_error, teardown);
+	g_test_add ("/hkp-source/search-latency", Test, NULL, setup, test_search_latency, teardown);
+	g_test_add ("/hkp-source/export", Test, NULL, setup, test_export, teardown);
+	g_test_add ("/hkp-source/upload", Test, NULL, setup, test_upload, teardown);
+	g_test_add ("/hkp-source/upload-rejected", Test, NULL, setup, test_upload_rejected, teardown);
+
+	return g_test_run ();
+}
@@ -0,0 +1,236 @@
+/*
+ * Seahorse
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "mock-hkp-server.h"
+
+#include "seahorse-hkp-source.h"
+#include "seahorse-keyserver-sync.h"
+
+#include "seahorse-common.h"
+
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+
+#include <string.h>
+
+#define PGP_PACKET_USER_ID 13
+
+typedef struct {
+	MockHkpServer *server;
+	SeahorseServerSource *source;
+	gchar *keyserver;
+	GAsyncResult *result;
+} Test;
+
+static gchar *
+published_keys_path (void)
+{
+	return g_build_filename (g_get_user_data_dir (), "seahorse", "published-keys", NULL);
+}
+
+static void
+setup (Test *test,
+       gconstpointer unused)
+{
+	GError *error = NULL;
+	gchar *path;
+
+	/* Nothing published yet */
+	path = published_keys_path ();
+	g_unlink (path);
+	g_free (path);
+
+	test->server = mock_hkp_server_new (&error);
+	g_assert_no_error (error);
+
+	test->keyserver = g_strdup_printf ("hkp://%s", mock_hkp_server_get_host (test->server));
+	test->source = SEAHORSE_SERVER_SOURCE (seahorse_hkp_source_new (test->keyserver,
+	                                                                mock_hkp_server_get_host (test->server)));
+}
+
+static void
+teardown (Test *test,
+          gconstpointer unused)
+{
+	g_clear_object (&test->result);
+	g_object_unref (test->source);
+	g_free (test->keyserver);
+	mock_hkp_server_free (test->server);
+}
+
+static void
+on_async_ready (GObject *source,
+                GAsyncResult *result,
+                gpointer user_data)
+{
+	Test *test = user_data;
+	g_assert (test->result == NULL);
+	test->result = g_object_ref (result);
+}
+
+/* Ten keys, the fourth of them with an extra user id if @changed */
+static GBytes *
+build_keys (gboolean changed)
+{
+	static const gchar uid[] = "Mock User 3 (new) <mock3.new@example.org>";
+	GByteArray *keys;
+	gconstpointer data;
+	guchar header[2];
+	gsize n_data;
+	GBytes *key;
+	guint i;
+
+	keys = g_byte_array_new ();
+	for (i = 0; i < 10; i++) {
+		key = mock_hkp_corpus_generate_key (2, i, 1024, 1);
+		data = g_bytes_get_data (key, &n_data);
+		g_byte_array_append (keys, data, n_data);
+		g_bytes_unref (key);
+
+		if (changed && i == 3) {
+			header[0] = 0xC0 | PGP_PACKET_USER_ID;
+			header[1] = strlen (uid);
+			g_byte_array_append (keys, header, sizeof (header));
+			g_byte_array_append (keys, (const guchar *)uid, strlen (uid));
+		}
+	}
+
+	return g_byte_array_free_to_bytes (keys);
+}
+
+/* Returns how many keys were sent */
+static guint
+publish (Test *test,
+         GBytes *keys)
+{
+	GError *error = NULL;
+	guint n_sent = 0;
+
+	g_clear_object (&test->result);
+	seahorse_keyserver_sync_publish_async (test->source, test->keyserver, keys,
+	                                       NULL, on_async_ready, test);
+	while (test->result == NULL)
+		g_main_context_iteration (NULL, TRUE);
+
+	seahorse_keyserver_sync_publish_finish (test->result, &n_sent, &error);
+	g_assert_no_error (error);
+	return n_sent;
+}
+
+static void
+test_publish_unchanged (Test *test,
+                        gconstpointer unused)
+{
+	GBytes *keys;
+
+	keys = build_keys (FALSE);
+
+	g_assert_cmpuint (publish (test, keys), ==, 10);
+	g_assert_cmpuint (mock_hkp_server_get_n_uploaded (test->server), ==, 10);
+	g_assert_cmpuint (mock_hkp_server_get_n_keys (test->server), ==, 10);
+
+	/* Nothing changed, so nothing goes to the server */
+	g_assert_cmpuint (publish (test, keys), ==, 0);
+	g_assert_cmpuint (mock_hkp_server_get_n_uploaded (test->server), ==, 10);
+
+	g_bytes_unref (keys);
+}
+
+static void
+test_publish_changed (Test *test,
+                      gconstpointer unused)
+{
+	GBytes *keys;
+
+	keys = build_keys (FALSE);
+	g_assert_cmpuint (publish (test, keys), ==, 10);
+	g_bytes_unref (keys);
+
+	/* Only the key with the new user id goes again */
+	keys = build_keys (TRUE);
+	g_assert_cmpuint (publish (test, keys), ==, 1);
+	g_assert_cmpuint (mock_hkp_server_get_n_uploaded (test->server), ==, 11);
+	g_assert_cmpuint (mock_hkp_server_get_n_keys (test->server), ==, 10);
+
+	g_assert_cmpuint (publish (test, keys), ==, 0);
+	g_assert_cmpuint (mock_hkp_server_get_n_uploaded (test->server), ==, 11);
+	g_bytes_unref (keys);
+}
+
+static void
+test_publish_failed (Test *test,
+                     gconstpointer unused)
+{
+	GError *error = NULL;
+	GBytes *keys;
+
+	keys = build_keys (FALSE);
+
+	/* Keys the server didn't take are sent again next time */
+	mock_hkp_server_set_error_rate (test->server, 1.0);
+	seahorse_keyserver_sync_publish_async (test->source, test->keyserver, keys,
+	                                       NULL, on_async_ready, test);
+	while (test->result == NULL)
+		g_main_context_iteration (NULL, TRUE);
+	g_assert (!seahorse_keyserver_sync_publish_finish (test->result, NULL, &error));
+	g_assert (error != NULL);
+	g_clear_error (&error);
+
+	mock_hkp_server_set_error_rate (test->server, 0.0);
+	g_assert_cmpuint (publish (test, keys), ==, 10);
+	g_assert_cmpuint (mock_hkp_server_get_n_uploaded (test->server), ==, 10);
+
+	g_bytes_unref (keys);
+}
+
+int
+main (int argc,
+      char **argv)
+{
+	gchar *data_dir;
+	gchar *path;
+	int ret;
+
+	/* Published key digests go under here, fresh for each run */
+	data_dir = g_dir_make_tmp ("seahorse-test-XXXXXX", NULL);
+	g_assert (data_dir != NULL);
+	g_setenv ("XDG_DATA_HOME", data_dir, TRUE);
+
+	g_test_init (&argc, &argv, NULL);
+
+	/* Every request should reach the mock server */
+	seahorse_app_settings_set_keyserver_cache_size (seahorse_app_settings_instance (), 0);
+
+	g_test_add ("/keyserver-sync/publish-unchanged", Test, NULL, setup, test_publish_unchanged, teardown);
+	g_test_add ("/keyserver-sync/publish-changed", Test, NULL, setup, test_publish_changed, teardown);
+	g_test_add ("/keyserver-sync/publish-failed", Test, NULL, setup, test_publish_failed, teardown);
+
+	ret = g_test_run ();
+
+	path = published_keys_path ();
+	g_unlink (path);
+	g_free (path);
+	path = g_build_filename (data_dir, "seahorse", NULL);
+	g_rmdir (path);
+	g_free (path);
+	g_rmdir (data_dir);
+	g_free (data_dir);
+
+	return ret;
+}
@@ -0,0 +1,658 @@
+/*
+ * Seahorse
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "libseahorse/seahorse-application.h"
+#include "libseahorse/seahorse-search-provider.h"
+
+#include "seahorse-common.h"
+
+#include <gcr/gcr-base.h>
+
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+
+#include <string.h>
+
+#define PROVIDER_PATH "/org/gnome/seahorse/SearchProviderTest"
+#define PROVIDER_INTERFACE "org.gnome.Shell.SearchProvider2"
+
+/* -----------------------------------------------------------------------------
+ * An item the search provider shows, known by its fingerprint if it has one
+ */
+
+typedef struct {
+	SeahorseObject parent;
+	gchar *fingerprint;
+} MockItem;
+
+typedef struct {
+	SeahorseObjectClass parent_class;
+} MockItemClass;
+
+enum {
+	PROP_ITEM_0,
+	PROP_FINGERPRINT,
+};
+
+static void mock_item_viewable_iface (SeahorseViewableIface *iface);
+
+G_DEFINE_TYPE_WITH_CODE (MockItem, mock_item, SEAHORSE_TYPE_OBJECT,
+                         G_IMPLEMENT_INTERFACE (SEAHORSE_TYPE_VIEWABLE, mock_item_viewable_iface);
+);
+
+static void
+mock_item_init (MockItem *self)
+{
+
+}
+
+static void
+mock_item_get_property (GObject *obj,
+                        guint prop_id,
+                        GValue *value,
+                        GParamSpec *pspec)
+{
+	MockItem *self = (MockItem *)obj;
+
+	switch (prop_id) {
+	case PROP_FINGERPRINT:
+		g_value_set_string (value, self->fingerprint);
+		break;
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID (obj, prop_id, pspec);
+		break;
+	}
+}
+
+static void
+mock_item_set_property (GObject *obj,
+                        guint prop_id,
+                        const GValue *value,
+                        GParamSpec *pspec)
+{
+	MockItem *self = (MockItem *)obj;
+
+	switch (prop_id) {
+	case PROP_FINGERPRINT:
+		self->fingerprint = g_value_dup_string (value);
+		break;
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID (obj, prop_id, pspec);
+		break;
+	}
+}
+
+static void
+mock_item_finalize (GObject *obj)
+{
+	MockItem *self = (MockItem *)obj;
+
+	g_free (self->fingerprint);
+
+	G_OBJECT_CLASS (mock_item_parent_class)->finalize (obj);
+}
+
+static void
+mock_item_class_init (MockItemClass *klass)
+{
+	GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+
+	gobject_class->get_property = mock_item_get_property;
+	gobject_class->set_property = mock_item_set_property;
+	gobject_class->finalize = mock_item_finalize;
+
+	g_object_class_install_property (gobject_class, PROP_FINGERPRINT,
+	            g_param_spec_string ("fingerprint", "Fingerprint", "Fingerprint",
+	                                 NULL, G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY));
+}
+
+static GtkWindow *
+mock_item_create_viewer (SeahorseViewable *viewable,
+                         GtkWindow *parent)
+{
+	return NULL;
+}
+
+static void
+mock_item_viewable_iface (SeahorseViewableIface *iface)
+{
+	iface->create_viewer = mock_item_create_viewer;
+}
+
+static GObject *
+mock_item_new (const gchar *label,
+               const gchar *fingerprint)
+{
+	return g_object_new (mock_item_get_type (),
+	                     "label", label,
+	                     "fingerprint", fingerprint,
+	                     "object-flags", SEAHORSE_FLAG_PERSONAL | SEAHORSE_FLAG_EXPORTABLE,
+	                     NULL);
+}
+
+/* -----------------------------------------------------------------------------
+ * A backend whose places are simple collections, loaded when told to
+ */
+
+typedef struct {
+	GcrSimpleCollection parent;
+	gboolean loaded;
+} MockBackend;
+
+typedef struct {
+	GcrSimpleCollectionClass parent_class;
+} MockBackendClass;
+
+enum {
+	PROP_BACKEND_0,
+	PROP_NAME,
+	PROP_LABEL,
+	PROP_DESCRIPTION,
+	PROP_ACTIONS,
+	PROP_LOADED,
+};
+
+static void mock_backend_iface (SeahorseBackendIface *iface);
+
+G_DEFINE_TYPE_WITH_CODE (MockBackend, mock_backend, GCR_TYPE_SIMPLE_COLLECTION,
+                         G_IMPLEMENT_INTERFACE (SEAHORSE_TYPE_BACKEND, mock_backend_iface);
+);
+
+static void
+mock_backend_init (MockBackend *self)
+{
+
+}
+
+static const gchar *
+mock_backend_get_name (SeahorseBackend *backend)
+{
+	return "mock";
+}
+
+static const gchar *
+mock_backend_get_label (SeahorseBackend *backend)
+{
+	return "Mock";
+}
+
+static const gchar *
+mock_backend_get_description (SeahorseBackend *backend)
+{
+	return "Mock items";
+}
+
+static GtkActionGroup *
+mock_backend_get_actions (SeahorseBackend *backend)
+{
+	return NULL;
+}
+
+static SeahorsePlace *
+mock_backend_lookup_place (SeahorseBackend *backend,
+                           const gchar *uri)
+{
+	return NULL;
+}
+
+static void
+mock_backend_get_property (GObject *obj,
+                           guint prop_id,
+                           GValue *value,
+                           GParamSpec *pspec)
+{
+	SeahorseBackend *backend = SEAHORSE_BACKEND (obj);
+
+	switch (prop_id) {
+	case PROP_NAME:
+		g_value_set_string (value, mock_backend_get_name (backend));
+		break;
+	case PROP_LABEL:
+		g_value_set_string (value, mock_backend_get_label (backend));
+		break;
+	case PROP_DESCRIPTION:
+		g_value_set_string (value, mock_backend_get_description (backend));
+		break;
+	case PROP_ACTIONS:
+		g_value_take_object (value, mock_backend_get_actions (backend));
+		break;
+	case PROP_LOADED:
+		g_value_set_boolean (value, ((MockBackend *)obj)->loaded);
+		break;
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID (obj, prop_id, pspec);
+		break;
+	}
+}
+
+static void
+mock_backend_class_init (MockBackendClass *klass)
+{
+	GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+
+	gobject_class->get_property = mock_backend_get_property;
+
+	g_object_class_override_property (gobject_class, PROP_NAME, "name");
+	g_object_class_override_property (gobject_class, PROP_LABEL, "label");
+	g_object_class_override_property (gobject_class, PROP_DESCRIPTION, "description");
+	g_object_class_override_property (gobject_class, PROP_ACTIONS, "actions");
+	g_object_class_override_property (gobject_class, PROP_LOADED, "loaded");
+}
+
+static void
+mock_backend_iface (SeahorseBackendIface *iface)
+{
+	iface->lookup_place = mock_backend_lookup_place;
+	iface->get_actions = mock_backend_get_actions;
+	iface->get_description = mock_backend_get_description;
+	iface->get_label = mock_backend_get_label;
+	iface->get_name = mock_backend_get_name;
+}
+
+static void
+mock_backend_set_loaded (MockBackend *self)
+{
+	self->loaded = TRUE;
+	g_object_notify (G_OBJECT (self), "loaded");
+}
+
+/* -----------------------------------------------------------------------------
+ * TESTS
+ */
+
+#define FPR_ALICE_EXAMPLE "6D6E0B2C42A1F3E4D5C6B7A8912345678ABCDEF0"
+#define FPR_ALICE_OTHER   "0FEDCBA987654321A8B7C6D5E4F3A1422C0B6E6D"
+#define FPR_BOB_ALISON    "1111222233334444555566667777888899990000"
+#define FPR_CAROL_SMITH   "AAAABBBBCCCCDDDDEEEEFFFF0000111122223333"
+
+typedef struct {
+	GDBusConnection *connection;
+	MockBackend *backend;
+	GcrCollection *place;
+	GObject *alice;
+	SeahorseSearchProvider *provider;
+	GAsyncResult *result;
+} Test;
+
+static gchar *
+stored_results_path (void)
+{
+	return g_build_filename (g_get_user_cache_dir (), "seahorse", "search-provider", NULL);
+}
+
+static void
+add_item (GcrCollection *place,
+          const gchar *label,
+          const gchar *fingerprint)
+{
+	GObject *item;
+
+	item = mock_item_new (label, fingerprint);
+	gcr_simple_collection_add (GCR_SIMPLE_COLLECTION (place), item);
+	g_object_unref (item);
+}
+
+static void
+start_provider (Test *test)
+{
+	GError *error = NULL;
+
+	test->provider = seahorse_search_provider_new ();
+	seahorse_search_provider_initialize (test->provider);
+	seahorse_search_provider_dbus_register (test->provider, test->connection,
+	                                        PROVIDER_PATH, &error);
+	g_assert_no_error (error);
+}
+
+static void
+stop_provider (Test *test)
+{
+	seahorse_search_provider_dbus_unregister (test->provider, test->connection,
+	                                          PROVIDER_PATH);
+	g_clear_object (&test->provider);
+}
+
+static void
+setup (Test *test,
+       gconstpointer unused)
+{
+	GError *error = NULL;
+	gchar *path;
+
+	/* Nothing stored from an earlier test */
+	path = stored_results_path ();
+	g_unlink (path);
+	g_free (path);
+
+	test->connection = g_bus_get_sync (G_BUS_TYPE_SESSION, NULL, &error);
+	g_assert_no_error (error);
+
+	test->backend = g_object_new (mock_backend_get_type (), NULL);
+	seahorse_backend_register (SEAHORSE_BACKEND (test->backend));
+
+	test->place = gcr_simple_collection_new ();
+	test->alice = mock_item_new ("Alice Example", FPR_ALICE_EXAMPLE);
+	gcr_simple_collection_add (GCR_SIMPLE_COLLECTION (test->place), test->alice);
+	add_item (test->place, "Bob Alison", FPR_BOB_ALISON);
+	add_item (test->place, "Malice", NULL);
+	add_item (test->place, "Carol Smith", FPR_CAROL_SMITH);
+	add_item (test->place, "Alice Other", FPR_ALICE_OTHER);
+	gcr_simple_collection_add (GCR_SIMPLE_COLLECTION (test->backend), G_OBJECT (test->place));
+
+	start_provider (test);
+	mock_backend_set_loaded (test->backend);
+}
+
+static void
+teardown (Test *test,
+          gconstpointer unused)
+{
+	gchar *path;
+
+	g_clear_object (&test->result);
+	if (test->provider)
+		stop_provider (test);
+
+	g_object_unref (test->alice);
+	g_object_unref (test->place);
+	seahorse_registry_cleanup ();
+	g_object_unref (test->backend);
+	g_object_unref (test->connection);
+
+	path = stored_results_path ();
+	g_unlink (path);
+	g_free (path);
+}
+
+static void
+on_async_ready (GObject *source,
+                GAsyncResult *result,
+                gpointer user_data)
+{
+	Test *test = user_data;
+	g_assert (test->result == NULL);
+	test->result = g_object_ref (result);
+}
+
+/* Calls the provider over the bus, and returns the result ids */
+static gchar **
+call_provider (Test *test,
+               const gchar *method,
+               GVariant *parameters)
+{
+	GError *error = NULL;
+	GVariant *reply;
+	gchar **results;
+
+	g_clear_object (&test->result);
+	g_dbus_connection_call (test->connection,
+	                        g_dbus_connection_get_unique_name (test->connection),
+	                        PROVIDER_PATH, PROVIDER_INTERFACE, method, parameters,
+	                        G_VARIANT_TYPE ("(as)"), G_DBUS_CALL_FLAGS_NONE, -1,
+	                        NULL, on_async_ready, test);
+	while (test->result == NULL)
+		g_main_context_iteration (NULL, TRUE);
+
+	reply = g_dbus_connection_call_finish (test->connection, test->result, &error);
+	g_assert_no_error (error);
+	g_variant_get (reply, "(^as)", &results);
+	g_variant_unref (reply);
+
+	return results;
+}
+
+static gchar **
+get_initial (Test *test,
+             const gchar **terms)
+{
+	return call_provider (test, "GetInitialResultSet",
+	                      g_variant_new ("(^as)", terms));
+}
+
+static gchar **
+get_subsearch (Test *test,
+               gchar **previous,
+               const gchar **terms)
+{
+	return call_provider (test, "GetSubsearchResultSet",
+	                      g_variant_new ("(^as^as)", previous, terms));
+}
+
+static void
+assert_results (gchar **results,
+                const gchar **expected)
+{
+	guint i;
+
+	for (i = 0; expected[i] != NULL; i++) {
+		g_assert (results[i] != NULL);
+		g_assert_cmpstr (results[i], ==, expected[i]);
+	}
+	g_assert_cmpstr (results[i], ==, NULL);
+}
+
+/* Items without a fingerprint are known by a digest of their label */
+static gchar *
+content_id (const gchar *label)
+{
+	gchar *text;
+	gchar *value;
+	gchar *id;
+
+	text = g_strdup_printf ("%s\n", label);
+	value = g_compute_checksum_for_string (G_CHECKSUM_SHA1, text, -1);
+	id = g_strdup_printf ("MockItem:%s", value);
+
+	g_free (value);
+	g_free (text);
+	return id;
+}
+
+static void
+test_initial_ranking (Test *test,
+                      gconstpointer unused)
+{
+	const gchar *terms[] = { "ali", NULL };
+	gchar *malice;
+	gchar **results;
+
+	/* Start of the name first, ties by name, then word starts, then the rest */
+	malice = content_id ("Malice");
+	{
+		const gchar *expected[] = {
+			"MockItem:" FPR_ALICE_EXAMPLE,
+			"MockItem:" FPR_ALICE_OTHER,
+			"MockItem:" FPR_BOB_ALISON,
+			malice,
+			NULL
+		};
+		results = get_initial (test, terms);
+		assert_results (results, expected);
+		g_strfreev (results);
+	}
+
+	g_free (malice);
+}
+
+static void
+test_subsearch_order (Test *test,
+                      gconstpointer unused)
+{
+	const gchar *terms[] = { "ali", NULL };
+	const gchar *narrower[] = { "alice", NULL };
+	gchar **initial;
+	gchar **results;
+
+	initial = get_initial (test, terms);
+	g_assert_cmpuint (g_strv_length (initial), ==, 4);
+
+	/* Bob Alison drops out, the others keep their places */
+	{
+		const gchar *expected[] = { initial[0], initial[1], initial[3], NULL };
+		results = get_subsearch (test, initial, narrower);
+		assert_results (results, expected);
+		g_strfreev (results);
+	}
+
+	/* The order is the caller's, not ours, and unknown ids are left out */
+	{
+		gchar *previous[] = {
+			initial[2], initial[3], initial[1],
+			(gchar *)"MockItem:bogus", initial[0], NULL
+		};
+		const gchar *expected[] = { initial[3], initial[1], initial[0], NULL };
+		results = get_subsearch (test, previous, narrower);
+		assert_results (results, expected);
+		g_strfreev (results);
+	}
+
+	g_strfreev (initial);
+}
+
+static void
+test_id_stability (Test *test,
+                   gconstpointer unused)
+{
+	const gchar *terms[] = { "ali", NULL };
+	GcrCollection *other;
+	GObject *copy;
+	gchar **initial;
+	gchar **results;
+
+	initial = get_initial (test, terms);
+	g_assert_cmpuint (g_strv_length (initial), ==, 4);
+
+	results = get_initial (test, terms);
+	assert_results (results, (const gchar **)initial);
+	g_strfreev (results);
+
+	/* The same key in a second place doesn't show up twice */
+	other = gcr_simple_collection_new ();
+	copy = mock_item_new ("Alice Example", FPR_ALICE_EXAMPLE);
+	gcr_simple_collection_add (GCR_SIMPLE_COLLECTION (other), copy);
+	gcr_simple_collection_add (GCR_SIMPLE_COLLECTION (test->backend), G_OBJECT (other));
+
+	results = get_initial (test, terms);
+	assert_results (results, (const gchar **)initial);
+	g_strfreev (results);
+
+	/* And when the first copy goes, the other one answers to its id */
+	gcr_simple_collection_remove (GCR_SIMPLE_COLLECTION (test->place), test->alice);
+
+	results = get_initial (test, terms);
+	assert_results (results, (const gchar **)initial);
+	g_strfreev (results);
+
+	results = get_subsearch (test, initial, terms);
+	assert_results (results, (const gchar **)initial);
+	g_strfreev (results);
+
+	/* An item known by its content gets the same id when it comes back */
+	gcr_simple_collection_remove (GCR_SIMPLE_COLLECTION (test->backend), G_OBJECT (other));
+	gcr_simple_collection_add (GCR_SIMPLE_COLLECTION (test->place), test->alice);
+	add_item (test->place, "Malice", NULL);
+
+	results = get_initial (test, terms);
+	assert_results (results, (const gchar **)initial);
+	g_strfreev (results);
+
+	g_strfreev (initial);
+	g_object_unref (copy);
+	g_object_unref (other);
+}
+
+static void
+test_stored_ids (Test *test,
+                 gconstpointer unused)
+{
+	const gchar *terms[] = { "ali", NULL };
+	const gchar *narrower[] = { "alice", NULL };
+	gchar **initial;
+	gchar **narrowed;
+	gchar **results;
+
+	initial = get_initial (test, terms);
+	narrowed = get_subsearch (test, initial, narrower);
+
+	/* What loaded was stored, and is what the next run answers with */
+	stop_provider (test);
+	test->backend->loaded = FALSE;
+	start_provider (test);
+
+	results = get_initial (test, terms);
+	assert_results (results, (const gchar **)initial);
+	g_strfreev (results);
+
+	results = get_subsearch (test, initial, narrower);
+	assert_results (results, (const gchar **)narrowed);
+	g_strfreev (results);
+
+	/* Same again once the backend has loaded */
+	mock_backend_set_loaded (test->backend);
+
+	results = get_initial (test, terms);
+	assert_results (results, (const gchar **)initial);
+	g_strfreev (results);
+
+	g_strfreev (narrowed);
+	g_strfreev (initial);
+}
+
+int
+main (int argc,
+      char **argv)
+{
+	GtkApplication *application;
+	GTestDBus *bus;
+	gchar *cache_dir;
+	gchar *path;
+	int ret;
+
+	/* Stored results go under here, fresh for each run */
+	cache_dir = g_dir_make_tmp ("seahorse-test-XXXXXX", NULL);
+	g_assert (cache_dir != NULL);
+	g_setenv ("XDG_CACHE_HOME", cache_dir, TRUE);
+
+	g_test_init (&argc, &argv, NULL);
+
+	bus = g_test_dbus_new (G_TEST_DBUS_NONE);
+	g_test_dbus_up (bus);
+
+	/* The provider holds the application while it answers */
+	application = seahorse_application_new ();
+
+	g_test_add ("/search-provider/initial-ranking", Test, NULL, setup, test_initial_ranking, teardown);
+	g_test_add ("/search-provider/subsearch-order", Test, NULL, setup, test_subsearch_order, teardown);
+	g_test_add ("/search-provider/id-stability", Test, NULL, setup, test_id_stability, teardown);
+	g_test_add ("/search-provider/stored-ids", Test, NULL, setup, test_stored_ids, teardown);
+
+	ret = g_test_run ();
+
+	g_object_unref (application);
+	g_test_dbus_down (bus);
+	g_object_unref (bus);
+
+	path = g_build_filename (cache_dir, "seahorse", NULL);
+	g_rmdir (path);
+	g_free (path);
+	g_rmdir (cache_dir);
+	g_free (cache_dir);
+
+	return ret;
+}